@@ -0,0 +1,207 @@
+/*! Copyright 2013-2016 A2IA, CNRS, École Nationale des Chartes, ENS Lyon, INSA Lyon, Université Paris Descartes, Université de Poitiers
+ *
+ * This file is part of Oriflamms.
+ *
+ * Oriflamms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oriflamms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Oriflamms.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \file main.cpp
+ * \brief Runs the processing of projects without the graphical interface
+ */
+
+#include <oriflamms_config.h>
+#include <OriBatch.h>
+#include <OriTextSignature.h>
+#include <CRNException.h>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*! Options of the alignment, in the order of the alignment dialog */
+static const struct { const char *name; ori::AlignConfig flag; } alignflags[] =
+{
+	{ "all-words", ori::AlignConfig::AllWords },
+	{ "nok-words", ori::AlignConfig::NOKWords },
+	{ "nal-words", ori::AlignConfig::NAlWords },
+	{ "frontiers", ori::AlignConfig::WordFrontiers },
+	{ "chars-all-words", ori::AlignConfig::CharsAllWords },
+	{ "chars-ok-words", ori::AlignConfig::CharsOKWords },
+	{ "chars-nko-words", ori::AlignConfig::CharsNKOWords },
+	{ "all-chars", ori::AlignConfig::AllChars },
+	{ "nal-chars", ori::AlignConfig::NAlChars }
+};
+
+static void usage(const char *prog)
+{
+	std::cerr << "Usage: " << prog << " [options] <project directory>..." << std::endl;
+	std::cerr << "Options:" << std::endl;
+	std::cerr << "  -s <stages>   comma separated list of stages to run (default: tidy,align)" << std::endl;
+	std::cerr << "                tidy       check the project and compute missing zones" << std::endl;
+	std::cerr << "                lines      detect the graphical lines again" << std::endl;
+	std::cerr << "                align      align the transcription on the images" << std::endl;
+	std::cerr << "                propagate  propagate the validation of words" << std::endl;
+	std::cerr << "                stats      export validation statistics to <name>-stats.ods" << std::endl;
+	std::cerr << "                spacings   export word and character spacings to <name>-spacings.xml" << std::endl;
+	std::cerr << "  -a <options>  comma separated list of alignment options (default: all-words)" << std::endl;
+	std::cerr << "               ";
+	for (const auto &f : alignflags)
+		std::cerr << " " << f.name;
+	std::cerr << std::endl;
+	std::cerr << "  -t <table>    select the signature table of the script of the projects" << std::endl;
+	std::cerr << "                (\"default\" for the built-in table, \"list\" to list the tables)" << std::endl;
+	std::cerr << "  -l <file>     read the list of project directories from a file, one per line" << std::endl;
+	std::cerr << "  -d <dir>      directory of the exports and manifests (default: each project's directory)" << std::endl;
+	std::cerr << "  -j <n>        number of threads (default: number of cores)" << std::endl;
+	std::cerr << "  -i <n>        maximal number of views processed at once (default: number of threads)" << std::endl;
+	std::cerr << "  -p <n>        maximal number of projects open at once (default: number of threads)" << std::endl;
+	std::cerr << "  -m <MiB>      do not start a view while the resident memory exceeds this size" << std::endl;
+}
+
+static std::vector<std::string> split(const std::string &s)
+{
+	auto res = std::vector<std::string>{};
+	auto b = size_t(0);
+	while (b <= s.size())
+	{
+		auto e = s.find(',', b);
+		if (e == std::string::npos)
+			e = s.size();
+		if (e > b)
+			res.push_back(s.substr(b, e - b));
+		b = e + 1;
+	}
+	return res;
+}
+
+/*! Opens projects, runs a list of processing stages on them and saves them */
+int main(int argc, char **argv)
+{
+	auto opts = ori::Batch::Options{};
+	auto projects = std::vector<crn::Path>{};
+	for (auto tmp = 1; tmp < argc; ++tmp)
+	{
+		if (!strcmp(argv[tmp], "-s") && (tmp + 1 < argc))
+		{
+			opts.tidy = opts.lines = opts.align = opts.propagate = opts.stats = opts.spacings = false;
+			for (const auto &s : split(argv[++tmp]))
+			{
+				if (s == "tidy")
+					opts.tidy = true;
+				else if (s == "lines")
+					opts.lines = true;
+				else if (s == "align")
+					opts.align = true;
+				else if (s == "propagate")
+					opts.propagate = true;
+				else if (s == "stats")
+					opts.stats = true;
+				else if (s == "spacings")
+					opts.spacings = true;
+				else
+				{
+					std::cerr << "Unknown stage: " << s << std::endl;
+					return 1;
+				}
+			}
+		}
+		else if (!strcmp(argv[tmp], "-a") && (tmp + 1 < argc))
+		{
+			opts.align_config = ori::AlignConfig::None;
+			for (const auto &opt : split(argv[++tmp]))
+			{
+				auto found = false;
+				for (const auto &f : alignflags)
+					if (opt == f.name)
+					{
+						opts.align_config |= f.flag;
+						found = true;
+					}
+				if (!found)
+				{
+					std::cerr << "Unknown alignment option: " << opt << std::endl;
+					return 1;
+				}
+			}
+		}
+		else if (!strcmp(argv[tmp], "-t") && (tmp + 1 < argc))
+		{
+			opts.signature_table = argv[++tmp];
+			if (opts.signature_table == "list")
+			{
+				std::cout << "default" << std::endl;
+				for (const auto &name : ori::TextSignatureDB::GetNames())
+					std::cout << name << std::endl;
+				return 0;
+			}
+		}
+		else if (!strcmp(argv[tmp], "-l") && (tmp + 1 < argc))
+		{
+			std::ifstream list(argv[++tmp]);
+			if (!list)
+			{
+				std::cerr << "Cannot read " << argv[tmp] << std::endl;
+				return 1;
+			}
+			auto line = std::string{};
+			while (std::getline(list, line))
+				if (!line.empty())
+					projects.push_back(line.c_str());
+		}
+		else if (!strcmp(argv[tmp], "-d") && (tmp + 1 < argc))
+			opts.output_dir = argv[++tmp];
+		else if (!strcmp(argv[tmp], "-j") && (tmp + 1 < argc))
+			opts.threads = size_t(atoi(argv[++tmp]));
+		else if (!strcmp(argv[tmp], "-i") && (tmp + 1 < argc))
+			opts.max_images = size_t(atoi(argv[++tmp]));
+		else if (!strcmp(argv[tmp], "-p") && (tmp + 1 < argc))
+			opts.max_projects = size_t(atoi(argv[++tmp]));
+		else if (!strcmp(argv[tmp], "-m") && (tmp + 1 < argc))
+			opts.max_memory = size_t(atoi(argv[++tmp])) * 1024 * 1024;
+		else if (argv[tmp][0] != '-')
+			projects.push_back(argv[tmp]);
+		else
+		{
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (projects.empty())
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	crn::Exception::TraceStack() = false;
+	auto batch = ori::Batch{opts};
+	for (const auto &p : projects)
+		batch.AddProject(p);
+	auto failed = 0;
+	batch.Run([&failed](const ori::Batch::Result &res)
+			{
+				std::cout << res.name << ": " << (res.ok ? "ok" : "failed") << " (" << res.views << " views)" << std::endl;
+				for (const auto &t : res.timings)
+					std::cout << "  " << std::left << std::setw(10) << t.first << std::right << std::fixed << std::setprecision(3) << std::setw(12) << t.second << " s" << std::endl;
+				if (res.manifest.IsNotEmpty())
+					std::cout << "  manifest: " << res.manifest << std::endl;
+				if (!res.ok)
+				{
+					std::cerr << res.project << ":" << std::endl << res.error;
+					failed += 1;
+				}
+			});
+	return failed ? 2 : 0;
+}
@@ -0,0 +1,357 @@
+/*! Copyright 2013-2016 A2IA, CNRS, École Nationale des Chartes, ENS Lyon, INSA Lyon, Université Paris Descartes, Université de Poitiers
+ *
+ * This file is part of Oriflamms.
+ *
+ * Oriflamms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oriflamms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Oriflamms.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \file OriBatch.cpp
+ */
+
+#include <OriBatch.h>
+#include <OriDocument.h>
+#include <OriIO.h>
+#include <OriThreadPool.h>
+#include <CRNXml/CRNXml.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#ifndef _WIN32
+#	include <unistd.h>
+#endif
+
+using namespace ori;
+
+/*! Outcome of a view */
+struct ViewRecord
+{
+	size_t order; // position in the document
+	Id id;
+	size_t characters;
+	double seconds;
+	crn::StringUTF8 error;
+};
+
+/*! A project being processed */
+struct ProjectState
+{
+	std::unique_ptr<Document> doc;
+	Batch::Result result;
+	std::mutex mutex; // protects the fields below
+	double lines_time = 0.0, align_time = 0.0;
+	std::vector<ViewRecord> views;
+	std::atomic<size_t> pending{0}; // views left to process
+};
+
+/*! A view to process */
+struct ViewJob
+{
+	ProjectState *project;
+	size_t order;
+	Id view;
+	size_t characters;
+};
+
+/*! Limits the number of views processed at once and the memory used */
+class Admission
+{
+	public:
+		Admission(size_t maxviews, size_t maxmem):max_views(maxviews), max_memory(maxmem) {}
+		/*! Waits until n views can be started */
+		void Enter(size_t n = 1)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cond.wait(lock, [this, n]()
+					{
+						if (!running)
+							return true; // always let one task run
+						return (running + n <= max_views) && (!max_memory || (Batch::GetResidentMemory() <= max_memory));
+					});
+			running += n;
+		}
+		/*! Signals that n views were processed and freed */
+		void Leave(size_t n = 1)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				running -= n;
+			}
+			cond.notify_all();
+		}
+	private:
+		const size_t max_views, max_memory;
+		size_t running = 0;
+		std::mutex mutex;
+		std::condition_variable cond;
+};
+
+/*! Runs a function and returns the time it took in seconds */
+template<typename F> static double timed(F &&f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/*! Path of an output file of a project */
+static crn::Path outputPath(const Batch::Options &opts, const ProjectState &p, const crn::StringUTF8 &suffix)
+{
+	const auto &dir = opts.output_dir.IsEmpty() ? p.result.project : opts.output_dir;
+	return dir / crn::Path{p.result.name + suffix};
+}
+
+/*! Writes the manifest of a project */
+static void writeManifest(const Batch::Options &opts, ProjectState &p)
+{
+	auto doc = crn::xml::Document{};
+	auto root = doc.PushBackElement("oriflamms-batch");
+	root.SetAttribute("project", p.result.project);
+	root.SetAttribute("name", p.result.name);
+	root.SetAttribute("status", p.result.ok ? "ok" : "failed");
+	root.SetAttribute("views", int(p.result.views));
+	root.SetAttribute("failed-views", int(p.result.failed_views));
+	for (const auto &t : p.result.timings)
+	{
+		auto el = root.PushBackElement("stage");
+		el.SetAttribute("name", t.first);
+		el.SetAttribute("seconds", t.second);
+	}
+	for (const auto &v : p.views)
+	{
+		auto el = root.PushBackElement("view");
+		el.SetAttribute("id", v.id.Str());
+		el.SetAttribute("characters", int(v.characters));
+		el.SetAttribute("seconds", v.seconds);
+		el.SetAttribute("status", v.error.IsEmpty() ? "ok" : "failed");
+		if (v.error.IsNotEmpty())
+			el.PushBackText(v.error);
+	}
+	if (p.result.error.IsNotEmpty())
+		root.PushBackElement("error").PushBackText(p.result.error);
+	if (p.result.warnings.IsNotEmpty())
+		root.PushBackElement("warnings").PushBackText(p.result.warnings);
+	p.result.manifest = outputPath(opts, p, "-manifest.xml");
+	const auto str = doc.AsString();
+	WriteFileAtomically(p.result.manifest, str.CStr(), str.Size());
+}
+
+/*! Runs the project-wide stages, saves and closes a project, then writes its manifest */
+static void finishProject(const Batch::Options &opts, ProjectState &p)
+{
+	if (p.doc)
+	{
+		try
+		{
+			auto &t = p.result.timings;
+			if (opts.lines)
+				t.emplace_back("lines", p.lines_time);
+			if (opts.align)
+				t.emplace_back("align", p.align_time);
+			if (opts.propagate)
+				t.emplace_back("propagate", timed([&p]() { p.doc->PropagateValidation(); }));
+			if (opts.stats)
+				t.emplace_back("stats", timed([&]() { p.doc->ExportStats(outputPath(opts, p, "-stats.ods")); }));
+			if (opts.spacings)
+				t.emplace_back("spacings", timed([&]() { p.doc->ExportSpacings(outputPath(opts, p, "-spacings.xml")); }));
+			t.emplace_back("save", timed([&p]() { p.doc->Save(); }));
+			t.emplace_back("close", timed([&p]() { p.doc.reset(); }));
+		}
+		catch (std::exception &ex)
+		{
+			p.result.error += crn::StringUTF8(ex.what()) + "\n";
+		}
+		p.doc.reset();
+	}
+	p.result.ok = p.result.error.IsEmpty();
+	std::sort(p.views.begin(), p.views.end(), [](const ViewRecord &v1, const ViewRecord &v2) { return v1.order < v2.order; });
+	try
+	{
+		writeManifest(opts, p);
+	}
+	catch (std::exception &ex)
+	{
+		p.result.ok = false;
+		p.result.manifest = crn::Path{};
+		p.result.error += crn::StringUTF8(ex.what()) + "\n";
+	}
+}
+
+/*! Opens a project and lists its views
+ * \param[in]	opts	the options of the batch
+ * \param[in]	p	the project
+ * \param[out]	jobs	the views to process
+ * \param[in]	nthreads	number of threads used to read the views
+ */
+static void openProject(const Batch::Options &opts, ProjectState &p, std::vector<ViewJob> &jobs, size_t nthreads)
+{
+	try
+	{
+		auto &t = p.result.timings;
+		t.emplace_back("open", timed([&p, nthreads]() { p.doc = std::make_unique<Document>(p.result.project, nullptr, nthreads); }));
+		p.result.name = p.doc->GetName();
+		if (opts.signature_table.IsNotEmpty())
+			p.doc->SetSignatureTable(opts.signature_table == "default" ? crn::StringUTF8{} : opts.signature_table); // may throw
+		if (opts.tidy)
+			t.emplace_back("tidy", timed([&p]() { p.doc->TidyUp(nullptr); }));
+		p.result.warnings = p.doc->WarningReport() + p.doc->ErrorReport();
+		for (const auto &vid : p.doc->GetViews())
+			p.doc->ReleaseView(vid); // do not keep the views opened by TidyUp
+		if (!opts.lines && !opts.align)
+			return;
+		const auto &views = p.doc->GetViews();
+		for (auto tmp = size_t(0); tmp < views.size(); ++tmp)
+		{
+			jobs.push_back(ViewJob{&p, tmp, views[tmp], p.doc->CountCharacters(views[tmp])});
+			p.pending += 1;
+		}
+	}
+	catch (std::exception &ex)
+	{
+		p.result.error += crn::StringUTF8(ex.what()) + "\n";
+		p.doc.reset();
+	}
+}
+
+/*! Processes a view */
+static void runView(const Batch::Options &opts, const ViewJob &job)
+{
+	auto &p = *job.project;
+	auto rec = ViewRecord{job.order, job.view, job.characters, 0.0, ""};
+	auto lines_time = 0.0, align_time = 0.0;
+	try
+	{
+		auto v = p.doc->GetView(job.view);
+		if (opts.lines)
+			lines_time = timed([&v]() { v.DetectLines(); });
+		if (opts.align)
+			align_time = timed([&v, &opts]() { v.AlignAll(opts.align_config); });
+	}
+	catch (std::exception &ex)
+	{
+		rec.error = ex.what();
+	}
+	p.doc->ReleaseView(job.view); // saves the view and frees its images
+	rec.seconds = lines_time + align_time;
+
+	std::lock_guard<std::mutex> lock(p.mutex);
+	p.lines_time += lines_time;
+	p.align_time += align_time;
+	p.result.views += 1;
+	if (rec.error.IsNotEmpty())
+	{
+		p.result.failed_views += 1;
+		p.result.error += job.view.Str() + ": " + rec.error + "\n";
+	}
+	p.views.push_back(std::move(rec));
+}
+
+std::vector<Batch::Result> Batch::Run(const std::function<void(const Result&)> &done)
+{
+	const auto id_scope = Id::Scope{}; // the jobs and records keep view ids after their project is closed
+	auto state = std::vector<std::unique_ptr<ProjectState>>{};
+	for (const auto &dir : projects)
+	{
+		state.push_back(std::make_unique<ProjectState>());
+		state.back()->result.project = dir;
+		state.back()->result.name = dir.GetFilename();
+	}
+
+	std::mutex mutex; // protects the fields below
+	std::condition_variable cond;
+	auto opened = std::vector<ViewJob>{}; // views of the projects that were just opened
+	auto open = size_t(0), finished = size_t(0);
+	const auto finish = [this, &done, &mutex, &cond, &open, &finished](ProjectState &p)
+		{
+			finishProject(options, p);
+			std::lock_guard<std::mutex> lock(mutex);
+			if (done)
+				done(p.result);
+			open -= 1;
+			finished += 1;
+			cond.notify_all();
+		};
+
+	ThreadPool pool(options.threads);
+	const auto slots = options.max_images ? options.max_images : pool.GetSize();
+	Admission admission(slots, options.max_memory);
+	// the threads of the batch are shared by the projects being opened, each one reads as many views at once
+	const auto max_open = std::max(size_t(1), std::min(options.max_projects ? options.max_projects : pool.GetSize(), state.size()));
+	const auto open_threads = std::max(size_t(1), std::min(slots, pool.GetSize()) / max_open);
+
+	// open the projects when there is room, and process the views of each project, largest first so that the last ones to finish are short
+	auto tasks = std::vector<std::future<void>>{};
+	auto next = size_t(0);
+	std::unique_lock<std::mutex> lock(mutex);
+	while (finished < state.size())
+	{
+		for (; (open < max_open) && (next < state.size()); ++next)
+		{
+			auto *ps = state[next].get();
+			open += 1;
+			tasks.push_back(pool.Submit([this, ps, open_threads, &admission, &mutex, &cond, &opened, &finish]()
+						{
+							auto jobs = std::vector<ViewJob>{};
+							admission.Enter(open_threads); // opening and tidying up reads all the views
+							openProject(options, *ps, jobs, open_threads);
+							admission.Leave(open_threads);
+							if (jobs.empty())
+							{ // failed or nothing to do per view
+								finish(*ps);
+								return;
+							}
+							std::lock_guard<std::mutex> lock(mutex);
+							opened.insert(opened.end(), jobs.begin(), jobs.end());
+							cond.notify_all();
+						}));
+		}
+		std::stable_sort(opened.begin(), opened.end(), [](const ViewJob &j1, const ViewJob &j2) { return j1.characters > j2.characters; });
+		for (const auto &job : opened)
+			tasks.push_back(pool.Submit([this, job, &admission, &finish]()
+						{
+							admission.Enter();
+							runView(options, job);
+							admission.Leave();
+							if (--job.project->pending == 0)
+								finish(*job.project);
+						}));
+		opened.clear();
+		cond.wait(lock, [&]() { return !opened.empty() || ((open < max_open) && (next < state.size())) || (finished == state.size()); });
+	}
+	lock.unlock();
+	for (auto &t : tasks)
+		t.get();
+
+	auto res = std::vector<Result>{};
+	for (auto &p : state)
+		res.push_back(std::move(p->result));
+	return res;
+}
+
+/*! Only implemented on Linux, the memory limit is ignored elsewhere */
+size_t Batch::GetResidentMemory()
+{
+#if defined(__linux__)
+	std::ifstream statm("/proc/self/statm");
+	auto size = size_t(0), resident = size_t(0);
+	if (!(statm >> size >> resident))
+		return 0;
+	return resident * size_t(sysconf(_SC_PAGESIZE));
+#else
+	return 0;
+#endif
+}
+
@@ -0,0 +1,96 @@
+/*! Copyright 2013-2016 A2IA, CNRS, École Nationale des Chartes, ENS Lyon, INSA Lyon, Université Paris Descartes, Université de Poitiers
+ *
+ * This file is part of Oriflamms.
+ *
+ * Oriflamms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oriflamms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Oriflamms.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \file OriBatch.h
+ */
+
+#ifndef OriBatch_HEADER
+#define OriBatch_HEADER
+
+#include <oriflamms_config.h>
+#include <OriAlignConfig.h>
+#include <CRNIO/CRNPath.h>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace ori
+{
+	/*! \brief Processing of a list of projects without the graphical interface
+	 *
+	 * The projects are opened when there is room, so that only a few of them are in memory at once, and all views are processed by a single set of threads, largest first in each project.
+	 * When the last view of a project is processed, the project-wide stages are run, the project is saved and closed, and a manifest of the results is written. The next project is then opened.
+	 */
+	class Batch
+	{
+		public:
+			/*! \brief What to do and with which resources */
+			struct Options
+			{
+				bool tidy = true; // check the project and compute the missing zones when it is opened
+				bool lines = false; // detect the graphical lines of each view again
+				bool align = true; // align each view
+				bool propagate = false; // propagate the validation of words
+				bool stats = false; // export validation statistics to <name>-stats.ods
+				bool spacings = false; // export word and character spacings to <name>-spacings.xml
+				AlignConfig align_config = AlignConfig::AllWords;
+				crn::StringUTF8 signature_table; // signature table to select in each project ("default" for the built-in table, empty to keep the choice of the project)
+				size_t threads = 0; // number of threads (0 for the number of cores)
+				size_t max_images = 0; // maximal number of views processed at once (0 for the number of threads)
+				size_t max_projects = 0; // maximal number of projects open at once (0 for the number of threads)
+				size_t max_memory = 0; // no view is started while the resident memory exceeds this size in bytes, unless nothing else runs (0 for no limit)
+				crn::Path output_dir; // directory of the exports and manifests (empty for the directory of each project)
+			};
+
+			/*! \brief Outcome of a project */
+			struct Result
+			{
+				crn::Path project;
+				crn::StringUTF8 name;
+				bool ok = false;
+				crn::StringUTF8 error; // cause of the failure of the project or of some views
+				crn::StringUTF8 warnings; // inconsistencies found when the project was opened and tidied up
+				std::vector<std::pair<crn::StringUTF8, double>> timings; // seconds spent in each stage, summed on all views for the stages of views
+				size_t views = 0; // number of views processed
+				size_t failed_views = 0;
+				crn::Path manifest; // the manifest file
+			};
+
+			Batch(Options opts):options(std::move(opts)) {}
+
+			/*! \brief Adds a project directory to the list */
+			void AddProject(const crn::Path &dir) { projects.push_back(dir); }
+
+			/*! \brief Processes all the projects
+			 *
+			 * A project that cannot be opened or saved is reported as failed, the other projects are processed anyway.
+			 * \param[in]	done	function called from a worker thread when a project is finished (may be empty)
+			 * \return	the results in the order of the projects
+			 */
+			std::vector<Result> Run(const std::function<void(const Result&)> &done = std::function<void(const Result&)>{});
+
+			/*! \brief Gets the resident memory of the process in bytes (0 if unknown) */
+			static size_t GetResidentMemory();
+
+		private:
+			Options options;
+			std::vector<crn::Path> projects;
+	};
+}
+
+#endif
+
@@ -28,8 +28,12 @@
 #include <GtkCRNApp.h>
 #include <CRNAI/CRNGenetic.h>
 #include <unordered_set>
+#include <limits>
+#include <cmath>
 #include <CRNAI/CRN2Means.h>
+#include <CRNMath/CRNSquareMatrixDouble.h>
 #include <OriConfig.h>
+#include <OriShapeContext.h>
 #include <CRNi18n.h>
 
 using namespace ori;
@@ -38,6 +42,11 @@ using namespace crn::literals;
 /////////////////////////////////////////////////////////////////////////////////
 // CharacterDialog
 /////////////////////////////////////////////////////////////////////////////////
+/*! Characters with more occurrences may be compared to their nearest neighbours only */
+static constexpr auto LARGE_CHARACTER = size_t(2000);
+/*! Number of neighbours of each occurrence in a sparse distance matrix */
+static constexpr auto NEIGHBOURS = size_t(32);
+
 CharacterDialog::CharacterDialog(Document &docu, Gtk::Window &parent):
 	Gtk::Dialog(_("Characters"), parent, true),
 	doc(docu),
@@ -112,6 +121,24 @@ CharacterDialog::CharacterDialog(Document &docu, Gtk::Window &parent):
 	update_buttons();
 }
 
+/*! Lists the aligned occurrences of a character and the hashes of their zones */
+std::vector<Id> CharacterDialog::aligned_occurrences(const crn::String &character, std::vector<uint64_t> &hashes)
+{
+	auto ids = std::vector<Id>{};
+	hashes.clear();
+	for (const auto &v : characters[character])
+	{
+		auto view = doc.GetView(v.first);
+		for (const auto &id : v.second)
+			if (view.IsAligned(id))
+			{
+				ids.push_back(id);
+				hashes.push_back(view.GetZone(view.GetCharacter(id).GetZone()).GetHash());
+			}
+	}
+	return ids;
+}
+
 void CharacterDialog::update_buttons()
 {
 	auto it = tv.get_selection()->get_selected();
@@ -129,22 +156,16 @@ void CharacterDialog::update_buttons()
 		try
 		{
 			const auto &dm = doc.GetDistanceMatrix(character);
+			const auto &oldhashes = doc.GetDistanceHashes(character);
 			compute_dm.hide();
 			dm_ok.show();
 			clear_dm.set_sensitive(true);
 			show_clusters.set_sensitive(true);
 
-			auto ids = std::vector<Id>{};
-			for (const auto &v : characters[character])
-			{
-				auto view = doc.GetView(v.first);
-				for (const auto &id : v.second)
-					if (view.IsAligned(id))
-					{
-						ids.push_back(id);
-					}
-			}
-			if ((ids.size() != dm.first.size()) || !std::equal(ids.begin(), ids.end(), dm.first.begin()))
+			auto hashes = std::vector<uint64_t>{};
+			const auto ids = aligned_occurrences(character, hashes);
+			if ((ids.size() != dm.first.size()) || !std::equal(ids.begin(), ids.end(), dm.first.begin()) ||
+					(!oldhashes.empty() && (hashes != oldhashes)))
 				update_dm.show();
 			else
 				update_dm.hide();
@@ -164,47 +185,110 @@ void CharacterDialog::compute_distmat()
 {
 	auto row = *tv.get_selection()->get_selected();
 	const auto character = crn::String{Glib::ustring{row[columns.value]}.c_str()};
-	auto ids = std::vector<Id>{};
-	for (const auto &v : characters[character])
-	{
-		//ids.insert(ids.end(), v.second.begin(), v.second.end());
-		auto view = doc.GetView(v.first);
-		for (const auto &id : v.second)
-			if (view.IsAligned(id))
-			{
-				ids.push_back(id);
-			}
-	}
-	auto dm = crn::SquareMatrixDouble{ids.size(), 0.0};
+	auto hashes = std::vector<uint64_t>{};
+	auto ids = aligned_occurrences(character, hashes);
 
 	const auto res = Gtk::MessageDialog{*this,
 			_("Are all the occurrences of this character approximately the same size?"),
 			false, Gtk::MESSAGE_QUESTION, Gtk::BUTTONS_YES_NO}.run();
+	auto neighbours = size_t(0);
+	if ((ids.size() > LARGE_CHARACTER) && DistanceMatrix::IsSparseCheaper(ids.size(), NEIGHBOURS))
+	{
+		const auto sparse = Gtk::MessageDialog{*this,
+				_("This character has many occurrences. Compute only the distances between each occurrence and its nearest neighbours? It is faster and uses less memory, but the clustering is approximate."),
+				false, Gtk::MESSAGE_QUESTION, Gtk::BUTTONS_YES_NO}.run();
+		if (sparse == Gtk::RESPONSE_YES)
+			neighbours = NEIGHBOURS;
+	}
 
-	GtkCRN::ProgressWindow pw(_("Computing distance matrix..."), this, true);
-	const auto pid = pw.add_progress_bar("");
+	// gradient matching or gradient shape context
+	run_distmat(character, std::move(ids), std::move(hashes), res == Gtk::RESPONSE_YES ? "gm" : "gsc-nn", neighbours, nullptr, std::vector<size_t>{});
+}
 
-	if (res == Gtk::RESPONSE_YES)
-	{ // gradient matching
-		pw.run(sigc::bind(sigc::mem_fun(this, &CharacterDialog::compute_gm), character, ids, std::ref(dm), pw.get_crn_progress(pid)));
+/*! Only the distances involving occurrences that were added or whose zone changed are computed, the others are copied from the former matrix. */
+void CharacterDialog::update_distmat()
+{
+	auto row = *tv.get_selection()->get_selected();
+	const auto character = crn::String{Glib::ustring{row[columns.value]}.c_str()};
+	const auto &old = doc.GetDistanceMatrix(character);
+	const auto &oldhashes = doc.GetDistanceHashes(character);
+	auto method = doc.GetDistanceMethod(character);
+	if (method.IsEmpty() || oldhashes.empty())
+	{ // computed by a former version
+		delete_dm();
+		compute_distmat();
+		return;
 	}
-	else
-	{ // gradient shape context
-		pw.run(sigc::bind(sigc::mem_fun(this, &CharacterDialog::compute_gsc), character, ids, std::ref(dm), pw.get_crn_progress(pid)));
+	// the shape context distance of former versions differs, none of its values can be reused
+	const auto compatible = method != "gsc";
+	if (!compatible)
+		method = "gsc-nn";
+
+	auto hashes = std::vector<uint64_t>{};
+	auto ids = aligned_occurrences(character, hashes);
+	auto oldindex = std::unordered_map<Id, size_t>{};
+	for (auto tmp = size_t(0); tmp < old.first.size(); ++tmp)
+		oldindex.emplace(old.first[tmp], tmp);
+	auto oldpos = std::vector<size_t>(ids.size(), std::numeric_limits<size_t>::max());
+	auto changed = !compatible || (ids.size() != old.first.size());
+	for (auto tmp = size_t(0); tmp < ids.size(); ++tmp)
+	{
+		auto it = oldindex.find(ids[tmp]);
+		if ((it != oldindex.end()) && (oldhashes[it->second] == hashes[tmp]))
+			oldpos[tmp] = it->second;
+		if (oldpos[tmp] != tmp)
+			changed = true;
+	}
+	if (!changed)
+	{
+		update_buttons();
+		return;
+	}
+	// a sparse matrix does not hold all the distances between unchanged occurrences
+	const auto *reuse = (!compatible || old.second.IsSparse()) ? nullptr : &old.second;
+	run_distmat(character, std::move(ids), std::move(hashes), method, old.second.GetNeighbourCount(), reuse, oldpos);
+}
+
+/*! Computes a distance matrix and stores it in the document
+ * \param[in]	character	the character string
+ * \param[in]	ids	the aligned occurrences
+ * \param[in]	hashes	the hashes of the zones of the occurrences
+ * \param[in]	method	"gm" for gradient matching or "gsc-nn" for gradient shape context
+ * \param[in]	neighbours	number of neighbours of each occurrence, or 0 to compute all the distances
+ * \param[in]	old	the former matrix of the character, or nullptr
+ * \param[in]	oldpos	the index of each occurrence in the former matrix, or max size_t if it was added or changed
+ */
+void CharacterDialog::run_distmat(const crn::String &character, std::vector<Id> ids, std::vector<uint64_t> hashes, const crn::StringUTF8 &method, size_t neighbours, const DistanceMatrix *old, const std::vector<size_t> &oldpos)
+{
+	auto dm = DistanceMatrix::Sparse(ids.size(), neighbours); // a full matrix if there are few occurrences or no neighbours
+	{
+		GtkCRN::ProgressWindow pw(_("Computing distance matrix..."), this, true);
+		const auto pid = pw.add_progress_bar("");
+		canceled = false;
+		computed = false;
+		pw.signal_delete_event().connect(sigc::bind_return(sigc::hide(sigc::mem_fun(this, &CharacterDialog::cancel_distmat)), true));
+		if (method == "gm")
+			pw.run(sigc::bind(sigc::mem_fun(this, &CharacterDialog::compute_gm), character, std::cref(ids), std::ref(dm), old, std::cref(oldpos), pw.get_crn_progress(pid)));
+		else
+			pw.run(sigc::bind(sigc::mem_fun(this, &CharacterDialog::compute_gsc), character, std::cref(ids), std::ref(dm), old, std::cref(oldpos), pw.get_crn_progress(pid)));
 	}
-	doc.SetDistanceMatrix(character, std::move(ids), std::move(dm));
+	if (!computed)
+		return; // canceled, the former matrix is kept
+	doc.SetDistanceMatrix(character, std::move(ids), std::move(dm), std::move(hashes), method); // releases the former matrix
 	update_buttons();
 }
 
-void CharacterDialog::update_distmat()
+/*! Distance between occurrences i and j, copied from the former matrix if both are unchanged */
+template<typename F> static double reuse_distance(const DistanceMatrix *old, const std::vector<size_t> &oldpos, size_t i, size_t j, const F &dist)
 {
-	delete_dm();
-	compute_distmat();
+	if (old && (oldpos[i] != std::numeric_limits<size_t>::max()) && (oldpos[j] != std::numeric_limits<size_t>::max()))
+		return old->At(oldpos[i], oldpos[j]);
+	return dist(i, j);
 }
 
-void CharacterDialog::compute_gm(const crn::String &character, const std::vector<Id> &ids, crn::SquareMatrixDouble &dm, crn::Progress *prog)
+void CharacterDialog::compute_gm(const crn::String &character, const std::vector<Id> &ids, DistanceMatrix &dm, const DistanceMatrix *old, const std::vector<size_t> &oldpos, crn::Progress *prog)
 {
-	prog->SetMaxCount(2 * ids.size());
+	prog->SetMaxCount(int(ids.size()));
 	auto grad = std::vector<crn::GradientModel>{};
 	for (const auto &v : characters[character])
 	{
@@ -216,40 +300,27 @@ void CharacterDialog::compute_gm(const crn::String &character, const std::vector
 				prog->Advance();
 			}
 	}
-	for (auto i : crn::Range(ids))
-	{
-		for (auto j = i + 1; j < ids.size(); ++j)
-		{
-			dm[i][j] = dm[j][i] = crn::GradientModel::Distance(grad[i], grad[j], 0);
-		}
-		prog->Advance();
-	}
+	const auto dist = [&grad](size_t i, size_t j) { return crn::GradientModel::Distance(grad[i], grad[j], 0); };
+	computed = dm.Compute([&](size_t i, size_t j) { return reuse_distance(old, oldpos, i, j, dist); }, prog, &canceled);
 }
 
-void CharacterDialog::compute_gsc(const crn::String &character, const std::vector<Id> &ids, crn::SquareMatrixDouble &dm, crn::Progress *prog)
+void CharacterDialog::compute_gsc(const crn::String &character, const std::vector<Id> &ids, DistanceMatrix &dm, const DistanceMatrix *old, const std::vector<size_t> &oldpos, crn::Progress *prog)
 {
-	prog->SetMaxCount(2 * ids.size());
+	prog->SetMaxCount(int(ids.size()));
 	using GSCF = crn::GradientShapeContext<8, 3, 8>;
-	using GSC = std::vector<GSCF::SC>;
-	auto grad = std::vector<GSC>{};
+	auto grad = ShapeContextSet{};
 	for (const auto &v : characters[character])
 	{
 		auto view = doc.GetView(v.first);
 		for (const auto &c : v.second)
 			if (view.IsAligned(c))
 			{
-				grad.push_back(GSCF::CreateRatio(*view.GetZoneImage(view.GetCharacter(c).GetZone())->GetGradient(), 6, 1));
+				grad.Add(GSCF::CreateRatio(*view.GetZoneImage(view.GetCharacter(c).GetZone())->GetGradient(), 6, 1));
 				prog->Advance();
 			}
 	}
-	for (auto i : crn::Range(ids))
-	{
-		for (auto j = i + 1; j < ids.size(); ++j)
-		{
-			dm[i][j] = dm[j][i] = GSCF::Distance(grad[i], grad[j]);
-		}
-		prog->Advance();
-	}
+	const auto dist = [&grad](size_t i, size_t j) { return grad.Distance(i, j); };
+	computed = dm.Compute([&](size_t i, size_t j) { return reuse_distance(old, oldpos, i, j, dist); }, prog, &canceled);
 }
 
 void CharacterDialog::delete_dm()
@@ -510,7 +581,7 @@ void CharacterTree::refresh_tv()
 		{
 			const auto &glyphs = view.GetClusters(cid);
 			if (glyphs.empty())
-				clusters[UNLABELLED].insert(cid);
+				clusters[Id{UNLABELLED}].insert(cid);
 			else
 				for (const auto &gid : glyphs)
 				{
@@ -526,7 +597,7 @@ void CharacterTree::refresh_tv()
 	}
 
 	// compute tree structure
-	auto children = std::map<Id, std::set<Id>>{};
+	auto children = std::unordered_map<Id, std::set<Id>>{}; // sets are sorted for display
 	auto topmost = std::set<Id>{};
 	for (const auto &c : clusters)
 	{
@@ -557,7 +628,7 @@ void CharacterTree::refresh_tv()
 	tv.expand_all();
 }
 
-void CharacterTree::add_children(Gtk::TreeIter &it, const Id &gid, const std::map<Id, std::set<Id>> &children)
+void CharacterTree::add_children(Gtk::TreeIter &it, const Id &gid, const std::unordered_map<Id, std::set<Id>> &children)
 {
 	auto cit = children.find(gid);
 	if (cit == children.end())
@@ -584,7 +655,7 @@ void CharacterTree::sel_changed()
 			panel.add_element(doc.GetPosition(cid), ""/*doc.GetPosition(cid).view*/, images[cid], tipimages[cid], cid);
 	}
 	else
-		current_glyph = "";
+		current_glyph = Id{};
 	panel.unlock();
 	panel.full_refresh();
 	kopanel.clear();
@@ -651,7 +722,7 @@ void CharacterTree::change_label(ValidationPanel &p)
 		{
 			auto view = doc.GetView(v.first);
 			for (const auto &cid : v.second)
-				view.GetClusters(cid).push_back(gid);
+				view.AddCluster(cid, gid);
 		}
 
 		panel.clear();
@@ -671,10 +742,7 @@ void CharacterTree::remove_from_cluster(ValidationPanel &p)
 	{
 		auto view = doc.GetView(v.first);
 		for (const auto &cid : v.second)
-		{ // remove current
-			auto &glyphs = view.GetClusters(cid);
-			glyphs.erase(std::remove(glyphs.begin(), glyphs.end(), current_glyph), glyphs.end());
-		}
+			view.RemoveCluster(cid, current_glyph);
 	}
 	panel.clear();
 	kopanel.clear();
@@ -807,28 +875,137 @@ static std::multimap<double, std::vector<size_t>> run_genetic(const crn::SquareM
 	return bestclustering;
 }
 
+/*! Cuts a set of occurrences in two using only the distances stored in a sparse matrix
+ *
+ * The graph of the nearest neighbours among the occurrences is weighted by a Gaussian kernel of the distances.
+ * The occurrences are split by the sign of the Fiedler vector of its normalized Laplacian, computed by power iteration.
+ * Occurrences that have no neighbour in the set are put in the second class.
+ * \param[in]	indices	the indices of the occurrences in the matrix
+ * \param[in]	dm	a sparse distance matrix
+ * \return	the class (0 or 1) of each occurrence
+ */
+static std::vector<size_t> bisect_graph(const std::vector<size_t> &indices, const DistanceMatrix &dm)
+{
+	static constexpr auto ITERATIONS = 300;
+	const auto nelem = indices.size();
+	auto local = std::unordered_map<size_t, size_t>{};
+	for (auto i : crn::Range(indices))
+		local.emplace(indices[i], i);
+
+	// edges inside the set, counted twice when the occurrences are mutual neighbours
+	auto edges = std::vector<std::vector<std::pair<size_t, double>>>(nelem);
+	auto dists = std::vector<double>{};
+	for (auto i : crn::Range(indices))
+	{
+		const auto *nb = dm.GetNeighbours(indices[i]);
+		for (auto tmp = size_t(0); tmp < dm.GetNeighbourCount(); ++tmp)
+		{
+			auto it = local.find(nb[tmp].index);
+			if (it == local.end())
+				continue;
+			edges[i].emplace_back(it->second, nb[tmp].distance);
+			edges[it->second].emplace_back(i, nb[tmp].distance);
+			dists.push_back(nb[tmp].distance);
+		}
+	}
+	auto classes = std::vector<size_t>(nelem, 1);
+	if (dists.empty())
+		return classes;
+	std::nth_element(dists.begin(), dists.begin() + dists.size() / 2, dists.end());
+	const auto sigma2 = crn::Max(crn::Sqr(dists[dists.size() / 2]), std::numeric_limits<double>::epsilon());
+	auto degree = std::vector<double>(nelem, 0.0);
+	for (auto i : crn::Range(edges))
+		for (auto &e : edges[i])
+		{
+			e.second = exp(-crn::Sqr(e.second) / sigma2);
+			degree[i] += e.second;
+		}
+
+	// the first eigenvector of D^-1/2 W D^-1/2 is D^1/2 1
+	auto first = std::vector<double>(nelem);
+	auto norm = 0.0;
+	for (auto i : crn::Range(degree))
+	{
+		first[i] = sqrt(degree[i]);
+		norm += degree[i];
+	}
+	norm = sqrt(norm);
+	for (auto &v : first)
+		v /= norm;
+
+	// power iteration on (I + D^-1/2 W D^-1/2) / 2, orthogonally to the first eigenvector
+	auto rng = std::default_random_engine{};
+	auto ran = std::uniform_real_distribution<double>{-1, 1};
+	auto x = std::vector<double>(nelem);
+	for (auto &v : x)
+		v = ran(rng);
+	auto y = std::vector<double>(nelem);
+	for (auto iter = 0; iter < ITERATIONS; ++iter)
+	{
+		auto proj = 0.0;
+		for (auto i : crn::Range(x))
+			proj += x[i] * first[i];
+		for (auto i : crn::Range(x))
+			x[i] -= proj * first[i];
+		for (auto i : crn::Range(x))
+		{
+			y[i] = x[i];
+			if (degree[i] > 0.0)
+				for (const auto &e : edges[i])
+					y[i] += e.second * x[e.first] / sqrt(degree[i] * degree[e.first]);
+			y[i] /= 2.0;
+		}
+		norm = 0.0;
+		for (auto v : y)
+			norm += v * v;
+		norm = sqrt(norm);
+		if (norm == 0.0)
+			break;
+		for (auto i : crn::Range(x))
+			x[i] = y[i] / norm;
+	}
+	for (auto i : crn::Range(x))
+		if ((degree[i] > 0.0) && (x[i] >= 0.0))
+			classes[i] = 0;
+	return classes;
+}
+
 std::pair<Id, Id> CharacterTree::cut(const Id &gid, const std::vector<Id> &chars, crn::Progress *prog)
 {
 	if (prog)
 		prog->SetMaxCount(4);
 
-	// compute distance matrix for selected characters
 	const auto nelem = chars.size();
 	const auto &dm = doc.GetDistanceMatrix(character);
+	auto position = std::unordered_map<Id, size_t>{};
+	for (auto tmp = size_t(0); tmp < dm.first.size(); ++tmp)
+		position.emplace(dm.first[tmp], tmp);
 	auto indices = std::vector<size_t>{};
 	indices.reserve(nelem);
 	for (const auto &cid : chars)
-		indices.push_back(std::find(dm.first.begin(), dm.first.end(), cid) - dm.first.begin());
-	auto distmat = crn::SquareMatrixDouble{nelem};
-	for (auto row : crn::Range(size_t(0), nelem))
-		for (auto col : crn::Range(size_t(0), nelem))
-			distmat[row][col] = dm.second[indices[row]][indices[col]];
-	if (prog)
-		prog->Advance();
+		indices.push_back(position[cid]);
+
+	auto bestclustering = std::vector<size_t>{};
+	if (dm.second.IsSparse())
+	{ // cut the graph of nearest neighbours in two
+		if (prog)
+			prog->Advance();
+		bestclustering = bisect_graph(indices, dm.second);
+	}
+	else
+	{
+		// compute distance matrix for selected characters
+		auto distmat = crn::SquareMatrixDouble{nelem};
+		for (auto row : crn::Range(size_t(0), nelem))
+			for (auto col : crn::Range(size_t(0), nelem))
+				distmat[row][col] = dm.second.At(indices[row], indices[col]);
+		if (prog)
+			prog->Advance();
 
-	// cut in two
-	auto res = run_genetic(distmat);
-	const auto bestclustering = res.begin()->second;
+		// cut in two
+		auto res = run_genetic(distmat);
+		bestclustering = res.begin()->second;
+	}
 	if (prog)
 		prog->Advance();
 
@@ -854,15 +1031,15 @@ std::pair<Id, Id> CharacterTree::cut(const Id &gid, const std::vector<Id> &chars
 	auto parent = gid;
 	if (gidbase == UNLABELLED)
 	{
-		gidbase = character.CStr();
-		parent = "";
+		gidbase = Id{character.CStr()};
+		parent = Id{};
 	}
 	for (auto &ngid : newglyphs)
 	{
 		auto ok = false;
 		while (!ok)
 		{
-			ngid = gidbase + "-"_s + cnt++;
+			ngid = Id{gidbase + "-"_s + cnt++};
 			try
 			{
 				doc.AddGlyph(ngid, _("Subclass for ") + gidbase, parent, true);
@@ -887,7 +1064,7 @@ std::pair<Id, Id> CharacterTree::cut(const Id &gid, const std::vector<Id> &chars
 		auto view = doc.GetView(v.first);
 		for (const auto &c : v.second)
 		{
-			view.GetClusters(c.first).push_back(c.second);
+			view.AddCluster(c.first, c.second);
 			clusters[c.second].insert(c.first);
 		}
 	}
@@ -925,11 +1102,10 @@ void CharacterTree::clear_clustering()
 		auto view = doc.GetView(v.first);
 		for (const auto &cid : v.second)
 		{
-			auto &glyphs = view.GetClusters(cid);
-			glyphs.erase(
-					std::remove_if(glyphs.begin(), glyphs.end(),
-						[this](const Id &id){ return doc.GetGlyph(id).IsAuto(); }),
-					glyphs.end());
+			const auto glyphs = view.GetClusters(cid); // copy, the list is modified
+			for (const auto &gid : glyphs)
+				if (doc.GetGlyph(gid).IsAuto())
+					view.RemoveCluster(cid, gid);
 		}
 	}
 	refresh_tv();
@@ -945,14 +1121,30 @@ void CharacterTree::auto_clustering()
 	refresh_tv();
 }
 
-static double split_score(const std::vector<Id> &sel, std::unordered_map<Id, size_t> &indices, const crn::SquareMatrixDouble &distmat)
+static double split_score(const std::vector<Id> &sel, std::unordered_map<Id, size_t> &indices, const DistanceMatrix &distmat)
 {
 	if (sel.size() <= 1)
 		return 0.0;
 	auto d = std::vector<double>{};
-	for (auto i : crn::Range(sel))
-		for (auto j = i + 1; j < sel.size(); ++j)
-			d.push_back(distmat[indices[sel[i]]][indices[sel[j]]]);
+	if (distmat.IsSparse())
+	{ // only the distances between neighbours are known
+		auto selected = std::unordered_set<size_t>{};
+		for (const auto &id : sel)
+			selected.insert(indices[id]);
+		for (const auto &id : sel)
+		{
+			const auto *nb = distmat.GetNeighbours(indices[id]);
+			for (auto tmp = size_t(0); tmp < distmat.GetNeighbourCount(); ++tmp)
+				if (selected.count(nb[tmp].index))
+					d.push_back(nb[tmp].distance);
+		}
+	}
+	else
+		for (auto i : crn::Range(sel))
+			for (auto j = i + 1; j < sel.size(); ++j)
+				d.push_back(distmat.At(indices[sel[i]], indices[sel[j]]));
+	if (d.empty())
+		return 0.0;
 	if (d.size() == 1)
 		return d.front();
 	return crn::TwoMeans(d.begin(), d.end()).second;
@@ -970,8 +1162,8 @@ void CharacterTree::auto_cut(crn::Progress *prog)
 		indices.emplace(distmat.first[tmp], tmp);
 
 	auto baseid = "auto_"_s + character.CStr();
-	try { doc.AddGlyph(baseid, _("Base class for automatic clustering of ") + crn::StringUTF8(character), "", true); } catch (...) { }
-	baseid = Glyph::LocalId(baseid);
+	try { doc.AddGlyph(Id{baseid}, _("Base class for automatic clustering of ") + crn::StringUTF8(character), Id{}, true); } catch (...) { }
+	baseid = Glyph::LocalId(Id{baseid});
 
 	auto selectionset = std::unordered_map<crn::StringUTF8, std::vector<Id>>{};
 	selectionset[baseid] = distmat.first;
@@ -989,7 +1181,7 @@ void CharacterTree::auto_cut(crn::Progress *prog)
 
 		const auto &selection = selectionset[bestsel];
 
-		const auto newglyphs = cut(bestsel, selection, nullptr);
+		const auto newglyphs = cut(Id{bestsel}, selection, nullptr);
 
 		if (newglyphs.first.IsNotEmpty() && newglyphs.second.IsNotEmpty())
 		{
@@ -1045,7 +1237,7 @@ Id GlyphSelection::get_selected_id()
 {
 	auto it = get_selection()->get_selected();
 	if (!it)
-		return "";
+		return Id{};
 	const auto id = Id(Glib::ustring((*it)[columns.id]).c_str());
 	if ((*it)[columns.global])
 		return Glyph::GlobalId(id);
@@ -26,6 +26,8 @@
 #include <gtkmm.h>
 #include <OriDocument.h>
 #include <OriValidationPanel.h>
+#include <unordered_set>
+#include <atomic>
 
 namespace ori
 {
@@ -43,16 +45,21 @@ namespace ori
 					Gtk::TreeModelColumn<size_t> count;
 			};
 
+			std::vector<Id> aligned_occurrences(const crn::String &character, std::vector<uint64_t> &hashes);
 			void update_buttons();
 			void compute_distmat();
 			void update_distmat();
-			void compute_gm(const crn::String &character, const std::vector<Id> &ids, crn::SquareMatrixDouble &dm, crn::Progress *prog);
-			void compute_gsc(const crn::String &character, const std::vector<Id> &ids, crn::SquareMatrixDouble &dm, crn::Progress *prog);
+			void run_distmat(const crn::String &character, std::vector<Id> ids, std::vector<uint64_t> hashes, const crn::StringUTF8 &method, size_t neighbours, const DistanceMatrix *old, const std::vector<size_t> &oldpos);
+			void compute_gm(const crn::String &character, const std::vector<Id> &ids, DistanceMatrix &dm, const DistanceMatrix *old, const std::vector<size_t> &oldpos, crn::Progress *prog);
+			void compute_gsc(const crn::String &character, const std::vector<Id> &ids, DistanceMatrix &dm, const DistanceMatrix *old, const std::vector<size_t> &oldpos, crn::Progress *prog);
+			void cancel_distmat() { canceled = true; }
 			void delete_dm();
 			void show_clust();
 
 			Document &doc;
 			std::map<crn::String, std::unordered_map<Id, std::vector<Id>>> characters;
+			std::atomic<bool> canceled{false}; // set when the progress window is closed
+			bool computed = false; // the last matrix was computed until the end
 
 			Gtk::TreeView tv;
 			Glib::RefPtr<Gtk::ListStore> store;
@@ -79,7 +86,7 @@ namespace ori
 
 			void init(crn::Progress *prog);
 			void refresh_tv();
-			void add_children(Gtk::TreeIter &it, const Id &gid, const std::map<Id, std::set<Id>> &children);
+			void add_children(Gtk::TreeIter &it, const Id &gid, const std::unordered_map<Id, std::set<Id>> &children);
 			void sel_changed();
 			void on_remove_chars(ValidationPanel::ElementList words);
 			void on_unremove_chars(ValidationPanel::ElementList words);
@@ -93,7 +100,7 @@ namespace ori
 
 			crn::String character;
 			Document &doc;
-			std::unordered_map<Id, std::set<Id>> clusters; // glyph id -> { character id }
+			std::unordered_map<Id, std::unordered_set<Id>> clusters; // glyph id -> { character id }
 			Id current_glyph;
 
 			Gtk::TreeView tv;
@@ -28,6 +28,9 @@ using namespace ori;
 const crn::String Config::localeDirKey(U"LocalePath");
 const crn::String Config::staticDataDirKey(U"StaticDataPath");
 const crn::String Config::fontKey(U"Font");
+const crn::String Config::weightCacheKey(U"WeightCacheSize");
+const crn::String Config::storeWeightKey(U"StoreWeightMap");
+const crn::String Config::viewCacheKey(U"ViewCacheMemory");
 
 Config::Init::Init()
 {
@@ -129,3 +132,58 @@ crn::StringUTF8 Config::GetFont()
 	}
 }
 
+size_t Config::GetWeightCacheSize()
+{
+	try
+	{
+		return size_t(GetInstance().userconf.GetStringUTF8(weightCacheKey).ToInt());
+	}
+	catch (...)
+	{
+		return 64;
+	}
+}
+
+void Config::SetWeightCacheSize(size_t n)
+{
+	GetInstance().userconf.SetData(weightCacheKey, crn::StringUTF8(int(n)));
+	Save();
+}
+
+bool Config::GetStoreWeightMap()
+{
+	try
+	{
+		return GetInstance().userconf.GetStringUTF8(storeWeightKey).ToInt() != 0;
+	}
+	catch (...)
+	{
+		return true;
+	}
+}
+
+void Config::SetStoreWeightMap(bool store)
+{
+	GetInstance().userconf.SetData(storeWeightKey, crn::StringUTF8(store ? 1 : 0));
+	Save();
+}
+
+/*! The budget is stored in megabytes */
+size_t Config::GetViewCacheMemory()
+{
+	try
+	{
+		return size_t(GetInstance().userconf.GetStringUTF8(viewCacheKey).ToInt()) << 20;
+	}
+	catch (...)
+	{
+		return size_t(2048) << 20;
+	}
+}
+
+void Config::SetViewCacheMemory(size_t bytes)
+{
+	GetInstance().userconf.SetData(viewCacheKey, crn::StringUTF8(int(bytes >> 20)));
+	Save();
+}
+
@@ -49,12 +49,24 @@ namespace ori
 			static crn::Path GetUserDirectory();
 			static void SetFont(const crn::StringUTF8 &dir);
 			static crn::StringUTF8 GetFont();
+			/*! \brief Maximal number of tiles of the weight map kept in memory for each view */
+			static size_t GetWeightCacheSize();
+			static void SetWeightCacheSize(size_t n);
+			/*! \brief Shall the weight map tiles be stored in the project? */
+			static bool GetStoreWeightMap();
+			static void SetStoreWeightMap(bool store);
+			/*! \brief Memory budget of the views kept open, in bytes */
+			static size_t GetViewCacheMemory();
+			static void SetViewCacheMemory(size_t bytes);
 
 			static Config& GetInstance();
 		private:
 			static const crn::String localeDirKey;
 			static const crn::String staticDataDirKey;
 			static const crn::String fontKey;
+			static const crn::String weightCacheKey;
+			static const crn::String storeWeightKey;
+			static const crn::String viewCacheKey;
 			Config();
 			crn::ConfigurationFile appconf;
 			crn::ConfigurationFile userconf;
@@ -0,0 +1,482 @@
+/*! Copyright 2013-2016 A2IA, CNRS, École Nationale des Chartes, ENS Lyon, INSA Lyon, Université Paris Descartes, Université de Poitiers
+ *
+ * This file is part of Oriflamms.
+ *
+ * Oriflamms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oriflamms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Oriflamms.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \file OriDistanceMatrix.cpp
+ */
+
+#include <OriDistanceMatrix.h>
+#include <OriThreadPool.h>
+#include <CRNException.h>
+#include <CRNi18n.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <tuple>
+
+using namespace ori;
+using namespace crn::literals;
+
+/* Matrix file layout
+ * 	magic (8 bytes)
+ * 	number of rows (uint64)
+ * 	upper triangle without the diagonal, row by row (n × (n - 1) / 2 floats)
+ */
+static const char DMMAGIC[8] = {'O', 'R', 'I', 'D', 'M', '0', '0', '1'};
+static const size_t DMHEADER = sizeof(DMMAGIC) + sizeof(uint64_t);
+/* Sparse matrix file layout
+ * 	magic (8 bytes)
+ * 	number of rows (uint64)
+ * 	number of neighbours per row (uint64)
+ * 	distance to the farthest neighbour of each element (n floats)
+ * 	neighbours of each element sorted by index (n × k pairs of uint32 and float)
+ */
+static const char KNNMAGIC[8] = {'O', 'R', 'I', 'K', 'N', 'N', '0', '1'};
+static const size_t KNNHEADER = sizeof(KNNMAGIC) + 2 * sizeof(uint64_t);
+
+DistanceMatrix::DistanceMatrix(size_t s):
+	n(s),
+	data(s ? s * (s - 1) / 2 : 0, 0.0f),
+	values(data.data())
+{ }
+
+/*! Maximal number of distances computed for each element of a sparse matrix, per neighbour */
+static const size_t KNNBUDGET = 64;
+
+/*! Maximal number of distances computed for each element of a sparse matrix
+ *
+ * A full matrix computes (n-1)/2 distances per element, the search never computes more.
+ */
+static size_t knnBudget(size_t n, size_t k) noexcept
+{
+	return std::max(k, std::min(KNNBUDGET * k, (n - 1) / 2));
+}
+
+/*! The vantage-point tree computes about n distances per level, then each element computes at most knnBudget() distances. */
+bool DistanceMatrix::IsSparseCheaper(size_t n, size_t k) noexcept
+{
+	if (!k || (k + 1 >= n))
+		return false;
+	auto depth = size_t(0);
+	for (auto tmp = n; tmp > 1; tmp /= 2)
+		depth += 1;
+	return n * (knnBudget(n, k) + depth) < n * (n - 1) / 2;
+}
+
+DistanceMatrix DistanceMatrix::Sparse(size_t s, size_t nk)
+{
+	if (!IsSparseCheaper(s, nk))
+		return DistanceMatrix{s};
+	auto dm = DistanceMatrix{};
+	dm.n = s;
+	dm.k = nk;
+	dm.data.resize(s, 0.0f);
+	dm.ndata.resize(s * nk, Neighbour{0, 0.0f});
+	dm.values = dm.data.data();
+	dm.neighbours = dm.ndata.data();
+	return dm;
+}
+
+double DistanceMatrix::sparseAt(size_t i, size_t j) const noexcept
+{
+	const auto find = [this](size_t row, size_t col) -> const Neighbour*
+		{
+			const auto *b = neighbours + row * k;
+			const auto *e = b + k;
+			const auto *it = std::lower_bound(b, e, col, [](const Neighbour &nb, size_t c) { return nb.index < c; });
+			return ((it != e) && (it->index == col)) ? it : nullptr;
+		};
+	const auto *nb = find(i, j);
+	if (!nb)
+		nb = find(j, i);
+	if (nb)
+		return double(nb->distance);
+	return double(std::max(values[i], values[j]));
+}
+
+/*! Number of rows and columns of a tile. The elements of two tiles must fit in the cache. */
+static const size_t DMTILE = 32;
+
+bool DistanceMatrix::Compute(const std::function<double(size_t, size_t)> &dist, crn::Progress *prog, const std::atomic<bool> *cancel, size_t nthreads)
+{
+	if (IsMapped())
+		throw crn::ExceptionDomain("DistanceMatrix::Compute(): "_s + _("The matrix is read-only."));
+	if (k)
+		return computeNearest(dist, prog, cancel, nthreads);
+	const auto ntiles = (n + DMTILE - 1) / DMTILE;
+	if (prog)
+		prog->SetMaxCount(int(ntiles * (ntiles + 1) / 2));
+	std::atomic<bool> failed{false};
+	const auto canceled = [cancel, &failed]() { return failed || (cancel && cancel->load()); };
+	auto tiles = std::vector<std::future<void>>{};
+	{
+		ThreadPool pool(nthreads);
+		for (auto ti = size_t(0); ti < ntiles; ++ti)
+			for (auto tj = ti; tj < ntiles; ++tj)
+				tiles.push_back(pool.Submit([this, ti, tj, &dist, &canceled]()
+							{
+								if (canceled())
+									return;
+								const auto iend = std::min((ti + 1) * DMTILE, n);
+								const auto jend = std::min((tj + 1) * DMTILE, n);
+								for (auto i = ti * DMTILE; i < iend; ++i)
+									for (auto j = std::max(tj * DMTILE, i + 1); j < jend; ++j)
+										data[offset(i, j)] = float(dist(i, j));
+							}));
+		for (auto &t : tiles)
+		{
+			try
+			{
+				t.get();
+			}
+			catch (...)
+			{
+				failed = true; // skip the remaining tiles
+				throw;
+			}
+			if (prog)
+				prog->Advance();
+		}
+	}
+	return !canceled();
+}
+
+/*! Number of elements whose neighbours are searched by a single task */
+static const size_t KNNCHUNK = 64;
+/*! Nodes of a vantage-point tree that are larger are split by several threads, the smaller ones are built by a single task */
+static const size_t VPPARALLEL = 4096;
+
+/*! Waits for all the tasks, then rethrows the first exception if any */
+static void waitAll(std::vector<std::future<void>> &tasks)
+{
+	for (auto &t : tasks)
+		t.wait();
+	for (auto &t : tasks)
+		t.get();
+}
+
+/*! Vantage-point tree over the elements of a matrix
+ *
+ * The tree is stored in a list of elements: the range [b, e) is a node whose first element is the vantage point,
+ * followed by the elements that are closer than its radius, then by the farther ones.
+ */
+class VPTree
+{
+	public:
+		/*! Builds the tree
+		 * \param[in]	n	number of elements
+		 * \param[in]	distance	the distance between two elements
+		 * \param[in]	pool	the threads computing the distances
+		 * \param[in]	canceled	returns true if the construction must stop
+		 */
+		VPTree(size_t n, const std::function<double(size_t, size_t)> &distance, ThreadPool &pool, const std::function<bool()> &canceled):
+			dist(distance),
+			items(n),
+			radius(n, 0.0f)
+		{
+			for (auto tmp = size_t(0); tmp < n; ++tmp)
+				items[tmp] = uint32_t(tmp);
+			auto tasks = std::vector<std::future<void>>{};
+			try
+			{
+				build(0, n, pool, canceled, tasks);
+			}
+			catch (...)
+			{
+				stop = true;
+				for (auto &t : tasks)
+					t.wait(); // the tasks use the tree
+				throw;
+			}
+			waitAll(tasks);
+		}
+
+		/*! Finds the nearest neighbours of an element
+		 *
+		 * The nodes are visited by increasing lower bound of the distance to their elements, so that the nearest elements are found first when the number of distances is limited.
+		 * \param[in]	q	the element
+		 * \param[in]	k	number of neighbours
+		 * \param[in]	budget	maximal number of distances to compute
+		 * \param[out]	nearest	the neighbours, as a max-heap of distances and indices
+		 */
+		void Search(size_t q, size_t k, size_t budget, std::vector<std::pair<float, uint32_t>> &nearest) const
+		{
+			nearest.clear();
+			const auto tau = [&nearest, k]() { return nearest.size() < k ? std::numeric_limits<float>::max() : nearest.front().first; };
+			using Node = std::tuple<float, size_t, size_t>; // lower bound, first and last element
+			auto nodes = std::vector<Node>{};
+			const auto push = [&nodes](float bound, size_t b, size_t e)
+				{
+					if (b >= e)
+						return;
+					nodes.emplace_back(bound, b, e);
+					std::push_heap(nodes.begin(), nodes.end(), std::greater<Node>{});
+				};
+			push(0.0f, 0, items.size());
+			auto evals = size_t(0);
+			while (!nodes.empty() && (evals < budget))
+			{
+				std::pop_heap(nodes.begin(), nodes.end(), std::greater<Node>{});
+				const auto node = nodes.back();
+				nodes.pop_back();
+				const auto bound = std::get<0>(node);
+				if (bound > tau())
+					break; // the other nodes are farther
+				const auto b = std::get<1>(node), e = std::get<2>(node);
+				const auto v = items[b];
+				auto d = 0.0f;
+				if (v != q)
+				{
+					d = float(dist(q, v));
+					evals += 1;
+					if (nearest.size() < k)
+					{
+						nearest.emplace_back(d, v);
+						std::push_heap(nearest.begin(), nearest.end());
+					}
+					else if (d < nearest.front().first)
+					{
+						std::pop_heap(nearest.begin(), nearest.end());
+						nearest.back() = std::make_pair(d, v);
+						std::push_heap(nearest.begin(), nearest.end());
+					}
+				}
+				// triangle inequality
+				push(std::max(bound, d - radius[b]), b + 1, middle(b, e));
+				push(std::max(bound, radius[b] - d), middle(b, e), e);
+			}
+		}
+
+	private:
+		/*! Index of the first far element of a node */
+		static size_t middle(size_t b, size_t e) noexcept { return b + 1 + (e - b - 1) / 2; }
+
+		void build(size_t b, size_t e, ThreadPool &pool, const std::function<bool()> &canceled, std::vector<std::future<void>> &tasks)
+		{
+			if ((e - b <= 1) || canceled())
+				return;
+			if (e - b <= VPPARALLEL)
+			{ // the whole subtree in a single task
+				tasks.push_back(pool.Submit([this, b, e, &canceled]()
+							{
+								try
+								{
+									buildNode(b, e, canceled);
+								}
+								catch (...)
+								{
+									stop = true;
+									throw;
+								}
+							}));
+				return;
+			}
+			std::swap(items[b], items[b + (e - b) / 2]);
+			auto d = std::vector<std::pair<float, uint32_t>>(e - b - 1);
+			const auto nchunks = (d.size() + VPPARALLEL - 1) / VPPARALLEL;
+			auto chunks = std::vector<std::future<void>>{};
+			for (auto c = size_t(0); c < nchunks; ++c)
+				chunks.push_back(pool.Submit([this, b, c, &d]()
+							{
+								const auto end = std::min((c + 1) * VPPARALLEL, d.size());
+								for (auto tmp = c * VPPARALLEL; tmp < end; ++tmp)
+									d[tmp] = std::make_pair(float(dist(items[b], items[b + 1 + tmp])), items[b + 1 + tmp]);
+							}));
+			waitAll(chunks);
+			split(b, e, d);
+			build(b + 1, middle(b, e), pool, canceled, tasks);
+			build(middle(b, e), e, pool, canceled, tasks);
+		}
+
+		void buildNode(size_t b, size_t e, const std::function<bool()> &canceled)
+		{
+			if ((e - b <= 1) || stop || canceled())
+				return;
+			std::swap(items[b], items[b + (e - b) / 2]);
+			auto d = std::vector<std::pair<float, uint32_t>>(e - b - 1);
+			for (auto tmp = size_t(0); tmp < d.size(); ++tmp)
+				d[tmp] = std::make_pair(float(dist(items[b], items[b + 1 + tmp])), items[b + 1 + tmp]);
+			split(b, e, d);
+			buildNode(b + 1, middle(b, e), canceled);
+			buildNode(middle(b, e), e, canceled);
+		}
+
+		/*! Sorts the elements of a node around the median distance to the vantage point */
+		void split(size_t b, size_t e, std::vector<std::pair<float, uint32_t>> &d)
+		{
+			const auto m = middle(b, e) - b - 1;
+			std::nth_element(d.begin(), d.begin() + m, d.end());
+			radius[b] = d[m].first;
+			for (auto tmp = size_t(0); tmp < d.size(); ++tmp)
+				items[b + 1 + tmp] = d[tmp].second;
+		}
+
+		const std::function<double(size_t, size_t)> &dist;
+		std::vector<uint32_t> items;
+		std::vector<float> radius; // radius of the node starting at each position
+		std::atomic<bool> stop{false}; // a task failed
+};
+
+/*! The tree is built first, then the neighbours of groups of elements are searched in parallel. */
+bool DistanceMatrix::computeNearest(const std::function<double(size_t, size_t)> &dist, crn::Progress *prog, const std::atomic<bool> *cancel, size_t nthreads)
+{
+	const auto nchunks = (n + KNNCHUNK - 1) / KNNCHUNK;
+	if (prog)
+		prog->SetMaxCount(int(nchunks + 1));
+	std::atomic<bool> failed{false};
+	const auto canceled = std::function<bool()>{[cancel, &failed]() { return failed || (cancel && cancel->load()); }};
+	auto chunks = std::vector<std::future<void>>{};
+	auto tree = std::unique_ptr<VPTree>{}; // destroyed after the pool
+	{
+		ThreadPool pool(nthreads);
+		try
+		{
+			tree = std::make_unique<VPTree>(n, dist, pool, canceled);
+			if (prog)
+				prog->Advance();
+			for (auto c = size_t(0); c < nchunks; ++c)
+				chunks.push_back(pool.Submit([this, c, &tree, &canceled]()
+							{
+								if (canceled())
+									return;
+								auto nearest = std::vector<std::pair<float, uint32_t>>{};
+								const auto end = std::min((c + 1) * KNNCHUNK, n);
+								for (auto i = c * KNNCHUNK; i < end; ++i)
+								{
+									tree->Search(i, k, knnBudget(n, k), nearest);
+									auto *row = ndata.data() + i * k;
+									data[i] = nearest.empty() ? 0.0f : nearest.front().first; // farthest neighbour
+									std::sort(nearest.begin(), nearest.end(), [](const std::pair<float, uint32_t> &n1, const std::pair<float, uint32_t> &n2) { return n1.second < n2.second; });
+									for (auto tmp = size_t(0); tmp < k; ++tmp)
+										row[tmp] = Neighbour{nearest[tmp].second, nearest[tmp].first};
+								}
+							}));
+			for (auto &c : chunks)
+			{
+				c.get();
+				if (prog)
+					prog->Advance();
+			}
+		}
+		catch (...)
+		{
+			failed = true; // skip the remaining tasks
+			throw;
+		}
+	}
+	return !canceled();
+}
+
+DistanceMatrix DistanceMatrix::Map(const crn::Path &fname)
+{
+	auto dm = DistanceMatrix{};
+	dm.file = MappedFile{fname};
+	const auto *ptr = dm.file.GetData();
+	if ((dm.file.GetSize() >= KNNHEADER) && !memcmp(ptr, KNNMAGIC, sizeof(KNNMAGIC)))
+	{ // sparse matrix
+		auto s = uint64_t{}, nk = uint64_t{};
+		memcpy(&s, ptr + sizeof(KNNMAGIC), sizeof(s));
+		memcpy(&nk, ptr + sizeof(KNNMAGIC) + sizeof(s), sizeof(nk));
+		if (!nk || (dm.file.GetSize() != KNNHEADER + size_t(s) * sizeof(float) + size_t(s * nk) * sizeof(Neighbour)))
+			throw crn::ExceptionInvalidArgument("DistanceMatrix::Map(): "_s + _("Not a distance matrix file: ") + fname);
+		dm.n = size_t(s);
+		dm.k = size_t(nk);
+		dm.values = reinterpret_cast<const float*>(ptr + KNNHEADER);
+		dm.neighbours = reinterpret_cast<const Neighbour*>(ptr + KNNHEADER + dm.n * sizeof(float));
+		return dm;
+	}
+	auto s = uint64_t{};
+	if (dm.file.GetSize() >= DMHEADER)
+		memcpy(&s, ptr + sizeof(DMMAGIC), sizeof(s));
+	if ((dm.file.GetSize() < DMHEADER) || memcmp(ptr, DMMAGIC, sizeof(DMMAGIC)) || (dm.file.GetSize() != DMHEADER + size_t(s ? s * (s - 1) / 2 : 0) * sizeof(float)))
+		throw crn::ExceptionInvalidArgument("DistanceMatrix::Map(): "_s + _("Not a distance matrix file: ") + fname);
+	dm.n = size_t(s);
+	dm.values = reinterpret_cast<const float*>(ptr + DMHEADER);
+	return dm;
+}
+
+DistanceMatrix DistanceMatrix::ReadDense(const crn::Path &dense, size_t n)
+{
+	std::ifstream in;
+	in.open(dense.CStr(), std::ios::in | std::ios::binary);
+	auto dm = DistanceMatrix{n};
+	auto row = std::vector<double>(n);
+	for (auto i = size_t(0); i < n; ++i)
+	{ // one row at a time
+		in.read(reinterpret_cast<char*>(row.data()), std::streamsize(n * sizeof(double)));
+		for (auto j = i + 1; j < n; ++j)
+			dm.data[dm.offset(i, j)] = float(row[j]);
+	}
+	if (!in)
+		throw crn::ExceptionIO("DistanceMatrix::ReadDense(): "_s + _("Cannot read file: ") + dense);
+	return dm;
+}
+
+DistanceMatrix::DistanceMatrix(DistanceMatrix &&other) noexcept
+{
+	*this = std::move(other);
+}
+
+DistanceMatrix& DistanceMatrix::operator=(DistanceMatrix &&other) noexcept
+{
+	if (this != &other)
+	{
+		n = other.n;
+		k = other.k;
+		data = std::move(other.data);
+		ndata = std::move(other.ndata);
+		file = std::move(other.file);
+		values = other.values;
+		neighbours = other.neighbours;
+		other.n = 0;
+		other.k = 0;
+		other.data.clear();
+		other.ndata.clear();
+		other.values = nullptr;
+		other.neighbours = nullptr;
+	}
+	return *this;
+}
+
+void DistanceMatrix::Save(const crn::Path &fname) const
+{
+	const auto tmpname = fname + ".tmp";
+	std::ofstream out;
+	out.open(tmpname.CStr(), std::ios::out | std::ios::binary | std::ios::trunc);
+	const auto s = uint64_t(n);
+	if (k)
+	{
+		const auto nk = uint64_t(k);
+		out.write(KNNMAGIC, sizeof(KNNMAGIC));
+		out.write(reinterpret_cast<const char*>(&s), sizeof(s));
+		out.write(reinterpret_cast<const char*>(&nk), sizeof(nk));
+		out.write(reinterpret_cast<const char*>(values), std::streamsize(n * sizeof(float)));
+		out.write(reinterpret_cast<const char*>(neighbours), std::streamsize(n * k * sizeof(Neighbour)));
+	}
+	else
+	{
+		out.write(DMMAGIC, sizeof(DMMAGIC));
+		out.write(reinterpret_cast<const char*>(&s), sizeof(s));
+		out.write(reinterpret_cast<const char*>(values), std::streamsize((n ? n * (n - 1) / 2 : 0) * sizeof(float)));
+	}
+	out.close();
+	if (!out)
+		throw crn::ExceptionIO("DistanceMatrix::Save(): "_s + _("Cannot write file: ") + tmpname);
+	ReplaceFileAtomically(tmpname, fname);
+}
+
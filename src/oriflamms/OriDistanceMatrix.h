@@ -0,0 +1,148 @@
+/*! Copyright 2013-2016 A2IA, CNRS, École Nationale des Chartes, ENS Lyon, INSA Lyon, Université Paris Descartes, Université de Poitiers
+ *
+ * This file is part of Oriflamms.
+ *
+ * Oriflamms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oriflamms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Oriflamms.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \file OriDistanceMatrix.h
+ */
+
+#ifndef OriDistanceMatrix_HEADER
+#define OriDistanceMatrix_HEADER
+
+#include <oriflamms_config.h>
+#include <OriIO.h>
+#include <CRNUtils/CRNProgress.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace ori
+{
+	/*! \brief Symmetric distance matrix with a zero diagonal
+	 *
+	 * A full matrix stores only the upper triangle, row by row, in single precision.
+	 * A sparse matrix stores only the distances from each element to its k nearest neighbours. The distance between two elements that are not neighbours is estimated by the largest of the distances to their farthest neighbours. It would be a lower bound if the neighbours were exact, but the search is approximate when the number of distances is limited, so it is only an estimate.
+	 * The values are either held in memory or read from a file mapped in memory. A mapped matrix is read-only.
+	 */
+	class DistanceMatrix
+	{
+		public:
+			/*! \brief Creates an empty matrix */
+			DistanceMatrix() noexcept {}
+			/*! \brief Creates a matrix filled with zeros in memory
+			 * \param[in]	n	number of rows and columns
+			 */
+			DistanceMatrix(size_t n);
+			/*! \brief Creates a sparse matrix in memory, that keeps the distances to the nearest neighbours of each element
+			 * \param[in]	n	number of rows and columns
+			 * \param[in]	k	number of neighbours of each element. If the search would not be cheaper than a full matrix (see IsSparseCheaper()), a full matrix is created.
+			 */
+			static DistanceMatrix Sparse(size_t n, size_t k);
+			/*! \brief Does searching the neighbours of n elements compute fewer distances than the n(n-1)/2 of a full matrix? */
+			static bool IsSparseCheaper(size_t n, size_t k) noexcept;
+			/*! \brief Maps a matrix file
+			 * \throws	crn::ExceptionIO	cannot map the file
+			 * \throws	crn::ExceptionInvalidArgument	not a distance matrix file
+			 */
+			static DistanceMatrix Map(const crn::Path &fname);
+			/*! \brief Reads a dense matrix of doubles written by former versions in memory
+			 * \throws	crn::ExceptionIO	cannot read the file
+			 * \param[in]	dense	the dense matrix file
+			 * \param[in]	n	number of rows and columns of the dense matrix
+			 */
+			static DistanceMatrix ReadDense(const crn::Path &dense, size_t n);
+
+			DistanceMatrix(const DistanceMatrix&) = delete;
+			DistanceMatrix& operator=(const DistanceMatrix&) = delete;
+			DistanceMatrix(DistanceMatrix&&) noexcept;
+			DistanceMatrix& operator=(DistanceMatrix&&) noexcept;
+
+			/*! \brief Gets the number of rows and columns */
+			size_t GetSize() const noexcept { return n; }
+			/*! \brief Is the matrix mapped from a file? */
+			bool IsMapped() const noexcept { return file.IsOpen(); }
+			/*! \brief Are only the distances to the nearest neighbours stored? */
+			bool IsSparse() const noexcept { return k != 0; }
+
+			/*! \brief A neighbour of an element in a sparse matrix */
+			struct Neighbour
+			{
+				uint32_t index;
+				float distance;
+			};
+			/*! \brief Gets the number of neighbours of each element in a sparse matrix (0 for a full matrix) */
+			size_t GetNeighbourCount() const noexcept { return k; }
+			/*! \brief Gets the neighbours of an element in a sparse matrix, sorted by index (no bound checking) */
+			const Neighbour* GetNeighbours(size_t i) const noexcept { return neighbours + i * k; }
+
+			/*! \brief Gets the distance between two elements, estimated if a sparse matrix does not hold it (no bound checking) */
+			double At(size_t i, size_t j) const noexcept
+			{
+				if (i == j)
+					return 0.0;
+				if (k)
+					return sparseAt(i, j);
+				if (i > j)
+					std::swap(i, j);
+				return double(values[offset(i, j)]);
+			}
+			/*! \brief Sets the distance between two elements (no bound checking, only for a full matrix in memory) */
+			void Set(size_t i, size_t j, double d) noexcept
+			{
+				if (i == j)
+					return;
+				if (i > j)
+					std::swap(i, j);
+				data[offset(i, j)] = float(d);
+			}
+
+			/*! \brief Computes all the distances in parallel
+			 *
+			 * The upper triangle of a full matrix is cut in square tiles that are computed by a pool of threads, so that the elements of a tile stay in the cache.
+			 * The neighbours of the elements of a sparse matrix are searched in a vantage-point tree, with a limited number of distances computed for each element, never more than half the other elements. The search is exact if the distance is a metric and the limit is not reached.
+			 * \throws	crn::ExceptionDomain	the matrix is mapped
+			 * \param[in]	dist	the distance between two elements, called from several threads at once
+			 * \param[in]	prog	a progress bar, advanced from the calling thread for each tile or group of elements
+			 * \param[in]	cancel	if set to true, the tiles that are not started yet are not computed
+			 * \param[in]	nthreads	number of threads (0 for the number of cores)
+			 * \return	false if the computation was canceled
+			 */
+			bool Compute(const std::function<double(size_t, size_t)> &dist, crn::Progress *prog = nullptr, const std::atomic<bool> *cancel = nullptr, size_t nthreads = 0);
+
+			/*! \brief Writes the matrix to a file
+			 * \throws	crn::ExceptionIO	cannot write the file
+			 */
+			void Save(const crn::Path &fname) const;
+
+		private:
+			/*! \brief Index of (i, j) with i < j in the packed upper triangle */
+			size_t offset(size_t i, size_t j) const noexcept { return i * (2 * n - i - 1) / 2 + j - i - 1; }
+			double sparseAt(size_t i, size_t j) const noexcept;
+			bool computeNearest(const std::function<double(size_t, size_t)> &dist, crn::Progress *prog, const std::atomic<bool> *cancel, size_t nthreads);
+
+			size_t n = 0;
+			size_t k = 0; // number of neighbours of each element, 0 for a full matrix
+			std::vector<float> data; // upper triangle, or distance to the farthest neighbour of each element
+			std::vector<Neighbour> ndata;
+			MappedFile file;
+			const float *values = nullptr;
+			const Neighbour *neighbours = nullptr;
+	};
+}
+
+#endif
+
@@ -24,6 +24,12 @@
 #include <OriDocument.h>
 #include <CRNIO/CRNIO.h>
 #include <OriLines.h>
+#include <OriWeightMap.h>
+#include <OriIO.h>
+#include <OriDistanceMatrix.h>
+#include <OriXmlReader.h>
+#include <OriThreadPool.h>
+#include <OriJournal.h>
 #include <CRNAI/CRNPathFinding.h>
 #include <CRNImage/CRNDifferential.h>
 #include <OriViewImpl.h>
@@ -35,6 +41,10 @@
 
 #include <iostream>
 #include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_set>
 
 using namespace ori;
 using namespace crn::literals;
@@ -115,6 +125,7 @@ void Zone::SetPosition(const crn::Rect &r)
 	if (!r.IsValid())
 		throw crn::ExceptionInvalidArgument{"Zone::SetPosition(): "_s + _("null rectangle.")};
 	pos = r;
+	touch();
 	el.SetAttribute("ulx", pos.GetLeft());
 	el.SetAttribute("uly", pos.GetTop());
 	el.SetAttribute("lrx", pos.GetRight());
@@ -126,6 +137,7 @@ void Zone::SetContour(const std::vector<crn::Point2DInt> &c)
 	if (c.size() < 3)
 		throw crn::ExceptionInvalidArgument{"Zone::SetContour(): "_s + _("the contour has less than 3 points.")};
 	box = c;
+	touch();
 	auto str = ""_s;
 	for (const auto &pt : box)
 		str += pt.X + ","_s + pt.Y + " "_s;
@@ -135,6 +147,7 @@ void Zone::SetContour(const std::vector<crn::Point2DInt> &c)
 
 void Zone::Clear()
 {
+	touch();
 	pos = crn::Rect{};
 	el.RemoveAttribute("ulx");
 	el.RemoveAttribute("uly");
@@ -144,29 +157,49 @@ void Zone::Clear()
 	el.RemoveAttribute("points");
 }
 
-//////////////////////////////////////////////////////////////////////////////////
-// Line
-//////////////////////////////////////////////////////////////////////////////////
-const std::vector<Id>& Line::GetWords() const
+/*! FNV-1a hash of the coordinates */
+uint64_t Zone::GetHash() const noexcept
 {
-	if (!center.empty())
+	auto h = uint64_t(14695981039346656037ull);
+	const auto add = [&h](int v)
+		{
+			h = (h ^ uint64_t(uint32_t(v))) * 1099511628211ull;
+		};
+	const auto &r = GetPosition();
+	if (r.IsValid())
 	{
-		std::move(center.begin(), center.end(), std::back_inserter(left));
-		center.clear();
-		center.shrink_to_fit();
+		add(r.GetLeft());
+		add(r.GetTop());
+		add(r.GetRight());
+		add(r.GetBottom());
 	}
-	if (!right.empty())
+	for (const auto &pt : box)
 	{
-		std::move(right.begin(), right.end(), std::back_inserter(left));
-		right.clear();
-		right.shrink_to_fit();
+		add(pt.X);
+		add(pt.Y);
 	}
-	return left;
+	return h;
 }
 
 //////////////////////////////////////////////////////////////////////////////////
 // View::Impl
 //////////////////////////////////////////////////////////////////////////////////
+/*! Writes an XML document to a temporary file that then replaces the destination, so that an interrupted save does not corrupt the file */
+static void saveXml(crn::xml::Document &doc, const crn::Path &fname)
+{
+	const auto tmp = fname + ".tmp";
+	doc.Save(tmp);
+	ReplaceFileAtomically(tmp, fname);
+}
+
+/*! Prepares the writing of a file whose content is copied now, to write it later on any thread */
+static std::function<void()> writeLater(const crn::Path &fname, const crn::StringUTF8 &content)
+{
+	return [fname, content]() { WriteFileAtomically(fname, content.CStr(), content.Size()); };
+}
+
+constexpr size_t View::Impl::NONE;
+
 View::Impl::Impl(const Id &surfid, Document::ViewStructure &s, const crn::Path &base, const crn::StringUTF8 &projname, bool clean):
 	id(surfid),
 	struc(s)
@@ -174,8 +207,8 @@ View::Impl::Impl(const Id &surfid, Document::ViewStructure &s, const crn::Path &
 	std::lock_guard<std::mutex> flock(crn::FileShield::GetMutex("views://" + id));
 
 	// read ZONEDIR/projname_id-zones.xml for boxes and image
-	const auto zonesdocpath = base / ZONEDIR / projname + "_" + crn::Path{id} + "-zones.xml";
-	zonesdoc = crn::xml::Document{zonesdocpath};
+	zonespath = base / ZONEDIR / projname + "_" + crn::Path{id} + "-zones.xml";
+	zonesdoc = crn::xml::Document{zonespath};
 	auto root = zonesdoc.GetRoot();
 	auto el = root.GetFirstChildElement("facsimile");
 	if (!el)
@@ -191,8 +224,8 @@ View::Impl::Impl(const Id &surfid, Document::ViewStructure &s, const crn::Path &
 	readZoneElements(el);
 
 	// read LINKDIR/projname_id-links.xml for boxes
-	const auto linksdocpath = base / LINKDIR / projname + "_" + crn::Path{id} + "-links.xml";
-	linksdoc = crn::xml::Document{linksdocpath};
+	linkspath = base / LINKDIR / projname + "_" + crn::Path{id} + "-links.xml";
+	linksdoc = crn::xml::Document{linkspath};
 	root = linksdoc.GetRoot();
 	el = root.GetFirstChildElement("text");
 	if (!el)
@@ -204,6 +237,7 @@ View::Impl::Impl(const Id &surfid, Document::ViewStructure &s, const crn::Path &
 	if (!el)
 		throw crn::ExceptionNotFound(projname + "_" + id + "-links.xml: " + _("no ab element."));
 	readLinkElements(el, clean);
+	linkZones();
 	if (link_groups.find(SURFACELINKS) == link_groups.end())
 		throw crn::ExceptionNotFound(projname + "_" + id + "-links.xml: " + _("no linkGrp element for the surfaces."));
 	if (link_groups.find(PAGELINKS) == link_groups.end())
@@ -218,10 +252,10 @@ View::Impl::Impl(const Id &surfid, Document::ViewStructure &s, const crn::Path &
 		link_groups.emplace(CHARLINKS, el.PushBackElement("linkGrp")).first->second.SetAttribute("type", CHARLINKS);
 
 	// read or create ONTOLINKDIR/projname_id-links.xml for links between characters and classes
-	const auto ontolinksdocpath = base / ONTOLINKDIR / projname + "_" + crn::Path{id} + "-ontolinks.xml";
+	ontolinkspath = base / ONTOLINKDIR / projname + "_" + crn::Path{id} + "-ontolinks.xml";
 	try
 	{
-		ontolinksdoc = crn::xml::Document{ontolinksdocpath};
+		ontolinksdoc = crn::xml::Document{ontolinkspath};
 	}
 	catch (...)
 	{
@@ -256,8 +290,7 @@ View::Impl::Impl(const Id &surfid, Document::ViewStructure &s, const crn::Path &
 		el = el.PushBackElement("body");
 		el = el.PushBackElement("ab");
 		el = el.PushBackElement("linkGrp");
-		el.SetAttribute("type", "words");
-		ontolinksdoc.Save(base / ONTOLINKDIR / projname + "_" + crn::Path{id} + "-ontolinks.xml");
+		el.SetAttribute("type", "words"); // the file is written when a link is added
 	}
 	root = ontolinksdoc.GetRoot();
 	el = root.GetFirstChildElement("text");
@@ -272,6 +305,7 @@ View::Impl::Impl(const Id &surfid, Document::ViewStructure &s, const crn::Path &
 	ontolinkgroup = std::make_unique<crn::xml::Element>(el.GetFirstChildElement("linkGrp"));
 	if (!*ontolinkgroup)
 		throw crn::ExceptionNotFound(projname + "_" + id + "-ontolinks.xml: " + _("no linkGrp element."));
+	onto_links.resize(struc.characters.size());
 	el = ontolinkgroup->GetFirstChildElement("link");
 	while (el)
 	{
@@ -281,11 +315,11 @@ View::Impl::Impl(const Id &surfid, Document::ViewStructure &s, const crn::Path &
 		for (const auto &part : target)
 		{
 			if (part.StartsWith("txt:"))
-				cid = part.SubString(4);
+				cid = Id{part.SubString(4)};
 			else if (part.StartsWith(LOCALGLYPH))
-				gids.push_back(part);
+				gids.emplace_back(part);
 			else if (part.StartsWith(GLOBALGLYPH))
-				gids.push_back(part);
+				gids.emplace_back(part);
 			else
 				throw crn::ExceptionInvalidArgument(projname + "_" + id + "-ontolinks.xml: " + _("invalid target base."));
 		}
@@ -294,57 +328,135 @@ View::Impl::Impl(const Id &surfid, Document::ViewStructure &s, const crn::Path &
 
 		std::sort(gids.begin(), gids.end());
 		gids.erase(std::unique(gids.begin(), gids.end()), gids.end());
-		onto_links.emplace(std::move(cid), std::move(gids));
+		auto it = struc.Find(ElementKind::Character, cid);
+		if (!it)
+			logmsg += id + "-ontolinks: "_s + _("target points to an unknown character: ") + cid + "\n";
+		else
+			onto_links[it->index] = std::move(gids);
 
 		el = el.GetNextSiblingElement("link");
 	}
 
 	// read or create oriflamms file
+	validation.resize(struc.words.size(), WordValidation{crn::Prop3::Unknown()});
+	medlines.resize(struc.columns.size());
+	line_links.resize(struc.lines.size(), std::make_pair(NONE, NONE));
 	datapath = base / ORIDIR / projname + "_" + crn::Path{id};
-	if (crn::IO::Access(datapath + "-oridata.xml", crn::IO::EXISTS))
+	if (crn::IO::Access(datapath + "-oridata.bin", crn::IO::EXISTS) || crn::IO::Access(datapath + "-oridata.xml", crn::IO::EXISTS))
 	{
 		load();
 	}
 	else
 	{ // create file
-		for (const auto &p : struc.words)
-			validation.emplace(p.first, crn::Prop3::Unknown());
-		for (const auto &p : struc.columns)
+		for (auto c = size_t(0); c < struc.columns.size(); ++c)
 		{
-			medlines.emplace(p.first, std::vector<GraphicalLine>{}); // create empty line
-			auto cnt = size_t(0);
-			for (const auto &lid : p.second.GetLines())
-				line_links.emplace(lid, std::make_pair(p.first, cnt++));
+			const auto &col = struc.columns[c];
+			for (auto l = size_t(0); l < col.GetLines().size(); ++l)
+				line_links[col.first_line + l] = std::make_pair(c, l);
 		}
 		//save();
 	}
+
+	// replay the edits that were not saved
+	try
+	{
+		journal = std::make_shared<Journal>(datapath + "-journal.bin");
+		replayJournal();
+	}
+	catch (crn::Exception &ex)
+	{ // the edits will only be saved with the files
+		CRNWarning(id + ": "_s + ex.what());
+	}
 }
 
 View::Impl::~Impl()
 {
-	save();
+	try
+	{
+		save();
+	}
+	catch (std::exception &ex)
+	{ // the journal still holds the edits
+		CRNWarning(id + ": "_s + ex.what());
+	}
 }
 
 void View::Impl::readZoneElements(crn::xml::Element &el)
 {
 	if (el.GetName() == "zone")
 	{
-		const auto id = el.GetAttribute<Id>("xml:id", true);
+		const auto id = Id{el.GetAttribute<crn::StringUTF8>("xml:id", true)};
 		if (id.IsEmpty())
 			throw crn::ExceptionNotFound(this->id + "-zones.xml: " + _("zone without an id."));
-		zones.emplace(id, Zone{el});
+		if (zone_index.emplace(id, zones.size()).second)
+		{
+			zones.emplace_back(el);
+			zones.back().modified = &modified.zones;
+		}
 	}
 	for (auto sel = el.BeginElement(); sel != el.EndElement(); ++sel)
 		readZoneElements(sel);
 }
 
-void View::Impl::readLinkElements(crn::xml::Element &el, bool clean)
+/*! Gets the type of the elements of a link group
+ * \return	false if the group does not link text elements
+ */
+static bool linkKind(const crn::StringUTF8 &type, ElementKind &kind)
+{
+	if (type == PAGELINKS)
+		kind = ElementKind::Page;
+	else if (type == COLUMNLINKS)
+		kind = ElementKind::Column;
+	else if (type == LINELINKS)
+		kind = ElementKind::Line;
+	else if (type == WORDLINKS)
+		kind = ElementKind::Word;
+	else if (type == CHARLINKS)
+		kind = ElementKind::Character;
+	else
+		return false;
+	return true;
+}
+
+static crn::StringUTF8 unknownElementMessage(ElementKind kind)
 {
+	switch (kind)
+	{
+		case ElementKind::Page:
+			return _("target points to an unknown page: ");
+		case ElementKind::Column:
+			return _("target points to an unknown column: ");
+		case ElementKind::Line:
+			return _("target points to an unknown line: ");
+		case ElementKind::Word:
+			return _("target points to an unknown word: ");
+		default:
+			return _("target points to an unknown character: ");
+	}
+}
+
+/*! Reads the links between text elements and zones
+ * \throws	crn::ExceptionInvalidArgument	malformed link
+ * \param[in]	el	the element containing the link groups
+ * \param[in]	viewid	the id of the view
+ * \param[in]	struc	the structure of the view
+ * \param[in]	has_zone	predicate telling if a zone id exists
+ * \param[in]	on_group	called for each link group with its type and element
+ * \param[in]	on_link	called for each valid link with the type and index of the element and the id of the zone
+ * \param[in]	clean	shall invalid links be removed instead of reported?
+ * \param[out]	log	the report of invalid links
+ * \return	true if links were removed
+ */
+template<typename HasZone, typename OnGroup, typename OnLink> static bool readLinks(crn::xml::Element &el, const Id &viewid, const Document::ViewStructure &struc, HasZone has_zone, OnGroup on_group, OnLink on_link, bool clean, crn::StringUTF8 &log)
+{
+	auto removed = false;
 	auto grel = el.GetFirstChildElement("linkGrp");
 	while (grel)
 	{
 		const auto type = grel.GetAttribute<crn::StringUTF8>("type", false);
-		link_groups.emplace(type, grel);
+		on_group(type, grel);
+		auto kind = ElementKind::Page;
+		const auto textlinks = linkKind(type, kind); // the surface links are not checked
 
 		auto lel = grel.GetFirstChildElement("link");
 		while (lel)
@@ -360,128 +472,313 @@ void View::Impl::readLinkElements(crn::xml::Element &el, bool clean)
 				else if (target.StartsWith("img:"))
 					zoneid = target.SubString(4, 0);
 				else
-					throw crn::ExceptionInvalidArgument(id + "-links: " + _("invalid target base."));
+					throw crn::ExceptionInvalidArgument(viewid + "-links: " + _("invalid target base."));
 			}
 			if (txtid.IsEmpty() || zoneid.IsEmpty())
-				throw crn::ExceptionInvalidArgument(id + "-links: " + _("incomplete target."));
-			if (type == SURFACELINKS)
-			{ // well... errrrrrrrrr... we could check if the target is consistent
-			}
-			else if (type == PAGELINKS )
-			{
-				auto it = struc.pages.find(txtid);
-				if (it == struc.pages.end())
-				{
-					if (clean)
-						delnode = true;
-					else
-						logmsg += id + "-links: "_s + _("target points to an unknown page: ") + txtid + "\n";
-				}
-				else if (zones.find(zoneid) == zones.end())
-				{
-					if (clean)
-						delnode = true;
-					else
-						logmsg += id + "-links: "_s + _("target points to an unknown zone: ") + zoneid + "\n";
-				}
-				else
-					it->second.zone = zoneid;
-			}
-			else if (type == COLUMNLINKS )
-			{
-				auto it = struc.columns.find(txtid);
-				if (it == struc.columns.end())
-				{
-					if (clean)
-						delnode = true;
-					else
-						logmsg += id + "-links: "_s + _("target points to an unknown column: ") + txtid + "\n";
-				}
-				else if (zones.find(zoneid) == zones.end())
-				{
-					if (clean)
-						delnode = true;
-					else
-						logmsg += id + "-links: "_s + _("target points to an unknown zone: ") + zoneid + "\n";
-				}
-				else
-					it->second.zone = zoneid;
-			}
-			else if (type == LINELINKS )
+				throw crn::ExceptionInvalidArgument(viewid + "-links: " + _("incomplete target."));
+			if (textlinks)
 			{
-				auto it = struc.lines.find(txtid);
-				if (it == struc.lines.end())
+				auto it = struc.Find(kind, Id::Find(txtid)); // an unknown id is not interned
+				if (!it)
 				{
 					if (clean)
 						delnode = true;
 					else
-						logmsg += id + "-links: "_s + _("target points to an unknown line: ") + txtid + "\n";
+						log += viewid + "-links: "_s + unknownElementMessage(kind) + txtid + "\n";
 				}
-				else if (zones.find(zoneid) == zones.end())
+				else if (!has_zone(Id{zoneid}))
 				{
 					if (clean)
 						delnode = true;
 					else
-						logmsg += id + "-links: "_s + _("target points to an unknown zone: ") + zoneid + "\n";
+						log += viewid + "-links: "_s + _("target points to an unknown zone: ") + zoneid + "\n";
 				}
 				else
-					it->second.zone = zoneid;
-			}
-			else if (type == WORDLINKS )
-			{
-				auto it = struc.words.find(txtid);
-				if (it == struc.words.end())
-				{
-					if (clean)
-						delnode = true;
-					else
-						logmsg += id + "-links: "_s + _("target points to an unknown word: ") + txtid + "\n";
-				}
-				else if (zones.find(zoneid) == zones.end())
-				{
-					if (clean)
-						delnode = true;
-					else
-						logmsg += id + "-links: "_s + _("target points to an unknown zone: ") + zoneid + "\n";
-				}
-				else
-					it->second.zone = zoneid;
-			}
-			else if (type == CHARLINKS )
-			{
-				auto it = struc.characters.find(txtid);
-				if (it == struc.characters.end())
-				{
-					if (clean)
-						delnode = true;
-					else
-						logmsg += id + "-links: "_s + _("target points to an unknown character: ") + txtid + "\n";
-				}
-				else if (zones.find(zoneid) == zones.end())
-				{
-					if (clean)
-						delnode = true;
-					else
-						logmsg += id + "-links: "_s + _("target points to an unknown zone: ") + zoneid + "\n";
-				}
-				else
-					it->second.zone = zoneid;
+					on_link(kind, it->index, Id{zoneid});
 			}
 
 			auto nel = lel.GetNextSiblingElement("link");
 			if (delnode)
 			{
 				grel.RemoveChild(lel);
+				removed = true;
 			}
 			lel = nel;
 		} // links
 		grel = grel.GetNextSiblingElement("linkGrp");
 	} // link groups
+	return removed;
+}
+
+void View::Impl::readLinkElements(crn::xml::Element &el, bool clean)
+{
+	modified.links = readLinks(el, id, struc,
+			[this](const Id &zid) { return zone_index.find(zid) != zone_index.end(); },
+			[this](const crn::StringUTF8 &type, crn::xml::Element &grel) { link_groups.emplace(type, grel); },
+			[this](ElementKind kind, size_t index, const Id &zid) { setZone(kind, index, zid); },
+			clean, logmsg);
+}
+
+/*! Sets the zone id of an element */
+void View::Impl::setZone(ElementKind kind, size_t index, const Id &zone_id)
+{
+	switch (kind)
+	{
+		case ElementKind::Page:
+			struc.pages[index].zone = zone_id;
+			break;
+		case ElementKind::Column:
+			struc.columns[index].zone = zone_id;
+			break;
+		case ElementKind::Line:
+			struc.lines[index].zone = zone_id;
+			break;
+		case ElementKind::Word:
+			struc.words[index].zone = zone_id;
+			break;
+		case ElementKind::Character:
+			struc.characters[index].zone = zone_id;
+			break;
+	}
+}
+
+/* Binary oridata layout
+ * 	header: magic (8 bytes), number of validation records, columns, median lines, points, signature elements, line links and size of the string pool (uint32),
+ * 		number of the last journal record included (uint32), size and modification time of the XML file the data was imported from (uint64, int64)
+ * 	validation records, column records, median line records, points (2 doubles), signature elements, line link records, string pool
+ * Each section starts on a multiple of 8 bytes. Strings are zero-terminated in the pool and referred to by their offset.
+ */
+static const char DATAMAGIC[8] = {'O', 'R', 'I', 'D', 'A', 'T', '0', '2'};
+
+namespace
+{
+	struct DataHeader
+	{
+		char magic[8];
+		uint32_t nval, ncol, nmed, npts, nsig, nll, poolsize;
+		uint32_t journal; // number of the last journal record included
+		uint64_t xmlsize; // stamp of the XML file the data was imported from
+		int64_t xmlmtime;
+	};
+	struct ValidationRecord
+	{
+		uint32_t id; // word
+		int32_t ok, left, right;
+		uint32_t imgsig;
+	};
+	struct ColumnRecord
+	{
+		uint32_t id;
+		uint32_t first_line, nlines; // median lines
+	};
+	struct MedlineRecord
+	{
+		uint32_t lh;
+		uint32_t first_point, npoints;
+		uint32_t first_sig, nsigs;
+	};
+	struct PointRecord
+	{
+		double x, y;
+	};
+	struct SignatureRecord
+	{
+		int32_t left, top, right, bottom;
+		uint32_t code, cutproba;
+	};
+	struct LineLinkRecord
+	{
+		uint32_t line, column, n;
+	};
+
+	/*! Offsets of the sections of a binary oridata file */
+	struct DataLayout
+	{
+		DataLayout(const DataHeader &h):
+			val(align(sizeof(DataHeader))),
+			col(align(val + h.nval * sizeof(ValidationRecord))),
+			med(align(col + h.ncol * sizeof(ColumnRecord))),
+			pts(align(med + h.nmed * sizeof(MedlineRecord))),
+			sig(align(pts + h.npts * sizeof(PointRecord))),
+			ll(align(sig + h.nsig * sizeof(SignatureRecord))),
+			pool(align(ll + h.nll * sizeof(LineLinkRecord))),
+			end(pool + h.poolsize)
+		{ }
+		static size_t align(size_t s) noexcept { return (s + 7) & ~size_t(7); }
+		size_t val, col, med, pts, sig, ll, pool, end;
+	};
 }
 
+/*! Reads the oridata file, the binary version unless the XML version was replaced since it was imported */
 void View::Impl::load()
 {
-	const auto f = datapath + "-oridata.xml";
+	const auto bin = datapath + "-oridata.bin";
+	const auto xml = GetFileStamp(datapath + "-oridata.xml");
+	if (GetFileStamp(bin).size && loadBinary(bin, xml))
+		return;
+	// imported or former version, will be stored in binary
+	importXml(datapath + "-oridata.xml");
+	xml_stamp = xml;
+	modified.validation = modified.medlines = modified.line_links = true;
+}
+
+/*! Reads a binary oridata file. The file is mapped in memory and the records are read in place.
+ * \throws	crn::ExceptionInvalidArgument	not a binary oridata file and no XML version
+ * \param[in]	f	the binary file
+ * \param[in]	xml	the stamp of the XML version, empty if there is none
+ * \return	false if the XML version must be read instead: the binary file is from another version or the XML file was replaced since it was imported
+ */
+bool View::Impl::loadBinary(const crn::Path &f, const FileStamp &xml)
+{
+	const auto file = MappedFile{f};
+	const auto *data = file.GetData();
+	if ((file.GetSize() < sizeof(DataHeader)) || memcmp(data, DATAMAGIC, sizeof(DATAMAGIC)))
+	{
+		if (xml.size)
+			return false;
+		throw crn::ExceptionInvalidArgument{_("Not an Oriflamms data file: ") + crn::StringUTF8(f)};
+	}
+	const auto &h = *reinterpret_cast<const DataHeader*>(data);
+	auto imported = FileStamp{};
+	imported.size = h.xmlsize;
+	imported.mtime = h.xmlmtime;
+	if (xml.size && (xml != imported))
+		return false;
+	xml_stamp = imported;
+	const auto lay = DataLayout{h};
+	journal_saved = h.journal;
+	const auto *pool = reinterpret_cast<const char*>(data + lay.pool);
+	if ((lay.end > file.GetSize()) || (h.poolsize && pool[h.poolsize - 1]))
+		throw crn::ExceptionInvalidArgument{_("Corrupted Oriflamms data file: ") + crn::StringUTF8(f)};
+	const auto str = [&](uint32_t offset)
+	{
+		if (offset >= h.poolsize)
+			throw crn::ExceptionInvalidArgument{_("Corrupted Oriflamms data file: ") + crn::StringUTF8(f)};
+		return pool + offset;
+	};
+
+	// read validation
+	const auto *vrec = reinterpret_cast<const ValidationRecord*>(data + lay.val);
+	for (auto i = size_t(0); i < h.nval; ++i)
+	{
+		auto it = struc.Find(ElementKind::Word, Id::Find(str(vrec[i].id)));
+		if (!it)
+			continue; // the word was removed from the transcription
+		auto &val = validation[it->index];
+		val.ok = crn::Prop3{vrec[i].ok};
+		val.left_corr = vrec[i].left;
+		val.right_corr = vrec[i].right;
+		val.imgsig = str(vrec[i].imgsig);
+	}
+	// read medlines
+	const auto *crec = reinterpret_cast<const ColumnRecord*>(data + lay.col);
+	const auto *mrec = reinterpret_cast<const MedlineRecord*>(data + lay.med);
+	const auto *prec = reinterpret_cast<const PointRecord*>(data + lay.pts);
+	const auto *srec = reinterpret_cast<const SignatureRecord*>(data + lay.sig);
+	for (auto c = size_t(0); c < h.ncol; ++c)
+	{
+		auto it = struc.Find(ElementKind::Column, Id::Find(str(crec[c].id)));
+		if (!it)
+			continue; // the column was removed from the transcription
+		if (size_t(crec[c].first_line) + crec[c].nlines > h.nmed)
+			throw crn::ExceptionInvalidArgument{_("Corrupted Oriflamms data file: ") + crn::StringUTF8(f)};
+		auto &col = medlines[it->index];
+		for (auto l = crec[c].first_line; l < crec[c].first_line + crec[c].nlines; ++l)
+		{
+			const auto &m = mrec[l];
+			if ((size_t(m.first_point) + m.npoints > h.npts) || (size_t(m.first_sig) + m.nsigs > h.nsig))
+				throw crn::ExceptionInvalidArgument{_("Corrupted Oriflamms data file: ") + crn::StringUTF8(f)};
+			auto pts = std::vector<crn::Point2DDouble>{};
+			pts.reserve(m.npoints);
+			for (auto p = m.first_point; p < m.first_point + m.npoints; ++p)
+				pts.emplace_back(prec[p].x, prec[p].y);
+			col.emplace_back(std::make_shared<crn::LinearInterpolation>(pts.begin(), pts.end()), m.lh); // may throw
+			auto sig = std::vector<ImageSignature>{};
+			sig.reserve(m.nsigs);
+			for (auto s = m.first_sig; s < m.first_sig + m.nsigs; ++s)
+				sig.emplace_back(crn::Rect{srec[s].left, srec[s].top, srec[s].right, srec[s].bottom}, char(srec[s].code), uint8_t(srec[s].cutproba));
+			col.back().SetFeatures(std::move(sig));
+		}
+	}
+	// read line_links
+	const auto *lrec = reinterpret_cast<const LineLinkRecord*>(data + lay.ll);
+	for (auto i = size_t(0); i < h.nll; ++i)
+	{
+		auto lit = struc.Find(ElementKind::Line, Id::Find(str(lrec[i].line)));
+		auto cit = struc.Find(ElementKind::Column, Id::Find(str(lrec[i].column)));
+		if (lit && cit)
+			line_links[lit->index] = std::make_pair(cit->index, size_t(lrec[i].n));
+	}
+	return true;
+}
+
+/*! Serializes the oridata in binary */
+std::vector<uint8_t> View::Impl::binaryData() const
+{
+	auto pool = std::string{};
+	const auto addString = [&pool](const crn::StringUTF8 &s)
+	{
+		const auto offset = uint32_t(pool.size());
+		pool.append(s.CStr(), s.Size() + 1);
+		return offset;
+	};
+
+	auto vrec = std::vector<ValidationRecord>{};
+	vrec.reserve(validation.size());
+	for (auto w = size_t(0); w < validation.size(); ++w)
+	{
+		const auto &val = validation[w];
+		vrec.push_back(ValidationRecord{addString(struc.word_ids[w]), int32_t(val.ok.GetValue()), int32_t(val.left_corr), int32_t(val.right_corr), addString(val.imgsig)});
+	}
+	auto crec = std::vector<ColumnRecord>{};
+	auto mrec = std::vector<MedlineRecord>{};
+	auto prec = std::vector<PointRecord>{};
+	auto srec = std::vector<SignatureRecord>{};
+	for (auto c = size_t(0); c < medlines.size(); ++c)
+	{
+		crec.push_back(ColumnRecord{addString(struc.column_ids[c]), uint32_t(mrec.size()), uint32_t(medlines[c].size())});
+		for (const auto &l : medlines[c])
+		{
+			mrec.push_back(MedlineRecord{uint32_t(l.GetLineHeight()), uint32_t(prec.size()), uint32_t(l.GetMidline().size()), uint32_t(srec.size()), uint32_t(l.GetFeatures().size())});
+			for (const auto &p : l.GetMidline())
+				prec.push_back(PointRecord{p.X, p.Y});
+			for (const auto &s : l.GetFeatures())
+				srec.push_back(SignatureRecord{s.bbox.GetLeft(), s.bbox.GetTop(), s.bbox.GetRight(), s.bbox.GetBottom(), uint32_t(uint8_t(s.code)), s.cutproba});
+		}
+	}
+	auto lrec = std::vector<LineLinkRecord>{};
+	for (auto l = size_t(0); l < line_links.size(); ++l)
+		if (line_links[l].first != NONE)
+			lrec.push_back(LineLinkRecord{addString(struc.line_ids[l]), addString(struc.column_ids[line_links[l].first]), uint32_t(line_links[l].second)});
+
+	auto h = DataHeader{};
+	memcpy(h.magic, DATAMAGIC, sizeof(DATAMAGIC));
+	h.nval = uint32_t(vrec.size());
+	h.ncol = uint32_t(crec.size());
+	h.nmed = uint32_t(mrec.size());
+	h.npts = uint32_t(prec.size());
+	h.nsig = uint32_t(srec.size());
+	h.nll = uint32_t(lrec.size());
+	h.poolsize = uint32_t(pool.size());
+	h.journal = journal_saved;
+	h.xmlsize = xml_stamp.size;
+	h.xmlmtime = xml_stamp.mtime;
+	const auto lay = DataLayout{h};
+	auto buf = std::vector<uint8_t>(lay.end, 0);
+	memcpy(buf.data(), &h, sizeof(h));
+	memcpy(buf.data() + lay.val, vrec.data(), vrec.size() * sizeof(ValidationRecord));
+	memcpy(buf.data() + lay.col, crec.data(), crec.size() * sizeof(ColumnRecord));
+	memcpy(buf.data() + lay.med, mrec.data(), mrec.size() * sizeof(MedlineRecord));
+	memcpy(buf.data() + lay.pts, prec.data(), prec.size() * sizeof(PointRecord));
+	memcpy(buf.data() + lay.sig, srec.data(), srec.size() * sizeof(SignatureRecord));
+	memcpy(buf.data() + lay.ll, lrec.data(), lrec.size() * sizeof(LineLinkRecord));
+	memcpy(buf.data() + lay.pool, pool.data(), pool.size());
+	return buf;
+}
+
+/*! Reads the oridata from an XML file */
+void View::Impl::importXml(const crn::Path &f)
+{
 	// open file
 	auto doc = crn::xml::Document{f};
 	auto root = doc.GetRoot();
@@ -493,10 +790,14 @@ void View::Impl::load()
 		throw crn::ExceptionNotFound{_("No validation element in ") + crn::StringUTF8(f)};
 	for (auto el = var.BeginElement(); el != var.EndElement(); ++el)
 	{
-		auto res = validation.emplace(el.GetAttribute<Id>("id", false), crn::Prop3{el.GetAttribute<int>("ok", false)});
-		res.first->second.left_corr = el.GetAttribute<int>("left", true);
-		res.first->second.right_corr = el.GetAttribute<int>("right", true);
-		res.first->second.imgsig = el.GetAttribute<crn::StringUTF8>("imgsig", true);
+		auto it = struc.Find(ElementKind::Word, Id{el.GetAttribute<crn::StringUTF8>("id", false)});
+		if (!it)
+			continue; // the word was removed from the transcription
+		auto &val = validation[it->index];
+		val.ok = crn::Prop3{el.GetAttribute<int>("ok", false)};
+		val.left_corr = el.GetAttribute<int>("left", true);
+		val.right_corr = el.GetAttribute<int>("right", true);
+		val.imgsig = el.GetAttribute<crn::StringUTF8>("imgsig", true);
 	}
 	// read medlines
 	var = root.GetFirstChildElement("medlines");
@@ -504,11 +805,13 @@ void View::Impl::load()
 		throw crn::ExceptionNotFound{_("No medlines element in ") + crn::StringUTF8(f)};
 	for (auto cel = var.BeginElement(); cel != var.EndElement(); ++cel)
 	{
-		const auto colid = cel.GetAttribute<Id>("id", false);
-		medlines.emplace(colid, std::vector<GraphicalLine>{}); // create empty line
+		auto it = struc.Find(ElementKind::Column, Id{cel.GetAttribute<crn::StringUTF8>("id", false)});
+		if (!it)
+			continue; // the column was removed from the transcription
+		auto &col = medlines[it->index];
 		for (auto el = cel.BeginElement(); el != cel.EndElement(); ++el)
 		{
-			medlines[colid].emplace_back(el);
+			col.emplace_back(el);
 		}
 	}
 	// read line_links
@@ -516,71 +819,374 @@ void View::Impl::load()
 	if (!var)
 		throw crn::ExceptionNotFound{_("No lineLinks element in ") + crn::StringUTF8(f)};
 	for (auto el = var.BeginElement(); el != var.EndElement(); ++el)
-		line_links.emplace(el.GetAttribute<Id>("id", false), std::make_pair(el.GetAttribute<Id>("col", false), el.GetAttribute<int>("n", false)));
+	{
+		auto lit = struc.Find(ElementKind::Line, Id{el.GetAttribute<crn::StringUTF8>("id", false)});
+		auto cit = struc.Find(ElementKind::Column, Id{el.GetAttribute<crn::StringUTF8>("col", false)});
+		if (lit && cit)
+			line_links[lit->index] = std::make_pair(cit->index, size_t(el.GetAttribute<int>("n", false)));
+	}
 }
 
+/*! Writes the modified files. Each file is written to a temporary file that then replaces the former version. */
 void View::Impl::save()
 {
 	std::lock_guard<std::mutex> flock(crn::FileShield::GetMutex("views://" + id));
-	zonesdoc.Save();
-	linksdoc.Save();
+	if (pending_save.valid())
+		pending_save.wait(); // do not let a former background save overwrite the files afterwards
+	auto writes = std::vector<std::function<void()>>{};
+	prepareSave(writes);
+	try
+	{
+		for (auto &w : writes)
+			w();
+	}
+	catch (...)
+	{
+		write_failed = true;
+		throw;
+	}
+}
+
+/*! Copies the content of the modified files so that they can be written later, possibly on another thread. The view must be locked. */
+void View::Impl::prepareSave(std::vector<std::function<void()>> &writes)
+{
+	if (write_failed.exchange(false))
+		modified.zones = modified.links = modified.ontolinks = modified.validation = modified.medlines = modified.line_links = true;
+	if (modified.zones)
+	{
+		writes.push_back(writeLater(zonespath, zonesdoc.AsString()));
+		modified.zones = false;
+	}
+	if (modified.links)
+	{
+		writes.push_back(writeLater(linkspath, linksdoc.AsString()));
+		modified.links = false;
+	}
 
 	//////////////////////////////////////////////
 	// ontology links
 	//////////////////////////////////////////////
-	ontolinkgroup->Clear();
-	for (const auto &l : onto_links)
+	if (modified.ontolinks)
 	{
-		if (l.second.empty())
-			continue;
-		auto val = "txt:" + l.first;
-		for (const auto &gid : l.second)
-			val += " " + gid;
-		auto el = ontolinkgroup->PushBackElement("link");
-		el.SetAttribute("target", val);
+		ontolinkgroup->Clear();
+		for (auto c = size_t(0); c < onto_links.size(); ++c)
+		{
+			const auto &l = onto_links[c];
+			if (l.empty())
+				continue;
+			auto val = "txt:" + struc.character_ids[c];
+			for (const auto &gid : l)
+				val += " " + gid;
+			auto el = ontolinkgroup->PushBackElement("link");
+			el.SetAttribute("target", val);
+		}
+		writes.push_back(writeLater(ontolinkspath, ontolinksdoc.AsString()));
+		modified.ontolinks = false;
 	}
-	ontolinksdoc.Save();
 
 	//////////////////////////////////////////////
 	// custom data
 	//////////////////////////////////////////////
-	const auto f = datapath + "-oridata.xml";
+	const auto jnum = journal ? journal->GetLastNumber() : journal_saved;
+	if (!modified.validation && !modified.medlines && !modified.line_links && (jnum == journal_saved))
+		return;
+	journal_saved = jnum; // the data file is written last, it tells which edits are saved
+	auto data = std::make_shared<std::vector<uint8_t>>(binaryData());
+	const auto fname = datapath + "-oridata.bin";
+	writes.push_back([data, fname]() { WriteFileAtomically(fname, data->data(), data->size()); });
+	modified.validation = modified.medlines = modified.line_links = false;
+	if (journal)
+	{
+		auto j = journal;
+		writes.push_back([j, jnum]() { j->Discard(jnum); });
+	}
+}
+
+/*! Records the state of a word in the journal
+ * \param[in]	w	index of the word
+ * \param[in]	with_zones	shall the zones of the word and of its characters be recorded too?
+ */
+void View::Impl::journalWord(size_t w, bool with_zones)
+{
+	journalWords(w, w + 1, with_zones);
+}
+
+/*! Records the state of a range of words in the journal, with a single write to the disk
+ * \param[in]	first	index of the first word
+ * \param[in]	end	index after the last word
+ * \param[in]	with_zones	shall the zones of the words and of their characters be recorded too?
+ */
+void View::Impl::journalWords(size_t first, size_t end, bool with_zones)
+{
+	if (!journal || (first >= end))
+		return;
+	auto recs = JournalRecords{};
+	for (auto w = first; w < end; ++w)
+		wordRecords(w, with_zones, recs);
+	appendJournal(recs);
+}
+
+/*! Records the geometry of zones in the journal, with a single write to the disk
+ * \param[in]	zs	indices of the zones (NONE is ignored)
+ */
+void View::Impl::journalZones(const std::vector<size_t> &zs)
+{
+	if (!journal)
+		return;
+	auto recs = JournalRecords{};
+	for (const auto z : zs)
+		zoneRecord(z, recs);
+	appendJournal(recs);
+}
+
+/*! Builds the journal records of a word: validation, corrections and image signature, then the zones of the word and of its characters */
+void View::Impl::wordRecords(size_t w, bool with_zones, JournalRecords &recs) const
+{
+	auto rec = Journal::Writer{};
+	const auto &val = validation[w];
+	rec << struc.word_ids[w] << int32_t(val.ok.GetValue()) << int32_t(val.left_corr) << int32_t(val.right_corr) << val.imgsig;
+	recs.emplace_back(Journal::Record::WORD, rec.GetData());
+	if (!with_zones)
+		return;
+	zoneRecord(word_zones[w], recs);
+	const auto &word = struc.words[w];
+	for (auto c = word.first_character; c < word.first_character + word.GetCharacters().size(); ++c)
+		zoneRecord(character_zones[c], recs);
+}
+
+/*! Builds the journal record of a zone: its box, if any, and its contour
+ * \param[in]	z	index of the zone (nothing is recorded if NONE)
+ */
+void View::Impl::zoneRecord(size_t z, JournalRecords &recs) const
+{
+	if (z == NONE)
+		return;
+	const auto &zone = zones[z];
+	auto rec = Journal::Writer{};
+	rec << zone.el.GetAttribute<crn::StringUTF8>("xml:id", true);
+	const auto &r = zone.GetPosition();
+	if (r.IsValid())
+		rec << int32_t(1) << int32_t(r.GetLeft()) << int32_t(r.GetTop()) << int32_t(r.GetRight()) << int32_t(r.GetBottom());
+	else
+		rec << int32_t(0);
+	const auto &contour = zone.GetContour();
+	rec << int32_t(contour.size());
+	for (const auto &pt : contour)
+		rec << int32_t(pt.X) << int32_t(pt.Y);
+	recs.emplace_back(Journal::Record::ZONE, rec.GetData());
+}
+
+/*! Records the glyphs of a character in the journal */
+void View::Impl::journalClusters(size_t c)
+{
+	if (!journal)
+		return;
+	auto rec = Journal::Writer{};
+	rec << struc.character_ids[c] << int32_t(onto_links[c].size());
+	for (const auto &gid : onto_links[c])
+		rec << gid;
+	appendJournal(JournalRecords{std::make_pair(Journal::Record::CLUSTERS, rec.GetData())});
+}
+
+void View::Impl::appendJournal(const JournalRecords &recs)
+{
+	try
+	{
+		journal->Append(recs);
+	}
+	catch (crn::Exception &ex)
+	{ // the edit will be saved with the files
+		CRNWarning(ex.what());
+		journal.reset();
+	}
+}
+
+/*! Applies the journaled edits that are more recent than the data file */
+void View::Impl::replayJournal()
+{
+	journal->Replay(journal_saved, [this](Journal::Record type, const std::string &payload)
+		{
+			auto rec = Journal::Reader{payload};
+			auto eid = crn::StringUTF8{};
+			rec >> eid;
+			if (type == Journal::Record::WORD)
+			{
+				auto it = struc.Find(ElementKind::Word, Id::Find(eid));
+				auto ok = int32_t(0), left = int32_t(0), right = int32_t(0);
+				auto imgsig = crn::StringUTF8{};
+				rec >> ok >> left >> right >> imgsig;
+				if (!it)
+					return; // the word was removed from the transcription
+				auto &val = validation[it->index];
+				val.ok = crn::Prop3{ok};
+				val.left_corr = left;
+				val.right_corr = right;
+				val.imgsig = imgsig;
+				modified.validation = true;
+			}
+			else if (type == Journal::Record::ZONE)
+			{
+				auto hasbox = int32_t(0), l = int32_t(0), t = int32_t(0), r = int32_t(0), b = int32_t(0), n = int32_t(0);
+				rec >> hasbox;
+				if (hasbox)
+					rec >> l >> t >> r >> b;
+				rec >> n;
+				auto contour = std::vector<crn::Point2DInt>{};
+				for (auto i = int32_t(0); i < n; ++i)
+				{
+					auto x = int32_t(0), y = int32_t(0);
+					rec >> x >> y;
+					contour.emplace_back(x, y);
+				}
+				auto zit = zone_index.find(Id::Find(eid));
+				if (zit == zone_index.end())
+					return; // the zone was removed
+				auto &zone = zones[zit->second];
+				zone.Clear();
+				if (hasbox)
+					zone.SetPosition(crn::Rect{l, t, r, b});
+				if (contour.size() >= 3)
+					zone.SetContour(contour);
+			}
+			else if (type == Journal::Record::CLUSTERS)
+			{
+				auto it = struc.Find(ElementKind::Character, Id::Find(eid));
+				auto n = int32_t(0);
+				rec >> n;
+				auto gids = std::vector<Id>{};
+				for (auto i = int32_t(0); i < n; ++i)
+				{
+					auto gid = crn::StringUTF8{};
+					rec >> gid;
+					gids.emplace_back(gid);
+				}
+				if (!it)
+					return;
+				onto_links[it->index] = std::move(gids);
+				modified.ontolinks = true;
+			}
+		});
+}
+
+/*! Writes the oridata to an XML file */
+void View::Impl::exportXml(const crn::Path &f) const
+{
 	auto doc = crn::xml::Document{};
 	doc.PushBackComment("oriflamms data file");
 	auto root = doc.PushBackElement("OriData");
 	// save validation
 	auto var = root.PushBackElement("validation");
-	for (const auto &p : validation)
+	for (auto w = size_t(0); w < validation.size(); ++w)
 	{
+		const auto &val = validation[w];
 		auto el = var.PushBackElement("v");
-		el.SetAttribute("id", p.first);
-		el.SetAttribute("ok", p.second.ok.GetValue());
-		el.SetAttribute("left", p.second.left_corr);
-		el.SetAttribute("right", p.second.right_corr);
-		el.SetAttribute("imgsig", p.second.imgsig);
+		el.SetAttribute("id", struc.word_ids[w].Str());
+		el.SetAttribute("ok", val.ok.GetValue());
+		el.SetAttribute("left", val.left_corr);
+		el.SetAttribute("right", val.right_corr);
+		el.SetAttribute("imgsig", val.imgsig);
 	}
 	// save medlines
 	var = root.PushBackElement("medlines");
-	for (const auto &c : medlines)
+	for (auto c = size_t(0); c < medlines.size(); ++c)
 	{
 		auto col = var.PushBackElement("column");
-		col.SetAttribute("id", c.first);
-		for (const auto &l : c.second)
+		col.SetAttribute("id", struc.column_ids[c].Str());
+		for (const auto &l : medlines[c])
 		{
 			l.Serialize(col);
 		}
 	}
 	// save line_lines
 	var = root.PushBackElement("lineLinks");
-	for (const auto &l : line_links)
+	for (auto l = size_t(0); l < line_links.size(); ++l)
 	{
+		if (line_links[l].first == NONE)
+			continue;
 		auto el = var.PushBackElement("ll");
-		el.SetAttribute("id", l.first);
-		el.SetAttribute("col", l.second.first);
-		el.SetAttribute("n", l.second.second);
+		el.SetAttribute("id", struc.line_ids[l].Str());
+		el.SetAttribute("col", struc.column_ids[line_links[l].first].Str());
+		el.SetAttribute("n", line_links[l].second);
 	}
 	// save file
-	doc.Save(f);
+	saveXml(doc, f);
+}
+
+/*! Resolves the zones of all elements */
+void View::Impl::linkZones()
+{
+	linkZones(page_zones, struc.pages);
+	linkZones(column_zones, struc.columns);
+	linkZones(line_zones, struc.lines);
+	linkZones(word_zones, struc.words);
+	linkZones(character_zones, struc.characters);
+}
+
+template<typename T> void View::Impl::linkZones(std::vector<size_t> &links, const std::vector<T> &elems)
+{
+	links.assign(elems.size(), NONE);
+	for (auto i = size_t(0); i < elems.size(); ++i)
+	{
+		auto it = zone_index.find(elems[i].GetZone());
+		if (it != zone_index.end())
+			links[i] = it->second;
+	}
+}
+
+/*! Gets the zone of an element from its index
+ * \throws	crn::ExceptionNotFound	the element has no zone
+ */
+Zone& View::Impl::getZone(const std::vector<size_t> &links, size_t index, const Id &elem_id)
+{
+	const auto z = links[index];
+	if (z == NONE)
+		throw crn::ExceptionNotFound{"View::GetZone(): "_s + _("Invalid zone id: ") + elem_id};
+	return zones[z];
+}
+
+/*! Gets the zone links of a type of elements */
+std::vector<size_t>& View::Impl::zoneLinks(ElementKind kind) noexcept
+{
+	switch (kind)
+	{
+		case ElementKind::Page:
+			return page_zones;
+		case ElementKind::Column:
+			return column_zones;
+		case ElementKind::Line:
+			return line_zones;
+		case ElementKind::Word:
+			return word_zones;
+		default:
+			return character_zones;
+	}
+}
+
+/*! Estimates the memory used by the image of the view and its derived buffers */
+size_t View::Impl::bufferSize() const
+{
+	static constexpr auto BYTES_PER_PIXEL = size_t(12); // RGB, gray and gradient
+	auto s = weight ? weight->GetMemorySize() : size_t(0);
+	if (img)
+	{
+		const auto &r = img->GetAbsoluteBBox();
+		s += size_t(r.GetWidth()) * size_t(r.GetHeight()) * BYTES_PER_PIXEL;
+	}
+	return s;
+}
+
+/*! Estimates the memory used by the view */
+size_t View::Impl::memorySize() const
+{
+	static constexpr auto BYTES_PER_ZONE = size_t(512); // zone and link XML elements
+	return bufferSize() + zones.size() * BYTES_PER_ZONE;
+}
+
+/*! Frees the image and the weight map, they will be reloaded when needed */
+void View::Impl::releaseBuffers()
+{
+	weight.reset();
+	img = nullptr;
 }
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -598,6 +1204,32 @@ void View::Save()
 	}
 }
 
+/*! Exports the validation, median lines and line links to an XML file, for interchange
+ * \throws	crn::ExceptionIO	cannot write the file
+ * \param[in]	fname	the path of the XML file
+ */
+void View::ExportData(const crn::Path &fname) const
+{
+	std::lock_guard<std::mutex> flock(crn::FileShield::GetMutex("views://" + pimpl->id));
+	pimpl->exportXml(fname);
+}
+
+/*! Replaces the validation, median lines and line links by the content of an XML file
+ * \throws	crn::ExceptionInvalidArgument	not an oridata file
+ * \throws	crn::ExceptionNotFound	missing element in the file
+ * \param[in]	fname	the path of the XML file
+ */
+void View::ImportData(const crn::Path &fname)
+{
+	std::lock_guard<std::mutex> flock(crn::FileShield::GetMutex("views://" + pimpl->id));
+	pimpl->validation.assign(pimpl->struc.words.size(), Impl::WordValidation{crn::Prop3::Unknown()});
+	for (auto &col : pimpl->medlines)
+		col.clear();
+	pimpl->line_links.assign(pimpl->struc.lines.size(), std::make_pair(Impl::NONE, Impl::NONE));
+	pimpl->modified.validation = pimpl->modified.medlines = pimpl->modified.line_links = true;
+	pimpl->importXml(fname);
+}
+
 const crn::Path& View::GetImageName() const noexcept { return pimpl->imagename; }
 
 /*! Gets the image */
@@ -608,17 +1240,17 @@ crn::Block& View::GetBlock() const
 	return *pimpl->img;
 }
 
-const std::vector<Id>& View::GetPages() const noexcept { return pimpl->struc.pageorder; }
+const std::vector<Id>& View::GetPages() const noexcept { return pimpl->struc.page_ids; }
 
 /*!
  * \throws	crn::ExceptionNotFound	invalid id
  */
 const Page& View::GetPage(const Id &page_id) const
 {
-	auto it = pimpl->struc.pages.find(page_id);
-	if (it == pimpl->struc.pages.end())
+	auto it = pimpl->struc.Find(ElementKind::Page, page_id);
+	if (!it)
 		throw crn::ExceptionNotFound{"View::GetPage(): "_s + _("Invalid page id: ") + page_id};
-	return it->second;
+	return pimpl->struc.pages[it->index];
 }
 
 /*!
@@ -626,25 +1258,32 @@ const Page& View::GetPage(const Id &page_id) const
  */
 Page& View::GetPage(const Id &page_id)
 {
-	auto it = pimpl->struc.pages.find(page_id);
-	if (it == pimpl->struc.pages.end())
+	auto it = pimpl->struc.Find(ElementKind::Page, page_id);
+	if (!it)
 		throw crn::ExceptionNotFound{"View::GetPage(): "_s + _("Invalid page id: ") + page_id};
-	return it->second;
+	return pimpl->struc.pages[it->index];
 }
 
-const std::unordered_map<Id, Column>& View::GetColumns() const
+const std::vector<Column>& View::GetColumns() const noexcept
 {
 	return pimpl->struc.columns;
 }
+
+ElementRange<Column> View::GetColumns(const Page &page) const noexcept
+{
+	const auto *first = pimpl->struc.columns.data() + page.first_column;
+	return {first, first + page.GetColumns().size()};
+}
+
 /*!
  * \throws	crn::ExceptionNotFound	invalid id
  */
 const Column& View::GetColumn(const Id &col_id) const
 {
-	auto it = pimpl->struc.columns.find(col_id);
-	if (it == pimpl->struc.columns.end())
+	auto it = pimpl->struc.Find(ElementKind::Column, col_id);
+	if (!it)
 		throw crn::ExceptionNotFound{"View::GetColumn(): "_s + _("Invalid column id: ") + col_id};
-	return it->second;
+	return pimpl->struc.columns[it->index];
 }
 
 /*!
@@ -652,10 +1291,10 @@ const Column& View::GetColumn(const Id &col_id) const
  */
 Column& View::GetColumn(const Id &col_id)
 {
-	auto it = pimpl->struc.columns.find(col_id);
-	if (it == pimpl->struc.columns.end())
+	auto it = pimpl->struc.Find(ElementKind::Column, col_id);
+	if (!it)
 		throw crn::ExceptionNotFound{"View::GetColumn(): "_s + _("Invalid column id: ") + col_id};
-	return it->second;
+	return pimpl->struc.columns[it->index];
 }
 
 /*!
@@ -665,19 +1304,23 @@ Column& View::GetColumn(const Id &col_id)
  */
 const std::vector<GraphicalLine>& View::GetGraphicalLines(const Id &col_id) const
 {
-	auto it = pimpl->medlines.find(col_id);
-	if (it == pimpl->medlines.end())
+	auto it = pimpl->struc.Find(ElementKind::Column, col_id);
+	if (!it)
 		throw crn::ExceptionNotFound{"View::GetGraphicalLines(): "_s + _("Invalid column id: ") + col_id};
-	return it->second;
+	return pimpl->medlines[it->index];
 }
 
 /*! Adds a median line to a column
+ * \throws	crn::ExceptionNotFound	invalid id
  * \param[in]	pts	the median line
  * \param[in]	col_id	the id of a column
  */
 void View::AddGraphicalLine(const std::vector<crn::Point2DInt> &pts, const Id &col_id)
 {
-	auto &col = pimpl->medlines[col_id];
+	auto it = pimpl->struc.Find(ElementKind::Column, col_id);
+	if (!it)
+		throw crn::ExceptionNotFound{"View::AddGraphicalLine(): "_s + _("Invalid column id: ") + col_id};
+	auto &col = pimpl->medlines[it->index];
 	// estimate line height
 	auto lh = std::vector<size_t>{};
 	for (const auto &l : col)
@@ -694,6 +1337,7 @@ void View::AddGraphicalLine(const std::vector<crn::Point2DInt> &pts, const Id &c
 	}
 	// add line
 	col.emplace_back(std::make_shared<crn::LinearInterpolation>(pts.begin(), pts.end()), h);
+	pimpl->modified.medlines = true;
 	std::sort(col.begin(), col.end(),
 			[](const GraphicalLine &l1, const GraphicalLine &l2)
 			{
@@ -702,62 +1346,90 @@ void View::AddGraphicalLine(const std::vector<crn::Point2DInt> &pts, const Id &c
 }
 
 /*! Removes a median line from a column
+ * \throws	crn::ExceptionNotFound	invalid id
  * \throws	crn::ExceptionDomain	index > number of lines
  * \param[in]	col_id	the id of a column
  * \param[in]	index	the number of the line
  */
 void View::RemoveGraphicalLine(const Id &col_id, size_t index)
 {
-	auto &col = pimpl->medlines[col_id];
+	auto it = pimpl->struc.Find(ElementKind::Column, col_id);
+	if (!it)
+		throw crn::ExceptionNotFound{"View::RemoveGraphicalLine(): "_s + _("Invalid column id: ") + col_id};
+	auto &col = pimpl->medlines[it->index];
 	if (index >= col.size())
 		throw crn::ExceptionDomain("View::RemoveGraphicalLine(): "_s + _("index is greater than the number of lines."));
 	col.erase(col.begin() + index);
+	pimpl->modified.medlines = true;
 }
 
 /*! Removes median lines from a column
- * \throws	crn::ExceptionDomain	index > number of lines
+ * \throws	crn::ExceptionNotFound	invalid id
  * \param[in]	col_id	the id of a column
  */
 void View::RemoveGraphicalLines(const Id &col_id)
 {
-	auto &col = pimpl->medlines[col_id];
-	col.clear();
+	auto it = pimpl->struc.Find(ElementKind::Column, col_id);
+	if (!it)
+		throw crn::ExceptionNotFound{"View::RemoveGraphicalLines(): "_s + _("Invalid column id: ") + col_id};
+	pimpl->medlines[it->index].clear();
+	pimpl->modified.medlines = true;
 }
 
 /*! Removes all aligned coordinates in a column
+ * \throws	crn::ExceptionNotFound	invalid id
  * \param[in]	col_id	the id of the column
  */
 void View::ClearAlignment(const Id &col_id)
 {
-	auto &col = GetColumn(col_id);
-	GetZone(col.GetZone()).Clear();
-	for (const auto &lid : col.GetLines())
+	auto it = pimpl->struc.Find(ElementKind::Column, col_id);
+	if (!it)
+		throw crn::ExceptionNotFound{"View::ClearAlignment(): "_s + _("Invalid column id: ") + col_id};
+	auto &s = pimpl->struc;
+	const auto &col = s.columns[it->index];
+	auto cleared = std::vector<size_t>{}; // zones to journal
+	pimpl->getZone(pimpl->column_zones, it->index, col_id).Clear();
+	cleared.push_back(pimpl->column_zones[it->index]);
+	for (auto l = col.first_line; l < col.first_line + col.GetLines().size(); ++l)
 	{
-		auto &line = GetLine(lid);
-		GetZone(line.GetZone()).Clear();
-		for (const auto &wid : line.GetWords())
+		const auto &line = s.lines[l];
+		pimpl->getZone(pimpl->line_zones, l, line.GetId()).Clear();
+		cleared.push_back(pimpl->line_zones[l]);
+		for (auto w = line.first_word; w < line.first_word + line.GetWords().size(); ++w)
 		{
-			auto &word = GetWord(wid);
-			GetZone(word.GetZone()).Clear();
-			for (const auto &cid : word.GetCharacters())
-				GetZone(GetCharacter(cid).GetZone()).Clear();
+			const auto &word = s.words[w];
+			pimpl->getZone(pimpl->word_zones, w, word.GetId()).Clear();
+			cleared.push_back(pimpl->word_zones[w]);
+			for (auto c = word.first_character; c < word.first_character + word.GetCharacters().size(); ++c)
+			{
+				pimpl->getZone(pimpl->character_zones, c, s.character_ids[c]).Clear();
+				cleared.push_back(pimpl->character_zones[c]);
+			}
 		}
 	}
+	pimpl->journalZones(cleared);
 }
 
-const std::unordered_map<Id, Line>& View::GetLines() const
+const std::vector<Line>& View::GetLines() const noexcept
 {
 	return pimpl->struc.lines;
 }
+
+ElementRange<Line> View::GetLines(const Column &col) const noexcept
+{
+	const auto *first = pimpl->struc.lines.data() + col.first_line;
+	return {first, first + col.GetLines().size()};
+}
+
 /*!
  * \throws	crn::ExceptionNotFound	invalid id
  */
 const Line& View::GetLine(const Id &line_id) const
 {
-	auto it = pimpl->struc.lines.find(line_id);
-	if (it == pimpl->struc.lines.end())
+	auto it = pimpl->struc.Find(ElementKind::Line, line_id);
+	if (!it)
 		throw crn::ExceptionNotFound{"View::GetLine(): "_s + _("Invalid line id: ") + line_id};
-	return it->second;
+	return pimpl->struc.lines[it->index];
 }
 
 /*!
@@ -765,10 +1437,10 @@ const Line& View::GetLine(const Id &line_id) const
  */
 Line& View::GetLine(const Id &line_id)
 {
-	auto it = pimpl->struc.lines.find(line_id);
-	if (it == pimpl->struc.lines.end())
+	auto it = pimpl->struc.Find(ElementKind::Line, line_id);
+	if (!it)
 		throw crn::ExceptionNotFound{"View::GetLine(): "_s + _("Invalid line id: ") + line_id};
-	return it->second;
+	return pimpl->struc.lines[it->index];
 }
 
 /*!
@@ -779,14 +1451,15 @@ Line& View::GetLine(const Id &line_id)
  */
 const GraphicalLine& View::GetGraphicalLine(const Id &line_id) const
 {
-	auto it = pimpl->line_links.find(line_id);
-	if (it == pimpl->line_links.end())
+	auto it = pimpl->struc.Find(ElementKind::Line, line_id);
+	if (!it)
 		throw crn::ExceptionNotFound{"View::GetGraphicalLine(): "_s + _("Invalid line id: ") + line_id};
 
-	if (it->second.second >= pimpl->medlines[it->second.first].size())
+	const auto &link = pimpl->line_links[it->index];
+	if ((link.first == Impl::NONE) || (link.second >= pimpl->medlines[link.first].size()))
 		throw crn::ExceptionDomain{"View::GetGraphicalLine(): "_s + _("No graphical line associated to text line: ") + line_id};
 
-	return pimpl->medlines[it->second.first][it->second.second];
+	return pimpl->medlines[link.first][link.second];
 }
 
 /*!
@@ -797,42 +1470,51 @@ const GraphicalLine& View::GetGraphicalLine(const Id &line_id) const
  */
 GraphicalLine& View::GetGraphicalLine(const Id &line_id)
 {
-	auto it = pimpl->line_links.find(line_id);
-	if (it == pimpl->line_links.end())
+	auto it = pimpl->struc.Find(ElementKind::Line, line_id);
+	if (!it)
 		throw crn::ExceptionNotFound{"View::GetGraphicalLine(): "_s + _("Invalid line id: ") + line_id};
 
-	if (it->second.second >= pimpl->medlines[it->second.first].size())
+	const auto &link = pimpl->line_links[it->index];
+	if ((link.first == Impl::NONE) || (link.second >= pimpl->medlines[link.first].size()))
 		throw crn::ExceptionDomain{"View::GetGraphicalLine(): "_s + _("No graphical line associated to text line: ") + line_id};
 
-	return pimpl->medlines[it->second.first][it->second.second];
+	pimpl->modified.medlines = true; // the line may be modified by the caller
+	return pimpl->medlines[link.first][link.second];
 }
 
 /*!
- * \throws	crn::ExceptionNotFound	invalid id
+ * \throws	crn::ExceptionNotFound	invalid id or the line has no median line
  * \param[in]	line_id	the id of a line
  * \return	the median line's index
  */
 size_t View::GetGraphicalLineIndex(const Id &line_id) const
 {
-	auto it = pimpl->line_links.find(line_id);
-	if (it == pimpl->line_links.end())
+	auto it = pimpl->struc.Find(ElementKind::Line, line_id);
+	if (!it || (pimpl->line_links[it->index].first == Impl::NONE))
 		throw crn::ExceptionNotFound{"View::GetGraphicalLineIndex(): "_s + _("Invalid line id: ") + line_id};
-	return it->second.second;
+	return pimpl->line_links[it->index].second;
 }
 
-const std::unordered_map<Id, Word>& View::GetWords() const
+const std::vector<Word>& View::GetWords() const noexcept
 {
 	return pimpl->struc.words;
 }
+
+ElementRange<Word> View::GetWords(const Line &line) const noexcept
+{
+	const auto *first = pimpl->struc.words.data() + line.first_word;
+	return {first, first + line.GetWords().size()};
+}
+
 /*!
  * \throws	crn::ExceptionNotFound	invalid id
  */
 const Word& View::GetWord(const Id &word_id) const
 {
-	auto it = pimpl->struc.words.find(word_id);
-	if (it == pimpl->struc.words.end())
+	auto it = pimpl->struc.Find(ElementKind::Word, word_id);
+	if (!it)
 		throw crn::ExceptionNotFound{"View::GetWord(): "_s + _("Invalid word id: ") + word_id};
-	return it->second;
+	return pimpl->struc.words[it->index];
 }
 
 /*!
@@ -840,10 +1522,10 @@ const Word& View::GetWord(const Id &word_id) const
  */
 Word& View::GetWord(const Id &word_id)
 {
-	auto it = pimpl->struc.words.find(word_id);
-	if (it == pimpl->struc.words.end())
+	auto it = pimpl->struc.Find(ElementKind::Word, word_id);
+	if (!it)
 		throw crn::ExceptionNotFound{"View::GetWord(): "_s + _("Invalid word id: ") + word_id};
-	return it->second;
+	return pimpl->struc.words[it->index];
 }
 
 /*!
@@ -853,10 +1535,10 @@ Word& View::GetWord(const Id &word_id)
  */
 const crn::Prop3& View::IsValid(const Id &word_id) const
 {
-	const auto it = pimpl->validation.find(word_id);
-	if (it == pimpl->validation.end())
+	auto it = pimpl->struc.Find(ElementKind::Word, word_id);
+	if (!it)
 		throw crn::ExceptionNotFound{"View::IsValid(): "_s + _("Invalid word id: ") + word_id};
-	return it->second.ok;
+	return pimpl->validation[it->index].ok;
 }
 
 /*!
@@ -866,10 +1548,12 @@ const crn::Prop3& View::IsValid(const Id &word_id) const
  */
 void View::SetValid(const Id &word_id, const crn::Prop3 &val)
 {
-	auto it = pimpl->validation.find(word_id);
-	if (it == pimpl->validation.end())
+	auto it = pimpl->struc.Find(ElementKind::Word, word_id);
+	if (!it)
 		throw crn::ExceptionNotFound{"View::SetValid(): "_s + _("Invalid word id: ") + word_id};
-	it->second.ok = val;
+	pimpl->validation[it->index].ok = val;
+	pimpl->modified.validation = true;
+	pimpl->journalWord(it->index, false);
 }
 
 /*!
@@ -877,15 +1561,9 @@ void View::SetValid(const Id &word_id, const crn::Prop3 &val)
  * \param[in]	word_id	the id of the word
  * \return the alignable characters in word
  */
-crn::String View::GetAlignableText(const Id &word_id) const
+const crn::String& View::GetAlignableText(const Id &word_id) const
 {
-	const auto &word = GetWord(word_id);
-	auto str = crn::String{};
-	for (const auto &cid : word.GetCharacters())
-	{
-		str += GetCharacter(cid).GetText();
-	}
-	return str;
+	return GetWord(word_id).GetText(); // computed when the document is opened
 }
 
 /*! Sets a word's image signature after alignment
@@ -893,10 +1571,12 @@ crn::String View::GetAlignableText(const Id &word_id) const
  */
 void View::SetWordImageSignature(const Id &word_id, const crn::StringUTF8 &s)
 {
-	const auto it = pimpl->validation.find(word_id);
-	if (it == pimpl->validation.end())
+	auto it = pimpl->struc.Find(ElementKind::Word, word_id);
+	if (!it)
 		throw crn::ExceptionNotFound{"View::SetWordImageSignature(): "_s + _("Invalid word id: ") + word_id};
-	it->second.imgsig = s;
+	pimpl->validation[it->index].imgsig = s;
+	pimpl->modified.validation = true;
+	pimpl->journalWord(it->index, false);
 }
 
 /*! Gets a word's image signature after alignment
@@ -904,10 +1584,10 @@ void View::SetWordImageSignature(const Id &word_id, const crn::StringUTF8 &s)
  */
 const crn::StringUTF8& View::GetWordImageSignature(const Id &word_id) const
 {
-	const auto it = pimpl->validation.find(word_id);
-	if (it == pimpl->validation.end())
+	auto it = pimpl->struc.Find(ElementKind::Word, word_id);
+	if (!it)
 		throw crn::ExceptionNotFound{"View::GetWordImageSignature(): "_s + _("Invalid word id: ") + word_id};
-	return it->second.imgsig;
+	return pimpl->validation[it->index].imgsig;
 }
 
 /*! Clears alignment for characters in a word
@@ -916,8 +1596,11 @@ const crn::StringUTF8& View::GetWordImageSignature(const Id &word_id) const
 void View::ClearCharactersAlignment(const Id &word_id)
 {
 	const auto &word = GetWord(word_id);
-	for (const auto &cid : word.GetCharacters())
-		GetZone(GetCharacter(cid).GetZone()).Clear();
+	const auto fc = word.first_character;
+	const auto nc = word.GetCharacters().size();
+	for (auto c = fc; c < fc + nc; ++c)
+		pimpl->getZone(pimpl->character_zones, c, pimpl->struc.character_ids[c]).Clear();
+	pimpl->journalZones(std::vector<size_t>(pimpl->character_zones.begin() + fc, pimpl->character_zones.begin() + fc + nc));
 }
 
 /*!
@@ -928,24 +1611,55 @@ const std::vector<Id>& View::GetClusters(const Id &char_id) const
 {
 	static const auto nullvector = std::vector<Id>{};
 
-	auto it = pimpl->onto_links.find(char_id);
-	if (it == pimpl->onto_links.end())
+	auto it = pimpl->struc.Find(ElementKind::Character, char_id);
+	if (!it)
 		return nullvector;
-	return it->second;
+	return pimpl->onto_links[it->index];
 }
 
-/*!
- * \param[in]	word_id	the id of the character
- * \return	the list of glyph Ids associated to a character
+/*! Adds a glyph to a character
+ * \throws	crn::ExceptionNotFound	invalid id
+ * \param[in]	char_id	the id of the character
+ * \param[in]	glyph_id	the id of the glyph
  */
-std::vector<Id>& View::GetClusters(const Id &char_id)
+void View::AddCluster(const Id &char_id, const Id &glyph_id)
 {
-	return pimpl->onto_links[char_id];
+	auto it = pimpl->struc.Find(ElementKind::Character, char_id);
+	if (!it)
+		throw crn::ExceptionNotFound{"View::AddCluster(): "_s + _("Invalid character id: ") + char_id};
+	pimpl->onto_links[it->index].push_back(glyph_id);
+	pimpl->modified.ontolinks = true;
+	pimpl->journalClusters(it->index);
 }
 
-const std::unordered_map<Id, Character>& View::GetCharacters() const
+/*! Removes a glyph from a character
+ * \throws	crn::ExceptionNotFound	invalid id
+ * \param[in]	char_id	the id of the character
+ * \param[in]	glyph_id	the id of the glyph
+ */
+void View::RemoveCluster(const Id &char_id, const Id &glyph_id)
+{
+	auto it = pimpl->struc.Find(ElementKind::Character, char_id);
+	if (!it)
+		throw crn::ExceptionNotFound{"View::RemoveCluster(): "_s + _("Invalid character id: ") + char_id};
+	auto &glyphs = pimpl->onto_links[it->index];
+	const auto nend = std::remove(glyphs.begin(), glyphs.end(), glyph_id);
+	if (nend == glyphs.end())
+		return;
+	glyphs.erase(nend, glyphs.end());
+	pimpl->modified.ontolinks = true;
+	pimpl->journalClusters(it->index);
+}
+
+const std::vector<Character>& View::GetCharacters() const noexcept
+{
+	return pimpl->struc.characters;
+}
+
+ElementRange<Character> View::GetCharacters(const Word &word) const noexcept
 {
-return pimpl->struc.characters;
+	const auto *first = pimpl->struc.characters.data() + word.first_character;
+	return {first, first + word.GetCharacters().size()};
 }
 
 /*!
@@ -953,10 +1667,10 @@ return pimpl->struc.characters;
 */
 const Character& View::GetCharacter(const Id &char_id) const
 {
-auto it = pimpl->struc.characters.find(char_id);
-if (it == pimpl->struc.characters.end())
+auto it = pimpl->struc.Find(ElementKind::Character, char_id);
+if (!it)
 	throw crn::ExceptionNotFound{"View::GetCharacter(): "_s + _("Invalid character id: ") + char_id};
-return it->second;
+return pimpl->struc.characters[it->index];
 }
 
 /*!
@@ -964,10 +1678,10 @@ return it->second;
 */
 Character& View::GetCharacter(const Id &char_id)
 {
-auto it = pimpl->struc.characters.find(char_id);
-if (it == pimpl->struc.characters.end())
+auto it = pimpl->struc.Find(ElementKind::Character, char_id);
+if (!it)
 	throw crn::ExceptionNotFound{"View::GetCharacter(): "_s + _("Invalid character id: ") + char_id};
-return it->second;
+return pimpl->struc.characters[it->index];
 }
 
 /*!
@@ -975,10 +1689,10 @@ return it->second;
 */
 const Zone& View::GetZone(const Id &zone_id) const
 {
-auto it = pimpl->zones.find(zone_id);
-if (it == pimpl->zones.end())
+auto it = pimpl->zone_index.find(zone_id);
+if (it == pimpl->zone_index.end())
 	throw crn::ExceptionNotFound{"View::GetZone(): "_s + _("Invalid zone id: ") + zone_id};
-return it->second;
+return pimpl->zones[it->second];
 }
 
 /*!
@@ -986,10 +1700,10 @@ return it->second;
 */
 Zone& View::GetZone(const Id &zone_id)
 {
-auto it = pimpl->zones.find(zone_id);
-if (it == pimpl->zones.end())
+auto it = pimpl->zone_index.find(zone_id);
+if (it == pimpl->zone_index.end())
 	throw crn::ExceptionNotFound{"View::GetZone(): "_s + _("Invalid zone id: ") + zone_id};
-return it->second;
+return pimpl->zones[it->second];
 }
 
 /*! Sets the bounding box of an element
@@ -1001,25 +1715,27 @@ return it->second;
 void View::SetPosition(const Id &id, const crn::Rect &r, bool compute_contour)
 {
 	auto zid = id;
-	auto wit = pimpl->struc.words.find(id);
-	if (wit != pimpl->struc.words.end())
+	auto wit = pimpl->struc.Find(ElementKind::Word, id);
+	if (wit)
 	{
-		zid = wit->second.GetZone();
+		zid = pimpl->struc.words[wit->index].GetZone();
 	}
 	else
 	{
-		auto cit = pimpl->struc.characters.find(id);
-		if (cit != pimpl->struc.characters.end())
+		auto cit = pimpl->struc.Find(ElementKind::Character, id);
+		if (cit)
 		{
-			zid = cit->second.GetZone();
+			zid = pimpl->struc.characters[cit->index].GetZone();
 		}
 	}
-	auto zit = pimpl->zones.find(zid);
-	if (zit != pimpl->zones.end())
+	auto zit = pimpl->zone_index.find(zid);
+	if (zit != pimpl->zone_index.end())
 	{
-		zit->second.SetPosition(r);
+		auto &zone = pimpl->zones[zit->second];
+		zone.SetPosition(r);
 		if (compute_contour)
-			ComputeContour(zid);
+			computeContour(zone);
+		pimpl->journalZones({zit->second});
 	}
 	else
 		throw crn::ExceptionNotFound("View::SetPosition(): "_s + _("Invalid zone id: ") + id);
@@ -1034,30 +1750,32 @@ void View::SetPosition(const Id &id, const crn::Rect &r, bool compute_contour)
 void View::SetContour(const Id &id, const std::vector<crn::Point2DInt> &c, bool set_position)
 {
 	auto zid = id;
-	auto wit = pimpl->struc.words.find(id);
-	if (wit != pimpl->struc.words.end())
+	auto wit = pimpl->struc.Find(ElementKind::Word, id);
+	if (wit)
 	{
-		zid = wit->second.GetZone();
+		zid = pimpl->struc.words[wit->index].GetZone();
 	}
 	else
 	{
-		auto cit = pimpl->struc.characters.find(id);
-		if (cit != pimpl->struc.characters.end())
+		auto cit = pimpl->struc.Find(ElementKind::Character, id);
+		if (cit)
 		{
-			zid = cit->second.GetZone();
+			zid = pimpl->struc.characters[cit->index].GetZone();
 		}
 	}
-	auto zit = pimpl->zones.find(zid);
-	if (zit != pimpl->zones.end())
+	auto zit = pimpl->zone_index.find(zid);
+	if (zit != pimpl->zone_index.end())
 	{
-		zit->second.SetContour(c);
+		auto &zone = pimpl->zones[zit->second];
+		zone.SetContour(c);
 		if (set_position)
 		{
 			auto r = crn::Rect{c.front()};
 			for (const auto p : c)
 				r |= p;
-			zit->second.SetPosition(r);
+			zone.SetPosition(r);
 		}
+		pimpl->journalZones({zit->second});
 	}
 	else
 		throw crn::ExceptionNotFound("View::SetContour(): "_s + _("Invalid zone id: ") + id);
@@ -1065,8 +1783,8 @@ void View::SetContour(const Id &id, const std::vector<crn::Point2DInt> &c, bool
 
 struct stepcost
 {
-	stepcost(const crn::ImageGray &ig, int x):img(ig),ref(x) { }
-	const crn::ImageGray &img;
+	stepcost(const WeightMap &wm, int x):img(wm),ref(x) { }
+	const WeightMap &img;
 	const int ref;
 	inline double operator()(const crn::Point2DInt &p1, const crn::Point2DInt &p2) const
 	{
@@ -1136,14 +1854,21 @@ std::vector<crn::Point2DInt> View::ComputeFrontier(size_t x, size_t y1, size_t y
  */
 void View::ComputeContour(const Id &zone_id)
 {
-	auto zit = pimpl->zones.find(zone_id);
-	if (zit == pimpl->zones.end())
+	auto zit = pimpl->zone_index.find(zone_id);
+	if (zit == pimpl->zone_index.end())
 		throw crn::ExceptionNotFound("View::CumputeContour(): "_s + _("Invalid zone id: ") + zone_id);
-	const auto &r = zit->second.GetPosition();
+	computeContour(pimpl->zones[zit->second]);
+	pimpl->journalZones({zit->second});
+}
+
+/*! Computes the contour of a zone from its bounding box */
+void View::computeContour(Zone &zone)
+{
+	const auto &r = zone.GetPosition();
 	auto contour = ComputeFrontier(r.GetLeft(), r.GetTop(), r.GetBottom());
 	auto contour2 = ComputeFrontier(r.GetRight(), r.GetTop(), r.GetBottom());
 	std::move(contour2.rbegin(), contour2.rend(), std::back_inserter(contour));
-	zit->second.SetContour(contour);
+	zone.SetContour(contour);
 }
 
 /*! Gets the image of a zone. If the zone has a contour, the exterior will be filled with white pixels or null gradients.
@@ -1154,10 +1879,11 @@ void View::ComputeContour(const Id &zone_id)
  */
 crn::SBlock View::GetZoneImage(const Id &zone_id) const
 {
-	auto zit = pimpl->zones.find(zone_id);
-	if (zit == pimpl->zones.end())
+	auto zit = pimpl->zone_index.find(zone_id);
+	if (zit == pimpl->zone_index.end())
 		throw crn::ExceptionNotFound("View::GetZoneImage(): "_s + _("Invalid zone id: ") + zone_id);
-	const auto &pos = zit->second.GetPosition();
+	const auto &zone = pimpl->zones[zit->second];
+	const auto &pos = zone.GetPosition();
 	if (!pos.IsValid())
 		throw crn::ExceptionUninitialized("View::GetZoneImage(): "_s + _("Uninitialized zone id: ") + zone_id);
 	auto &b = GetBlock();
@@ -1168,7 +1894,7 @@ crn::SBlock View::GetZoneImage(const Id &zone_id) const
 	}
 	catch (crn::ExceptionNotFound&)
 	{
-		auto contour = zit->second.GetContour();
+		auto contour = zone.GetContour();
 		auto frontier = size_t(0);
 		if (contour.empty())
 		{
@@ -1262,22 +1988,24 @@ crn::SBlock View::GetZoneImage(const Id &zone_id) const
  */
 void View::UpdateLeftFrontier(const Id &id, int x)
 {
-	auto wit = pimpl->struc.words.find(id);
-	if (wit == pimpl->struc.words.end())
+	auto wit = pimpl->struc.Find(ElementKind::Word, id);
+	if (!wit)
 		throw crn::ExceptionNotFound("View::UpdateLeftFrontier(): "_s + _("Invalid word id: ") + id);
-	const auto zid = wit->second.GetZone();
-	auto &zone = pimpl->zones.find(zid)->second;
+	const auto zid = pimpl->struc.words[wit->index].GetZone();
+	auto &zone = pimpl->getZone(pimpl->word_zones, wit->index, id);
 	auto r = zone.GetPosition();
 	if (r.IsValid())
 	{
 		if (r.GetLeft() == x)
 			return;
-		auto &val = pimpl->validation.find(id)->second;
+		auto &val = pimpl->validation[wit->index];
+		pimpl->modified.validation = true;
 		val.left_corr += r.GetLeft() - x;
 		r.SetLeft(x);
 		zone.SetPosition(r);
 		if (val.right_corr)
 			val.ok = true;
+		pimpl->journalWord(wit->index);
 	}
 	else
 		throw crn::ExceptionUninitialized("View::UpdateLeftFrontier(): "_s + _("uninitialized zone: ") + zid);
@@ -1291,22 +2019,24 @@ void View::UpdateLeftFrontier(const Id &id, int x)
  */
 void View::UpdateRightFrontier(const Id &id, int x)
 {
-	auto wit = pimpl->struc.words.find(id);
-	if (wit == pimpl->struc.words.end())
+	auto wit = pimpl->struc.Find(ElementKind::Word, id);
+	if (!wit)
 		throw crn::ExceptionNotFound("View::UpdateRightFrontier(): "_s + _("Invalid word id: ") + id);
-	const auto zid = wit->second.GetZone();
-	auto &zone = pimpl->zones.find(zid)->second;
+	const auto zid = pimpl->struc.words[wit->index].GetZone();
+	auto &zone = pimpl->getZone(pimpl->word_zones, wit->index, id);
 	auto r = zone.GetPosition();
 	if (r.IsValid())
 	{
 		if (r.GetRight() == x)
 			return;
-		auto &val = pimpl->validation.find(id)->second;
+		auto &val = pimpl->validation[wit->index];
+		pimpl->modified.validation = true;
 		val.right_corr += r.GetRight() - x;
 		r.SetRight(x);
 		zone.SetPosition(r);
 		if (val.left_corr)
 			val.ok = true;
+		pimpl->journalWord(wit->index);
 	}
 	else
 		throw crn::ExceptionUninitialized("View::UpdateRightFrontier(): "_s + _("uninitialized zone: ") + zid);
@@ -1319,10 +2049,10 @@ void View::UpdateRightFrontier(const Id &id, int x)
  */
 int View::GetLeftCorrection(const Id &id) const
 {
-	auto wit = pimpl->struc.words.find(id);
-	if (wit == pimpl->struc.words.end())
+	auto wit = pimpl->struc.Find(ElementKind::Word, id);
+	if (!wit)
 		throw crn::ExceptionNotFound("View::GetLeftCorrection(): "_s + _("Invalid word id: ") + id);
-	return pimpl->validation.find(id)->second.left_corr;
+	return pimpl->validation[wit->index].left_corr;
 }
 
 /*!
@@ -1332,10 +2062,10 @@ int View::GetLeftCorrection(const Id &id) const
  */
 int View::GetRightCorrection(const Id &id) const
 {
-	auto wit = pimpl->struc.words.find(id);
-	if (wit == pimpl->struc.words.end())
+	auto wit = pimpl->struc.Find(ElementKind::Word, id);
+	if (!wit)
 		throw crn::ExceptionNotFound("View::GetRightCorrection(): "_s + _("Invalid word id: ") + id);
-	return pimpl->validation.find(id)->second.right_corr;
+	return pimpl->validation[wit->index].right_corr;
 }
 
 /*! Resets the left and right corrections of a word
@@ -1344,11 +2074,14 @@ int View::GetRightCorrection(const Id &id) const
  */
 void View::ResetCorrections(const Id &id)
 {
-	if (pimpl->struc.words.find(id) == pimpl->struc.words.end())
+	auto wit = pimpl->struc.Find(ElementKind::Word, id);
+	if (!wit)
 		throw crn::ExceptionNotFound("View::ResetCorrections(): "_s + _("Invalid word id: ") + id);
 
-	auto &val = pimpl->validation.find(id)->second;
+	auto &val = pimpl->validation[wit->index];
 	val.left_corr = val.right_corr = 0;
+	pimpl->modified.validation = true;
+	pimpl->journalWord(wit->index, false);
 }
 
 /*! Computes alignment on the view
@@ -1410,30 +2143,37 @@ void View::AlignColumn(AlignConfig conf, const Id &col_id, crn::Progress *colpro
 }
 
 /*! Computes alignment on a line
+ * \throws	crn::ExceptionNotFound	invalid id
  * \param[in]	conf	alignment options
  * \param[in]	line_id	the id of the line
  * \param[in]	prog	progress bar on words
  */
 void View::AlignLine(AlignConfig conf, const Id &line_id, crn::Progress *prog)
 {
-	auto &line = GetLine(line_id);
-	if (line.GetWords().empty()) // Is it even possible?
+	auto lit = pimpl->struc.Find(ElementKind::Line, line_id);
+	if (!lit)
+		throw crn::ExceptionNotFound{"View::AlignLine(): "_s + _("Invalid line id: ") + line_id};
+	const auto l = lit->index;
+	const auto &line = pimpl->struc.lines[l];
+	const auto fw = line.first_word;
+	const auto nw = line.GetWords().size();
+	if (!nw) // Is it even possible?
 		return;
+	auto wzone = [this, fw](size_t w) -> Zone& { return pimpl->getZone(pimpl->word_zones, fw + w, pimpl->struc.word_ids[fw + w]); };
 
 	// Align words
 	if (!!(conf & AlignConfig::AllWords))
 	{
-		AlignRange(conf, line_id, 0, line.GetWords().size() - 1);
+		alignRange(conf, l, 0, nw - 1);
 	}
 	else if (!!(conf & AlignConfig::NOKWords))
 	{
 		// gather ranges of words to align
 		auto wranges = std::vector<std::vector<size_t>>{};
 		auto in = false;
-		for (auto w : crn::Range(line.GetWords()))
+		for (auto w = size_t(0); w < nw; ++w)
 		{
-			if (!GetZone(GetWord(line.GetWords()[w]).GetZone()).GetPosition().IsValid() ||
-					!IsValid(line.GetWords()[w]).IsTrue())
+			if (!wzone(w).GetPosition().IsValid() || !pimpl->validation[fw + w].ok.IsTrue())
 			{
 				if (!in)
 				{
@@ -1452,14 +2192,15 @@ void View::AlignLine(AlignConfig conf, const Id &line_id, crn::Progress *prog)
 			prog->SetMaxCount(int(wranges.size()));
 		for (const auto &r : wranges)
 		{
-			const auto &firstwid = line.GetWords()[r.front()];
-			if ((r.size() == 1) && GetZone(GetWord(firstwid).GetZone()).GetPosition().IsValid())
+			if ((r.size() == 1) && wzone(r.front()).GetPosition().IsValid())
 			{ // a single word between validated words
-				SetValid(firstwid, crn::Prop3::True());
+				pimpl->validation[fw + r.front()].ok = crn::Prop3::True();
+				pimpl->modified.validation = true;
+				pimpl->journalWord(fw + r.front(), false);
 			}
 			else
 			{
-				AlignRange(conf, line_id, r.front(), r.back());
+				alignRange(conf, l, r.front(), r.back());
 			}
 			if (prog)
 				prog->Advance();
@@ -1470,9 +2211,9 @@ void View::AlignLine(AlignConfig conf, const Id &line_id, crn::Progress *prog)
 		// gather ranges of words to align
 		auto wranges = std::vector<std::vector<size_t>>{};
 		auto in = false;
-		for (auto w : crn::Range(line.GetWords()))
+		for (auto w = size_t(0); w < nw; ++w)
 		{
-			if (!GetZone(GetWord(line.GetWords()[w]).GetZone()).GetPosition().IsValid())
+			if (!wzone(w).GetPosition().IsValid())
 			{
 				if (!in)
 				{
@@ -1491,7 +2232,7 @@ void View::AlignLine(AlignConfig conf, const Id &line_id, crn::Progress *prog)
 			prog->SetMaxCount(int(wranges.size()));
 		for (const auto &r : wranges)
 		{
-			AlignRange(conf, line_id, r.front(), r.back());
+			alignRange(conf, l, r.front(), r.back());
 			if (prog)
 				prog->Advance();
 		}
@@ -1499,28 +2240,30 @@ void View::AlignLine(AlignConfig conf, const Id &line_id, crn::Progress *prog)
 	// Only update frontiers
 	if (!!(conf & AlignConfig::WordFrontiers))
 	{
-		for (const auto &wid : line.GetWords())
+		for (auto w = size_t(0); w < nw; ++w)
 		{
-			const auto &wzid = GetWord(wid).GetZone();
-			if (GetZone(wzid).GetPosition().IsValid())
-				ComputeContour(wzid);
+			auto &z = wzone(w);
+			if (z.GetPosition().IsValid())
+				computeContour(z);
 		}
+		pimpl->journalZones(std::vector<size_t>(pimpl->word_zones.begin() + fw, pimpl->word_zones.begin() + fw + nw));
 	}
 	// Align characters
-	for (const auto &wid : line.GetWords())
+	for (auto w = size_t(0); w < nw; ++w)
 	{
-		if (!GetZone(GetWord(wid).GetZone()).GetPosition().IsValid())
+		if (!wzone(w).GetPosition().IsValid())
 			continue;
 
-		const auto &val = IsValid(wid);
+		const auto &val = pimpl->validation[fw + w].ok;
 		if (!!(conf & AlignConfig::CharsAllWords) ||
 				(!!(conf & AlignConfig::CharsOKWords) && val.IsTrue()) ||
 				(!!(conf & AlignConfig::CharsNKOWords) && !val.IsFalse()))
-			AlignWordCharacters(conf, line_id, wid);
+			alignWordCharacters(conf, l, fw + w);
 	}
 }
 
 /*! Computes alignment on a range of words
+ * \throws	crn::ExceptionNotFound	invalid id
  * \throws	crn::ExceptionDomain	the last word is before the first of range error
  * \throws	crn::ExceptionUninitialized	the word before or after the range is not aligned
  * \param[in]	conf	alignment options
@@ -1529,18 +2272,37 @@ void View::AlignLine(AlignConfig conf, const Id &line_id, crn::Progress *prog)
  * \param[in]	lastçword 	index of the last word to align (included!)
  */
 void View::AlignRange(AlignConfig conf, const Id &line_id, size_t first_word, size_t last_word)
+{
+	auto lit = pimpl->struc.Find(ElementKind::Line, line_id);
+	if (!lit)
+		throw crn::ExceptionNotFound{"View::AlignRange(): "_s + _("Invalid line id: ") + line_id};
+	alignRange(conf, lit->index, first_word, last_word);
+}
+
+/*! Computes alignment on a range of words
+ * \param[in]	conf	alignment options
+ * \param[in]	l	the index of the line in the view
+ * \param[in]	first_word	index of the first word to align in the line
+ * \param[in]	lastçword 	index of the last word to align in the line (included!)
+ */
+void View::alignRange(AlignConfig conf, size_t l, size_t first_word, size_t last_word)
 {
 	if (last_word < first_word)
 		throw crn::ExceptionDomain("View::AlignRange(): "_s + _("the last word is located before the first."));
-	auto &line = GetLine(line_id);
-	if (first_word >= line.GetWords().size() || last_word >= line.GetWords().size())
+	const auto &line = pimpl->struc.lines[l];
+	const auto &line_id = line.GetId();
+	const auto fw = line.first_word;
+	const auto nw = line.GetWords().size();
+	if (first_word >= nw || last_word >= nw)
 		throw crn::ExceptionDomain("View::AlignRange(): "_s + _("out of range."));
+	auto wzone = [this, fw](size_t w) -> Zone& { return pimpl->getZone(pimpl->word_zones, fw + w, pimpl->struc.word_ids[fw + w]); };
 
 	// check if the text line is associated to an image line
-	try { GetGraphicalLine(line_id); }
-	catch (crn::ExceptionDomain&) { return; }
+	const auto &link = pimpl->line_links[l];
+	if ((link.first == Impl::NONE) || (link.second >= pimpl->medlines[link.first].size()))
+		return;
 
-	auto &bl = GetGraphicalLine(line_id);
+	auto &bl = pimpl->medlines[link.first][link.second];
 	// range on image
 	auto bx = size_t(0);
 	if (first_word == 0)
@@ -1550,20 +2312,21 @@ void View::AlignRange(AlignConfig conf, const Id &line_id, size_t first_word, si
 	}
 	else
 	{
-		bx = GetZone(GetWord(line.GetWords()[first_word - 1]).GetZone()).GetPosition().GetRight() + 1; // may throw
+		bx = wzone(first_word - 1).GetPosition().GetRight() + 1; // may throw
 	}
 	auto ex = size_t(0);
-	if (last_word == line.GetWords().size() - 1)
+	if (last_word == nw - 1)
 	{
 		// end of the line
 		ex = bl.GetBack().X;
 	}
 	else
 	{
-		ex = GetZone(GetWord(line.GetWords()[last_word + 1]).GetZone()).GetPosition().GetLeft() - 1; // may throw
+		ex = wzone(last_word + 1).GetPosition().GetLeft() - 1; // may throw
 	}
 	// extract image signature
 	const auto &isig = bl.ExtractFeatures(GetBlock());
+	pimpl->modified.medlines = true; // the features are stored with the line
 	auto risig = std::vector<ImageSignature>{};
 	for (const auto &is : isig)
 	{
@@ -1574,13 +2337,16 @@ void View::AlignRange(AlignConfig conf, const Id &line_id, size_t first_word, si
 	}
 
 	// text signature
+	const auto &sigs = pimpl->struc.signatures;
+	const auto &csigs = pimpl->struc.character_signatures;
 	auto lsig = std::vector<TextSignature>{};
 	for (auto w = first_word; w <= last_word; ++w)
 	{
-		auto wsig = TextSignatureDB::Sign(GetAlignableText(line.GetWords()[w]));
-		for (auto tmp = size_t(1); tmp < wsig.size(); ++tmp)
-			wsig[tmp].start = false;
-		std::copy(wsig.begin(), wsig.end(), std::back_inserter(lsig));
+		const auto &word = pimpl->struc.words[fw + w];
+		const auto first = lsig.size();
+		lsig.insert(lsig.end(), sigs.begin() + csigs[word.first_character], sigs.begin() + csigs[word.first_character + word.GetCharacters().size()]);
+		for (auto tmp = first + 1; tmp < lsig.size(); ++tmp)
+			lsig[tmp].start = false; // one string per word
 	}
 
 	// perform alignment
@@ -1594,78 +2360,112 @@ void View::AlignRange(AlignConfig conf, const Id &line_id, size_t first_word, si
 			CRNError(_("Range align misfit at line ") + line_id);
 			break;
 		}
-		const auto &wid = line.GetWords()[w];
-		auto &word = GetWord(wid);
+		const auto &word = pimpl->struc.words[fw + w];
 		if (word.GetText().IsEmpty())
 			continue; // XXX Is this necessary???
 
-		auto &wzone = GetZone(word.GetZone());
-		SetWordImageSignature(wid, align[bbn].second);
-		if (wzone.GetPosition() != align[bbn].first)
+		auto &wz = wzone(w);
+		auto &val = pimpl->validation[fw + w];
+		pimpl->modified.validation = true;
+		val.imgsig = align[bbn].second;
+		if (wz.GetPosition() != align[bbn].first)
 		{ // BBox changed
-			ClearCharactersAlignment(wid);
-			SetValid(wid, crn::Prop3::Unknown());
+			for (auto c = word.first_character; c < word.first_character + word.GetCharacters().size(); ++c)
+				pimpl->getZone(pimpl->character_zones, c, pimpl->struc.character_ids[c]).Clear();
+			val.ok = crn::Prop3::Unknown();
 			if (align[bbn].first.IsValid())
-				wzone.SetPosition(align[bbn].first);
+				wz.SetPosition(align[bbn].first);
 		}
 		bbox |= align[bbn].first;
-		ResetCorrections(wid); // reset left/right corrections
-		ComputeContour(word.GetZone());
+		val.left_corr = val.right_corr = 0; // reset left/right corrections
+		computeContour(wz);
 
 		bbn += 1;
 	} // for each word
 
 	// recompute line's bbox
-	auto &lzone = GetZone(line.GetZone());
+	auto &lzone = pimpl->getZone(pimpl->line_zones, l, line_id);
 	bbox |= lzone.GetPosition();
 	if (bbox.IsValid())
 		lzone.SetPosition(bbox);
+
+	if (pimpl->journal)
+	{ // words, their zones and the line's zone in a single write
+		auto recs = Impl::JournalRecords{};
+		for (auto w = first_word; w <= last_word; ++w)
+			pimpl->wordRecords(fw + w, true, recs);
+		pimpl->zoneRecord(pimpl->line_zones[l], recs);
+		pimpl->appendJournal(recs);
+	}
 }
 
 /*! Aligns the characters in a word
- * \throws	crn::ExceptionNotFound	a character in the word was not found
+ * \throws	crn::ExceptionNotFound	invalid id
  * \param[in]	conf	alignment options
  * \param[in]	line_id	the id of the line
  * \param[in]	word_id	the id of the word
  */
 void View::AlignWordCharacters(AlignConfig conf, const Id &line_id, const Id &word_id)
+{
+	auto lit = pimpl->struc.Find(ElementKind::Line, line_id);
+	if (!lit)
+		throw crn::ExceptionNotFound{"View::AlignWordCharacters(): "_s + _("Invalid line id: ") + line_id};
+	auto wit = pimpl->struc.Find(ElementKind::Word, word_id);
+	if (!wit)
+		throw crn::ExceptionNotFound{"View::AlignWordCharacters(): "_s + _("Invalid word id: ") + word_id};
+	alignWordCharacters(conf, lit->index, wit->index);
+}
+
+/*! Aligns the characters in a word
+ * \throws	crn::ExceptionNotFound	a character in the word has no zone
+ * \param[in]	conf	alignment options
+ * \param[in]	l	the index of the line in the view
+ * \param[in]	w	the index of the word in the view
+ */
+void View::alignWordCharacters(AlignConfig conf, size_t l, size_t w)
 {
 	// check if the text line is associated to an image line
-	try { GetGraphicalLine(line_id); }
-	catch (crn::ExceptionDomain&) { return; }
+	const auto &link = pimpl->line_links[l];
+	if ((link.first == Impl::NONE) || (link.second >= pimpl->medlines[link.first].size()))
+		return;
 
-	auto &word = GetWord(word_id);
+	const auto &line_id = pimpl->struc.line_ids[l];
+	const auto &word = pimpl->struc.words[w];
+	const auto fc = word.first_character;
+	const auto nc = word.GetCharacters().size();
+	auto czone = [this](size_t c) -> Zone& { return pimpl->getZone(pimpl->character_zones, c, pimpl->struc.character_ids[c]); };
 
 	if (!!(conf & AlignConfig::NAlChars))
 	{
-		const auto &chars = word.GetCharacters();
-		if (chars.empty())
+		if (!nc)
 			return;
-		const auto &cha = GetCharacter(chars.front()); // may throw
-		if (GetZone(cha.GetZone()).GetPosition().IsValid())
+		if (czone(fc).GetPosition().IsValid()) // may throw
 			return; // do not realign
 	}
 
-	const auto isig = GetGraphicalLine(line_id).ExtractFeatures(GetBlock());
+	const auto isig = pimpl->medlines[link.first][link.second].ExtractFeatures(GetBlock());
+	pimpl->modified.medlines = true; // the features are stored with the line
+	const auto &sigs = pimpl->struc.signatures;
+	const auto &csigs = pimpl->struc.character_signatures;
 	auto wsig = std::vector<TextSignature>{};
-	for (const auto cid : word.GetCharacters())
+	for (auto c = fc; c < fc + nc; ++c)
 	{
-		const auto ctxt = GetCharacter(cid).GetText();
-		auto csig = TextSignatureDB::Sign(ctxt);
-		if (csig.empty())
+		if (csigs[c] == csigs[c + 1])
 		{
-			auto msg = cid + U" (Unicode: "_s + ctxt;
+			const auto &ctxt = pimpl->struc.characters[c].GetText();
+			auto msg = pimpl->struc.character_ids[c] + U" (Unicode: "_s + ctxt;
 			if (!ctxt.IsEmpty())
 				msg += U", int: "_s + int(ctxt[0]);
 			msg += U") @ line "_s + line_id + U": "_s + _("empty signature.");
 			CRNWarning(msg);
-			csig.emplace_back(true, 'l');
+			wsig.emplace_back(true, 'l');
 		}
-		std::move(csig.begin(), csig.end(), std::back_inserter(wsig));
+		else
+			wsig.insert(wsig.end(), sigs.begin() + csigs[c], sigs.begin() + csigs[c + 1]);
 	}
 
 	auto wisig = std::vector<ImageSignature>{};
-	const auto wordbox = GetZone(word.GetZone()).GetPosition();
+	const auto wordbox = pimpl->getZone(pimpl->word_zones, w, word.GetId()).GetPosition();
 	for (const auto &is : isig)
 	{
 		const auto inter = is.bbox & wordbox;
@@ -1678,100 +2478,77 @@ void View::AlignWordCharacters(AlignConfig conf, const Id &line_id, const Id &wo
 		return; // XXX
 
 	auto abox = size_t(0);
-	for (const auto &cid : word.GetCharacters())
+	for (auto c = fc; c < fc + nc; ++c)
 	{
-		const auto &czid = GetCharacter(cid).GetZone();
-		auto &czone = GetZone(czid);
-		czone.SetPosition(align[abox++].first);
-		ComputeContour(czid);
+		auto &cz = czone(c);
+		cz.SetPosition(align[abox++].first);
+		computeContour(cz);
 		if (abox >= align.size())
 		{
 			// XXX
 			break;
 		}
 	}
+	pimpl->journalZones(std::vector<size_t>(pimpl->character_zones.begin() + fc, pimpl->character_zones.begin() + fc + nc));
 }
 
 /*! Checks if an element is associated to a non-empty zone */
 bool View::IsAligned(const Id &id) const
 {
-	auto zid = id;
-
-	// is it a page?
-	auto pit = pimpl->struc.pages.find(id);
-	if (pit != pimpl->struc.pages.end())
-	{
-		zid = pit->second.GetZone();
-	}
-	else
-	{ // is it a column?
-		auto cit = pimpl->struc.columns.find(id);
-		if (cit != pimpl->struc.columns.end())
-		{
-			zid = cit->second.GetZone();
-		}
-		else
-		{ // is it a line?
-			auto lit = pimpl->struc.lines.find(id);
-			if (lit != pimpl->struc.lines.end())
-			{
-				zid = lit->second.GetZone();
-			}
-			else
-			{ // is it a word?
-				auto wit = pimpl->struc.words.find(id);
-				if (wit != pimpl->struc.words.end())
-				{
-					zid = wit->second.GetZone();
-				}
-				else
-				{ // is it a character?
-					auto chit = pimpl->struc.characters.find(id);
-					if (chit != pimpl->struc.characters.end())
-					{
-						zid = chit->second.GetZone();
-					}
-				}
-			}
-		}
+	auto it = pimpl->struc.index.find(id);
+	if (it == pimpl->struc.index.end())
+	{ // is it a zone?
+		auto zit = pimpl->zone_index.find(id);
+		return (zit != pimpl->zone_index.end()) && pimpl->zones[zit->second].GetPosition().IsValid();
 	}
-	// have we found a zone?
-	auto zit = pimpl->zones.find(zid);
-	if (zit != pimpl->zones.end())
-		return zit->second.GetPosition().IsValid();
-	else
-		return false;
+	const auto z = pimpl->zoneLinks(it->second.kind)[it->second.index];
+	return (z != Impl::NONE) && pimpl->zones[z].GetPosition().IsValid();
 }
 
-const crn::ImageGray& View::getWeight() const
+/*! Gets the cost map used to compute frontiers. The tiles are computed when needed. */
+const WeightMap& View::getWeight() const
 {
 	if (!pimpl->weight)
 	{
-		const auto wname = pimpl->datapath + "-weight.png";
-		try
-		{
-			pimpl->weight = crn::Block::New(crn::NewImageFromFile(wname))->GetGray();
-		}
-		catch (...)
-		{
-			auto diff = crn::Differential::NewGaussian(*GetBlock().GetRGB(), crn::Differential::RGBProjection::ABSMAX, 0);
-			diff.Diffuse(5);
-			pimpl->weight = std::make_shared<crn::ImageGray>(crn::Downgrade<crn::ImageGray>(diff.MakeLaplacian()));
-			for (auto tmp : Range(*pimpl->weight))
-				pimpl->weight->At(tmp) = uint8_t(pimpl->weight->At(tmp) / 2 + 127 - GetBlock().GetGray()->At(tmp) / 2);
-			pimpl->weight->SavePNG(wname);
+		GetBlock();
+		const auto store = Config::GetStoreWeightMap();
+		pimpl->weight = std::make_unique<WeightMap>(pimpl->img, GetFileStamp(GetImageName()), store ? pimpl->datapath + "-weight.tiles" : crn::Path{}, Config::GetWeightCacheSize());
+		const auto legacy = pimpl->datapath + "-weight.png";
+		if (store && crn::IO::Access(legacy, crn::IO::EXISTS))
+		{ // weight image written by former versions, replaced by the tile file
+			try
+			{
+				crn::IO::Rm(legacy);
+			}
+			catch (crn::Exception &ex)
+			{
+				CRNWarning("View::getWeight(): "_s + _("Cannot remove file ") + legacy + ": " + ex.what());
+			}
 		}
 	}
 	return *pimpl->weight;
 }
 
-Id View::addZone(Id id_base, crn::xml::Element &elem)
+/*! Creates a zone and links it to an element
+ * \param[in]	id_base	the id of the zone ("+" are appended if it already exists)
+ * \param[in]	elem	the XML element of the zone
+ * \param[in]	kind	the type of the element
+ * \param[in]	index	the index of the element
+ * \return	the id of the new zone
+ */
+Id View::addZone(crn::StringUTF8 id_base, crn::xml::Element &elem, ElementKind kind, size_t index)
 {
-	while (pimpl->zones.find(id_base) != pimpl->zones.end())
+	// only the final id is interned
+	for (auto found = Id::Find(id_base); found.IsNotEmpty() && (pimpl->zone_index.find(found) != pimpl->zone_index.end()); found = Id::Find(id_base))
 		id_base += "+";
-	pimpl->zones.emplace(id_base, elem);
+	const auto id = Id{id_base};
+	pimpl->zoneLinks(kind)[index] = pimpl->zones.size();
+	pimpl->zone_index.emplace(id, pimpl->zones.size());
+	pimpl->zones.emplace_back(elem);
+	pimpl->zones.back().modified = &pimpl->modified.zones;
+	pimpl->modified.zones = true;
 	elem.SetAttribute("xml:id", id_base);
-	return id_base;
+	return id;
 }
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -1792,11 +2569,11 @@ Id Glyph::GetParent() const
 {
 	auto note = el.GetFirstChildElement("note");
 	if (!note)
-		return "";
+		return Id{};
 	const auto str = note.GetFirstChildText();
 	if (!str.StartsWith("parent="))
-		return "";
-	return str.SubString(7);
+		return Id{};
+	return Id{str.SubString(7)};
 }
 
 /*! \para[in]	parent_id	the id of the parent glyph (with prefix) or empty string */
@@ -1812,6 +2589,8 @@ void Glyph::SetParent(const Id &parent_id)
 	note.Clear();
 	if (parent_id.IsNotEmpty())
 		note.PushBackText("parent=" + parent_id);
+	if (modified)
+		*modified = true;
 }
 
 bool Glyph::IsAuto() const
@@ -1821,45 +2600,397 @@ bool Glyph::IsAuto() const
 
 Id Glyph::LocalId(const Id &id)
 {
-	return LOCALGLYPH + id;
+	return Id{LOCALGLYPH + id};
 }
 
 Id Glyph::GlobalId(const Id &id)
 {
-	return GLOBALGLYPH + id;
+	return Id{GLOBALGLYPH + id};
 }
 
 Id Glyph::BaseId(const Id &id)
 {
 	if (IsLocal(id))
-		return id.SubString(LOCALGLYPH.Size());
+		return Id{id.Str().SubString(LOCALGLYPH.Size())};
 	else if (IsGlobal(id))
-		return id.SubString(GLOBALGLYPH.Size());
+		return Id{id.Str().SubString(GLOBALGLYPH.Size())};
 	else
 		return id;
 }
 
 bool Glyph::IsLocal(const Id &id)
 {
-	return id.StartsWith(LOCALGLYPH);
+	return id.Str().StartsWith(LOCALGLYPH);
 }
 
 bool Glyph::IsGlobal(const Id &id)
 {
-	return id.StartsWith(GLOBALGLYPH);
+	return id.Str().StartsWith(GLOBALGLYPH);
 }
 
 //////////////////////////////////////////////////////////////////////////////////
 // Document
 //////////////////////////////////////////////////////////////////////////////////
+/*! \brief Elements of a view in order of reading, before they are stored in a ViewStructure */
+struct Document::ViewSkeleton
+{
+	std::vector<Id> pages, columns, lines, words, characters; // in order of reading, may contain duplicates
+	std::unordered_map<Id, std::vector<Id>> children; // parent Id -> children Ids (left aligned words for lines)
+	std::unordered_map<Id, std::vector<Id>> center, right; // line Id -> centered or right aligned words
+	std::unordered_map<Id, crn::String> text; // character Id -> transcription
+};
+
+/*! Appends an element to a list if it was not already added */
+template<typename T> static void addElement(std::vector<T> &elems, std::vector<Id> &ids, std::unordered_map<Id, Document::ViewStructure::ElementRef> &index, ElementKind kind, const Id &id)
+{
+	if (index.emplace(id, Document::ViewStructure::ElementRef{kind, elems.size()}).second)
+	{
+		elems.emplace_back();
+		ids.push_back(id);
+	}
+}
+
+/*! Appends the children of a list of elements
+ * \return	the index of the first child of each parent, followed by the number of children
+ */
+template<typename T> static std::vector<size_t> addChildren(const std::vector<Id> &parents, const std::unordered_map<Id, std::vector<Id>> &children, std::vector<T> &elems, std::vector<Id> &ids, std::unordered_map<Id, Document::ViewStructure::ElementRef> &index, ElementKind kind)
+{
+	auto first = std::vector<size_t>{};
+	first.reserve(parents.size() + 1);
+	for (const auto &pid : parents)
+	{
+		first.push_back(elems.size());
+		auto it = children.find(pid);
+		if (it != children.end())
+			for (const auto &id : it->second)
+				addElement(elems, ids, index, kind, id);
+	}
+	first.push_back(elems.size());
+	return first;
+}
+
+/*! Stores the elements of a view in arrays, the children of each element being contiguous.
+ * Elements that were found outside of a parent are appended at the end of the arrays.
+ */
+void Document::buildStructure(ViewSkeleton &skel, ViewStructure &struc)
+{
+	for (const auto &id : skel.pages)
+		addElement(struc.pages, struc.page_ids, struc.index, ElementKind::Page, id);
+	const auto cfirst = addChildren(struc.page_ids, skel.children, struc.columns, struc.column_ids, struc.index, ElementKind::Column);
+	for (const auto &id : skel.columns)
+		addElement(struc.columns, struc.column_ids, struc.index, ElementKind::Column, id);
+	const auto lfirst = addChildren(struc.column_ids, skel.children, struc.lines, struc.line_ids, struc.index, ElementKind::Line);
+	for (const auto &id : skel.lines)
+		addElement(struc.lines, struc.line_ids, struc.index, ElementKind::Line, id);
+	// the rejected words are read after the words at the left of the line
+	for (const auto &l : skel.center)
+		std::copy(l.second.begin(), l.second.end(), std::back_inserter(skel.children[l.first]));
+	for (const auto &l : skel.right)
+		std::copy(l.second.begin(), l.second.end(), std::back_inserter(skel.children[l.first]));
+	const auto wfirst = addChildren(struc.line_ids, skel.children, struc.words, struc.word_ids, struc.index, ElementKind::Word);
+	for (const auto &id : skel.words)
+		addElement(struc.words, struc.word_ids, struc.index, ElementKind::Word, id);
+	const auto chfirst = addChildren(struc.word_ids, skel.children, struc.characters, struc.character_ids, struc.index, ElementKind::Character);
+	for (const auto &id : skel.characters)
+		addElement(struc.characters, struc.character_ids, struc.index, ElementKind::Character, id);
+
+	for (auto i = size_t(0); i < struc.characters.size(); ++i)
+		struc.characters[i].text = skel.text[struc.character_ids[i]];
+	linkStructure(struc, cfirst, lfirst, wfirst, chfirst);
+}
+
+/*! Links the elements of a view now that the arrays will not be reallocated
+ * \param[in]	struc	the elements, with their ids and the texts of the characters
+ * \param[in]	cfirst	the index of the first column of each page, followed by the number of columns
+ * \param[in]	lfirst	the index of the first line of each column, followed by the number of lines
+ * \param[in]	wfirst	the index of the first word of each line, followed by the number of words
+ * \param[in]	chfirst	the index of the first character of each word, followed by the number of characters
+ */
+void Document::linkStructure(ViewStructure &struc, const std::vector<size_t> &cfirst, const std::vector<size_t> &lfirst, const std::vector<size_t> &wfirst, const std::vector<size_t> &chfirst)
+{
+	for (auto i = size_t(0); i < struc.pages.size(); ++i)
+	{
+		auto &p = struc.pages[i];
+		p.id = struc.page_ids[i];
+		p.first_column = cfirst[i];
+		p.columns = IdRange{struc.column_ids.data() + cfirst[i], struc.column_ids.data() + cfirst[i + 1]};
+	}
+	for (auto i = size_t(0); i < struc.columns.size(); ++i)
+	{
+		auto &c = struc.columns[i];
+		c.id = struc.column_ids[i];
+		c.first_line = lfirst[i];
+		c.lines = IdRange{struc.line_ids.data() + lfirst[i], struc.line_ids.data() + lfirst[i + 1]};
+	}
+	for (auto i = size_t(0); i < struc.lines.size(); ++i)
+	{
+		auto &l = struc.lines[i];
+		l.id = struc.line_ids[i];
+		l.first_word = wfirst[i];
+		l.words = IdRange{struc.word_ids.data() + wfirst[i], struc.word_ids.data() + wfirst[i + 1]};
+	}
+	for (auto i = size_t(0); i < struc.characters.size(); ++i)
+		struc.characters[i].id = struc.character_ids[i];
+	for (auto i = size_t(0); i < struc.words.size(); ++i)
+	{
+		auto &w = struc.words[i];
+		w.id = struc.word_ids[i];
+		w.first_character = chfirst[i];
+		w.characters = IdRange{struc.character_ids.data() + chfirst[i], struc.character_ids.data() + chfirst[i + 1]};
+		// compute word transcription
+		for (auto c = chfirst[i]; c < chfirst[i + 1]; ++c)
+			w.text += struc.characters[c].GetText();
+	}
+}
+
+/*! Signs the characters of a view once, the signature of a word is a range of the array */
+void Document::signStructure(ViewStructure &struc) const
+{
+	struc.signatures.clear();
+	struc.signatures.reserve(struc.characters.size());
+	struc.character_signatures.resize(struc.characters.size() + 1);
+	for (auto i = size_t(0); i < struc.characters.size(); ++i)
+	{
+		struc.character_signatures[i] = struc.signatures.size();
+		sigdb->Sign(struc.characters[i].GetText(), struc.signatures);
+	}
+	struc.character_signatures.back() = struc.signatures.size();
+}
+
+/* Snapshot file layout
+ * 	magic (8 bytes)
+ * 	stamps of the -w and -c transcriptions
+ * 	report of errors found in the transcriptions
+ * 	views in order of the document
+ * 	elements of each view: pages, columns, lines and words (id and index of the first child), characters (id and text)
+ * 	for each view: stamps of the zones, links and ontolinks files, warnings found when checking the links
+ * Integers are uint64 in native byte order, strings and arrays are prefixed by their size.
+ */
+static const char SNAPMAGIC[8] = {'O', 'R', 'I', 'S', 'N', 'P', '0', '1'};
+
+namespace
+{
+	class SnapshotWriter
+	{
+		public:
+			SnapshotWriter() { buf.append(SNAPMAGIC, sizeof(SNAPMAGIC)); }
+			void Write(uint64_t i) { buf.append(reinterpret_cast<const char*>(&i), sizeof(i)); }
+			void Write(const crn::StringUTF8 &s) { Write(uint64_t(s.Size())); buf.append(s.CStr(), s.Size()); }
+			void Write(const FileStamp &st) { Write(st.size); Write(uint64_t(st.mtime)); }
+			template<typename T> void Write(const std::vector<Id> &ids, const std::vector<T> &elems, size_t T::*first)
+			{
+				Write(uint64_t(ids.size()));
+				for (auto i = size_t(0); i < ids.size(); ++i)
+				{
+					Write(ids[i].Str());
+					Write(uint64_t(elems[i].*first));
+				}
+			}
+			const std::string& GetData() const noexcept { return buf; }
+		private:
+			std::string buf;
+	};
+
+	class SnapshotReader
+	{
+		public:
+			SnapshotReader(const MappedFile &f):p(f.GetData()), e(f.GetData() + f.GetSize())
+			{
+				if ((f.GetSize() < sizeof(SNAPMAGIC)) || memcmp(p, SNAPMAGIC, sizeof(SNAPMAGIC)))
+					throw crn::ExceptionIO("SnapshotReader(): "_s + _("obsolete snapshot."));
+				p += sizeof(SNAPMAGIC);
+			}
+			uint64_t ReadInt()
+			{
+				check(sizeof(uint64_t));
+				auto i = uint64_t{};
+				memcpy(&i, p, sizeof(i));
+				p += sizeof(i);
+				return i;
+			}
+			crn::StringUTF8 ReadString()
+			{
+				const auto s = size_t(ReadInt());
+				check(s);
+				auto str = crn::StringUTF8{std::string{reinterpret_cast<const char*>(p), s}};
+				p += s;
+				return str;
+			}
+			FileStamp ReadStamp()
+			{
+				auto st = FileStamp{};
+				st.size = ReadInt();
+				st.mtime = int64_t(ReadInt());
+				return st;
+			}
+			/*! Reads the elements of a type and the index of their first child
+			 * \return	the index of the first child of each element, followed by the number of children
+			 */
+			template<typename T> std::vector<size_t> Read(std::vector<Id> &ids, std::vector<T> &elems, std::unordered_map<Id, Document::ViewStructure::ElementRef> &index, ElementKind kind, size_t nchildren)
+			{
+				const auto n = size_t(ReadInt());
+				auto first = std::vector<size_t>(n + 1);
+				ids.reserve(n);
+				elems.resize(n);
+				for (auto i = size_t(0); i < n; ++i)
+				{
+					ids.emplace_back(ReadString());
+					index.emplace(ids.back(), Document::ViewStructure::ElementRef{kind, i});
+					first[i] = size_t(ReadInt());
+				}
+				first[n] = nchildren;
+				for (auto i = n; i > 0; --i)
+					if ((first[i - 1] > first[i]) || (first[i] > nchildren))
+						throw crn::ExceptionIO("SnapshotReader(): "_s + _("corrupted snapshot."));
+				return first;
+			}
+		private:
+			void check(size_t s) const
+			{
+				if (size_t(e - p) < s)
+					throw crn::ExceptionIO("SnapshotReader(): "_s + _("truncated snapshot."));
+			}
+
+			const uint8_t *p, *e;
+	};
+}
+
+/*! Path to the snapshot of the structure of the document */
+crn::Path Document::snapshotPath() const
+{
+	return base / ORIDIR / name + "-snapshot.bin";
+}
+
+/*! Paths to the files that are read to check the links of a view */
+std::vector<crn::Path> Document::linkFiles(const Id &id) const
+{
+	return {
+		base / ZONEDIR / name + "_" + crn::Path{id} + "-zones.xml",
+		base / LINKDIR / name + "_" + crn::Path{id} + "-links.xml",
+		base / ONTOLINKDIR / name + "_" + crn::Path{id} + "-ontolinks.xml"
+	};
+}
+
+/*! Reads the structure of the views from the snapshot if the transcriptions did not change since it was written
+ * \param[out]	linkwarnings	the result of the link checking of the views whose files did not change
+ * \return	false if the snapshot is missing or obsolete, in which case the document is not modified
+ */
+bool Document::readSnapshot(std::unordered_map<Id, crn::StringUTF8> &linkwarnings)
+{
+	try
+	{
+		const auto file = MappedFile{snapshotPath()};
+		auto in = SnapshotReader{file};
+		if ((in.ReadStamp() != GetFileStamp(base / TEXTDIR / name + "-w.xml"_p)) || (in.ReadStamp() != GetFileStamp(base / TEXTDIR / name + "-c.xml"_p)))
+			return false;
+		auto rep = in.ReadString();
+		auto vlist = std::vector<Id>(size_t(in.ReadInt()));
+		for (auto &id : vlist)
+			id = Id{in.ReadString()};
+		auto vstruct = std::unordered_map<Id, ViewStructure>{};
+		for (auto n = in.ReadInt(); n > 0; --n)
+		{
+			auto &struc = vstruct[Id{in.ReadString()}];
+			const auto nc = size_t(in.ReadInt());
+			const auto nl = size_t(in.ReadInt());
+			const auto nw = size_t(in.ReadInt());
+			const auto nch = size_t(in.ReadInt());
+			const auto cfirst = in.Read(struc.page_ids, struc.pages, struc.index, ElementKind::Page, nc);
+			const auto lfirst = in.Read(struc.column_ids, struc.columns, struc.index, ElementKind::Column, nl);
+			const auto wfirst = in.Read(struc.line_ids, struc.lines, struc.index, ElementKind::Line, nw);
+			const auto chfirst = in.Read(struc.word_ids, struc.words, struc.index, ElementKind::Word, nch);
+			if ((struc.columns.size() != nc) || (struc.lines.size() != nl) || (struc.words.size() != nw))
+				return false;
+			struc.character_ids.reserve(nch);
+			struc.characters.resize(nch);
+			for (auto i = size_t(0); i < nch; ++i)
+			{
+				struc.character_ids.emplace_back(in.ReadString());
+				struc.index.emplace(struc.character_ids.back(), ViewStructure::ElementRef{ElementKind::Character, i});
+				struc.characters[i].text = crn::String{in.ReadString()};
+			}
+			linkStructure(struc, cfirst, lfirst, wfirst, chfirst);
+		}
+		for (auto n = in.ReadInt(); n > 0; --n)
+		{
+			const auto id = Id{in.ReadString()};
+			auto uptodate = true;
+			for (const auto &fname : linkFiles(id))
+				if (in.ReadStamp() != GetFileStamp(fname))
+					uptodate = false;
+			auto warn = in.ReadString();
+			if (uptodate)
+				linkwarnings.emplace(id, std::move(warn));
+		}
+
+		report = std::move(rep);
+		views = std::move(vlist);
+		for (const auto &id : views)
+			view_refs.emplace(id, ViewRef{});
+		view_struct = std::move(vstruct);
+		return true;
+	}
+	catch (std::exception &)
+	{ // no usable snapshot
+		linkwarnings.clear();
+		return false;
+	}
+}
+
+/*! Writes the structure of the views and the result of the link checking to the snapshot
+ * \param[in]	textreport	the errors found while reading the transcriptions
+ * \param[in]	linkwarnings	the result of the link checking of all views
+ */
+std::shared_ptr<std::string> Document::snapshotData(const crn::StringUTF8 &textreport, const std::unordered_map<Id, crn::StringUTF8> &linkwarnings) const
+{
+	auto out = SnapshotWriter{};
+	out.Write(GetFileStamp(base / TEXTDIR / name + "-w.xml"_p));
+	out.Write(GetFileStamp(base / TEXTDIR / name + "-c.xml"_p));
+	out.Write(textreport);
+	out.Write(uint64_t(views.size()));
+	for (const auto &id : views)
+		out.Write(id.Str());
+	out.Write(uint64_t(view_struct.size()));
+	for (const auto &vs : view_struct)
+	{
+		const auto &struc = vs.second;
+		out.Write(vs.first.Str());
+		out.Write(uint64_t(struc.columns.size()));
+		out.Write(uint64_t(struc.lines.size()));
+		out.Write(uint64_t(struc.words.size()));
+		out.Write(uint64_t(struc.characters.size()));
+		out.Write(struc.page_ids, struc.pages, &Page::first_column);
+		out.Write(struc.column_ids, struc.columns, &Column::first_line);
+		out.Write(struc.line_ids, struc.lines, &Line::first_word);
+		out.Write(struc.word_ids, struc.words, &Word::first_character);
+		for (auto i = size_t(0); i < struc.characters.size(); ++i)
+		{
+			out.Write(struc.character_ids[i].Str());
+			out.Write(crn::StringUTF8{struc.characters[i].GetText()});
+		}
+	}
+	out.Write(uint64_t(linkwarnings.size()));
+	for (const auto &lw : linkwarnings)
+	{
+		out.Write(lw.first.Str());
+		for (const auto &fname : linkFiles(lw.first))
+			out.Write(GetFileStamp(fname));
+		out.Write(lw.second);
+	}
+
+	return std::make_shared<std::string>(out.GetData());
+}
+
 /*!
  * \param[in]	dirpath	base directory of the project
  * \param[in]	prog	a progress bar
+ * \param[in]	nthreads	number of threads used to read the views (0 for the number of cores)
  *
  * \throws	crn::ExceptionInvalidArgument	malformed main transcription filename
  */
-Document::Document(const crn::Path &dirpath, crn::Progress *prog):
-	base(dirpath)
+Document::Document(const crn::Path &dirpath, crn::Progress *prog, size_t nthreads):
+	base(dirpath),
+	nthreads(nthreads)
 {
 	// create oriflamms directory if needed
 	if (!crn::IO::Access(base / ORIDIR, crn::IO::EXISTS))
@@ -1867,9 +2998,6 @@ Document::Document(const crn::Path &dirpath, crn::Progress *prog):
 		crn::IO::Mkdir(base / ORIDIR);
 	}
 
-	// TODO multiple choices
-	TextSignatureDB::Load(Config::GetInstance().GetStaticDataDir() / "orisig.xml");
-
 	// get base name
 	const auto txtdir = crn::IO::Directory{base / TEXTDIR};
 	auto dir = crn::IO::Directory{txtdir};
@@ -1886,55 +3014,67 @@ Document::Document(const crn::Path &dirpath, crn::Progress *prog):
 	if (name.IsEmpty())
 		throw crn::ExceptionInvalidArgument{"Document::Document(): "_s + _("Cannot find main transcription filename.")};
 
-	// read structure up to word level
-	auto milestones = std::multimap<int, Id>{};
-	{
-		auto doc = crn::xml::Document{base / TEXTDIR / name + "-w.xml"_p};
-		auto root = doc.GetRoot();
-		auto pos = ElementPosition{};
-		readTextWElements(root, pos, milestones, 'l'); // may throw
-	}
-	if (prog)
-		prog->SetMaxCount(milestones.size() + 3);
-	// check if milestones are well ordered
-	auto cnt = 1;
-	auto msok = true;
-	for (const auto &ms : milestones)
-	{
-		if (ms.first != cnt++)
-			msok = false;
-		views.push_back(ms.second);
-		view_refs.emplace(ms.second, ViewRef{});
-	}
-	if (!msok)
+	// read the structure from the snapshot if the transcriptions did not change
+	auto linkwarnings = std::unordered_map<Id, crn::StringUTF8>{};
+	const auto snapok = readSnapshot(linkwarnings);
+	if (!snapok)
 	{
-		report += name + "-w.xml";
-		report += ": ";
-		report += _("milestones are not numbered correctly: ");
+		// read structure up to word level
+		auto milestones = std::multimap<int, Id>{};
+		auto skel = std::unordered_map<Id, ViewSkeleton>{};
+		readTextW(base / TEXTDIR / name + "-w.xml"_p, skel, milestones); // may throw
+		// check if milestones are well ordered
+		auto cnt = 1;
+		auto msok = true;
 		for (const auto &ms : milestones)
-			report += ms.first + " "_s;
-		report += "\n\n";
+		{
+			if (ms.first != cnt++)
+				msok = false;
+			views.push_back(ms.second);
+			view_refs.emplace(ms.second, ViewRef{});
+		}
+		if (!msok)
+		{
+			report += name + "-w.xml";
+			report += ": ";
+			report += _("milestones are not numbered correctly: ");
+			for (const auto &ms : milestones)
+				report += ms.first + " "_s;
+			report += "\n\n";
+		}
+		// read structure at character level
+		readTextC(base / TEXTDIR / name + "-c.xml"_p, skel); // may throw
+		// store the elements and compute words transcription
+		for (auto &vs : skel)
+			buildStructure(vs.second, view_struct[vs.first]);
+		// empty views, so that view_struct is never modified once views are loaded concurrently
+		for (const auto &id : views)
+			view_struct[id];
 	}
-	// read structure at character level
+	const auto textreport = report;
+
+	// sign the transcription with the table of its script
+	try
 	{
-		auto doc = crn::xml::Document{base / TEXTDIR / name + "-c.xml"_p};
-		auto root = doc.GetRoot();
-		auto pos = ElementPosition{};
-		readTextCElements(root, pos);
+		const auto sigdoc = crn::xml::Document{base / ORIDIR / "signatures.xml"};
+		sigdb_name = sigdoc.GetRoot().GetAttribute<crn::StringUTF8>("table");
+		sigdb = TextSignatureDB::Get(sigdb_name);
 	}
-	// compute words transcription
-	for (auto &v : view_struct)
-	{
-		for (auto &w : v.second.words)
-		{
-			auto trans = crn::String{};
-			for (const auto &cid : w.second.GetCharacters())
-				trans += v.second.characters[cid].GetText();
-			w.second.text = trans;
-		}
+	catch (crn::Exception &ex)
+	{ // no choice or unknown table
+		if (sigdb_name.IsNotEmpty())
+			report += _("Signature table: ") + crn::StringUTF8(ex.what()) + "\n\n";
+		sigdb_name = "";
+		sigdb = TextSignatureDB::GetDefault();
 	}
+	for (auto &vs : view_struct)
+		signStructure(vs.second);
+
 	if (prog)
+	{
+		prog->SetMaxCount(views.size() + 3);
 		prog->Advance();
+	}
 
 	// read global ontology file
 	try
@@ -1950,7 +3090,7 @@ Document::Document(const crn::Path &dirpath, crn::Progress *prog):
 		el = el.GetFirstChildElement("glyph");
 		while (el)
 		{
-			glyphs.emplace(Glyph::GlobalId(el.GetAttribute<Id>("xml:id")), Glyph{el});
+			glyphs.emplace(Glyph::GlobalId(Id{el.GetAttribute<crn::StringUTF8>("xml:id")}), Glyph{el});
 			el = el.GetNextSiblingElement("glyph");
 		}
 	}
@@ -1975,7 +3115,8 @@ Document::Document(const crn::Path &dirpath, crn::Progress *prog):
 		el = charDecl->GetFirstChildElement("glyph");
 		while (el)
 		{
-			glyphs.emplace(Glyph::LocalId(el.GetAttribute<Id>("xml:id")), Glyph{el});
+			auto &g = glyphs.emplace(Glyph::LocalId(Id{el.GetAttribute<crn::StringUTF8>("xml:id")}), Glyph{el}).first->second;
+			g.modified = onto_modified.get();
 			el = el.GetNextSiblingElement("glyph");
 		}
 	}
@@ -2004,7 +3145,7 @@ Document::Document(const crn::Path &dirpath, crn::Progress *prog):
 		el = el.PushBackElement("body");
 		el = el.PushBackElement("p");
 		el.PushBackText(_("Allograph declaration"));
-		local_onto.Save(base / ONTODIR / name + "_ontology.xml");
+		*onto_modified = true; // the file is written with the first save
 	}
 	if (prog)
 		prog->Advance();
@@ -2024,27 +3165,25 @@ Document::Document(const crn::Path &dirpath, crn::Progress *prog):
 				report += ": ";
 				report += _("missing id list.");
 				report += "\n\n";
+				el = el.GetNextSiblingElement("dm");
 				continue;
 			}
-			auto idlist = iel.GetFirstChildText().Split(" ");
-			/*
-				 auto mel = el.GetFirstChildElement("SquareMatrixDouble");
-				 if (!mel)
-				 {
-				 report += "char_dm.xml";
-				 report += ": ";
-				 report += _("missing distance matrix.");
-				 report += "\n";
-				 continue;
-				 }
-				 chars_dm.emplace(el.GetAttribute<crn::StringUTF8>("charname", false), std::make_pair(std::move(idlist), crn::SquareMatrixDouble{mel}));
-				 */
+			auto idlist = std::vector<Id>{};
+			for (const auto &id : iel.GetFirstChildText().Split(" "))
+				idlist.emplace_back(id);
 			const auto num = el.GetAttribute<int>("num", false);
-			std::ifstream matfile;
-			matfile.open((base / ORIDIR / "dm"_p + num + ".dat"_p).CStr(), std::ios::in|std::ios::binary);
-			auto dm = crn::SquareMatrixDouble{idlist.size()};
-			matfile.read(reinterpret_cast<char *>(const_cast<double*>(dm.Std().data())), dm.Std().size() * sizeof(double));
-			chars_dm.emplace(el.GetAttribute<crn::StringUTF8>("charname", false), std::make_pair(std::move(idlist), std::move(dm)));
+			auto hashes = std::vector<uint64_t>{};
+			auto hel = el.GetFirstChildElement("hashes");
+			if (hel)
+			{
+				for (const auto &h : hel.GetFirstChildText().Split(" "))
+					hashes.push_back(uint64_t(strtoull(h.CStr(), nullptr, 16)));
+				if (hashes.size() != idlist.size())
+					hashes.clear(); // the matrix will be recomputed entirely when updated
+			}
+			auto method = el.GetAttribute<crn::StringUTF8>("method", true);
+			// the matrix is mapped when it is first used
+			chars_dm.emplace(el.GetAttribute<crn::StringUTF8>("charname", false), CharacterDistances{std::make_shared<std::pair<std::vector<Id>, DistanceMatrix>>(std::move(idlist), DistanceMatrix{}), num, false, true, std::move(hashes), method});
 			el = el.GetNextSiblingElement("dm");
 		}
 	}
@@ -2058,36 +3197,71 @@ Document::Document(const crn::Path &dirpath, crn::Progress *prog):
 	if (prog)
 		prog->Advance();
 
-	// read all files
-	for (const auto &id : views)
+	// check the links of all views whose files changed, in parallel, the views are opened when needed
+	auto snapchanged = !snapok;
 	{
-		auto v = GetView(id);
-		warningreport += v.pimpl->logmsg;
-		if (prog)
-			prog->Advance();
+		ThreadPool pool(nthreads);
+		auto checks = std::unordered_map<Id, std::future<crn::StringUTF8>>{};
+		for (const auto &id : views)
+			if (linkwarnings.find(id) == linkwarnings.end())
+				checks.emplace(id, pool.Submit([this, id]() { return checkLinks(id); }));
+		for (const auto &id : views)
+		{
+			auto it = linkwarnings.find(id);
+			if (it == linkwarnings.end())
+			{
+				it = linkwarnings.emplace(id, checks[id].get()).first; // may throw
+				snapchanged = true;
+			}
+			warningreport += it->second;
+			if (prog)
+				prog->Advance();
+		}
 	}
+	if (snapchanged)
+		pending_snapshot = snapshotData(textreport, linkwarnings); // opening a project does not write anything
 }
 
 Document::~Document()
 {
-	Save();
+	view_cache.clear(); // save the views
+	try
+	{
+		Save();
+	}
+	catch (std::exception &ex)
+	{
+		CRNWarning(name + ": "_s + ex.what());
+	}
 }
 
 void Document::TidyUp(crn::Progress *prog)
 {
 	if (prog)
 		prog->SetMaxCount(views.size());
-	// read all files
+	// read all files, a few views ahead of the one being tidied up
+	ThreadPool pool(nthreads);
+	auto loading = std::deque<std::future<View>>{};
+	auto next = size_t(0);
 	for (const auto &id : views)
 	{
-		auto v = getCleanView(id);
+		while ((next < views.size()) && (loading.size() < pool.GetSize()))
+		{
+			const auto vid = views[next++];
+			loading.push_back(pool.Submit([this, vid]() { return getCleanView(vid); }));
+		}
+		auto v = loading.front().get(); // may throw
+		loading.pop_front();
 		auto need_lines = false;
 		// index and compute boxes if needed
-		for (auto &p : v.pimpl->struc.pages)
+		auto &struc = v.pimpl->struc;
+		for (auto pnum = size_t(0); pnum < struc.pages.size(); ++pnum)
 		{ // for each page
-			positions.emplace(p.first, ElementPosition{id, p.first});
+			auto &p = struc.pages[pnum];
+			const auto &pid = p.GetId();
+			setPosition(pid, ElementPosition{id, pid});
 
-			if (p.second.GetZone().IsEmpty())
+			if (p.GetZone().IsEmpty())
 			{
 				// add zone to XML
 				auto root = v.pimpl->zonesdoc.GetRoot();
@@ -2101,28 +3275,31 @@ void Document::TidyUp(crn::Progress *prog)
 				el.SetAttribute("lrx", pbox.GetRight());
 				el.SetAttribute("lry", pbox.GetBottom());
 				// add zone to page
-				p.second.zone = v.addZone("zone-" + p.first, el);
+				p.zone = v.addZone("zone-" + pid, el, ElementKind::Page, pnum);
 				// add link
+				v.pimpl->modified.links = true;
 				auto linkit = v.pimpl->link_groups.find(PAGELINKS);
 				el = linkit->second.PushBackElement("link");
-				el.SetAttribute("target", "txt:" + p.first + " img:" + p.second.zone);
+				el.SetAttribute("target", "txt:" + pid + " img:" + p.zone);
 			}
-			auto &pzone = v.GetZone(p.second.GetZone());
+			auto &pzone = v.GetZone(p.GetZone());
 
 			auto pbox = crn::Rect{};
-			for (auto &cid : p.second.GetColumns())
+			for (auto c = p.first_column; c < p.first_column + p.GetColumns().size(); ++c)
 			{ // columns
-				positions.emplace(cid, ElementPosition{id, p.first, cid});
+				auto &col = struc.columns[c];
+				const auto &cid = col.GetId();
+				setPosition(cid, ElementPosition{id, pid, cid});
 
-				auto &col = v.GetColumn(cid);
 				if (col.GetZone().IsEmpty())
 				{
 					// add zone to XML
 					auto el = pzone.el.PushBackElement("zone");
 					el.SetAttribute("type", "column");
 					// add zone to page
-					col.zone = v.addZone("zone-" + cid, el);
+					col.zone = v.addZone("zone-" + cid, el, ElementKind::Column, c);
 					// add link
+					v.pimpl->modified.links = true;
 					auto linkit = v.pimpl->link_groups.find(COLUMNLINKS);
 					el = linkit->second.PushBackElement("link");
 					el.SetAttribute("target", "txt:" + cid + " img:" + col.zone);
@@ -2130,19 +3307,21 @@ void Document::TidyUp(crn::Progress *prog)
 				auto &czone = v.GetZone(col.GetZone());
 
 				auto cbox = crn::Rect{};
-				for (auto &lid : col.GetLines())
+				for (auto l = col.first_line; l < col.first_line + col.GetLines().size(); ++l)
 				{ // lines
-					positions.emplace(lid, ElementPosition{id, p.first, cid, lid});
+					auto &line = struc.lines[l];
+					const auto &lid = line.GetId();
+					setPosition(lid, ElementPosition{id, pid, cid, lid});
 
-					auto &line = v.GetLine(lid);
 					if (line.GetZone().IsEmpty())
 					{
 						// add zone to XML
 						auto el = czone.el.PushBackElement("zone");
 						el.SetAttribute("type", "line");
 						// add zone to page
-						line.zone = v.addZone("zone-" + lid, el);
+						line.zone = v.addZone("zone-" + lid, el, ElementKind::Line, l);
 						// add link
+						v.pimpl->modified.links = true;
 						auto linkit = v.pimpl->link_groups.find(LINELINKS);
 						el = linkit->second.PushBackElement("link");
 						el.SetAttribute("target", "txt:" + lid + " img:" + line.zone);
@@ -2151,53 +3330,57 @@ void Document::TidyUp(crn::Progress *prog)
 
 					auto lbox = crn::Rect{};
 					auto medianline = std::vector<crn::Point2DInt>{};
-					for (auto &wid : line.GetWords())
+					for (auto w = line.first_word; w < line.first_word + line.GetWords().size(); ++w)
 					{ // words
-						positions.emplace(wid, ElementPosition{id, p.first, cid, lid, wid});
+						auto &word = struc.words[w];
+						const auto &wid = word.GetId();
+						setPosition(wid, ElementPosition{id, pid, cid, lid, wid});
 
-						auto &word = v.GetWord(wid);
 						if (word.GetZone().IsEmpty())
 						{
 							// add zone to XML
 							auto el = lzone.el.PushBackElement("zone");
 							el.SetAttribute("type", "word");
 							// add zone to page
-							word.zone = v.addZone("zone-" + wid, el);
+							word.zone = v.addZone("zone-" + wid, el, ElementKind::Word, w);
 							// add link
+							v.pimpl->modified.links = true;
 							auto linkit = v.pimpl->link_groups.find(WORDLINKS);
 							el = linkit->second.PushBackElement("link");
 							el.SetAttribute("target", "txt:" + wid + " img:" + word.zone);
 						}
 						auto &wzone = v.GetZone(word.GetZone());
 
-						for (const auto &cid : word.GetCharacters())
+						for (auto ch = word.first_character; ch < word.first_character + word.GetCharacters().size(); ++ch)
 						{ // characters
-							positions.emplace(cid, ElementPosition{id, p.first, cid, lid, wid});
+							auto &cha = struc.characters[ch];
+							const auto &chid = cha.GetId();
+							setPosition(chid, ElementPosition{id, pid, cid, lid, wid});
 
-							auto &cha = v.GetCharacter(cid);
 							if (cha.GetZone().IsEmpty())
 							{
 								// add zone to XML
 								auto el = wzone.el.PushBackElement("zone");
 								el.SetAttribute("type", "character");
 								// add zone to page
-								cha.zone = v.addZone("zone-" + cid, el);
+								cha.zone = v.addZone("zone-" + chid, el, ElementKind::Character, ch);
 								// add link
+								v.pimpl->modified.links = true;
 								auto linkit = v.pimpl->link_groups.find(CHARLINKS);
 								el = linkit->second.PushBackElement("link");
-								el.SetAttribute("target", "txt:" + cid + " img:" + cha.zone);
+								el.SetAttribute("target", "txt:" + chid + " img:" + cha.zone);
 							}
 							else
 							{
-								auto &czone = v.GetZone(cha.GetZone());
-								const auto &cpos = czone.GetPosition();
-								if (cpos.IsValid() && czone.GetContour().empty())
+								auto &chzone = v.GetZone(cha.GetZone());
+								const auto &cpos = chzone.GetPosition();
+								if (cpos.IsValid() && chzone.GetContour().empty())
 								{
 									// compute contour
 									auto contour = v.ComputeFrontier(cpos.GetLeft(), cpos.GetTop(), cpos.GetBottom());
 									auto contour2 = v.ComputeFrontier(cpos.GetRight(), cpos.GetTop(), cpos.GetBottom());
 									std::move(contour2.rbegin(), contour2.rend(), std::back_inserter(contour));
-									czone.SetContour(contour);
+									chzone.SetContour(contour);
 								}
 							}
 						}
@@ -2232,8 +3415,9 @@ void Document::TidyUp(crn::Progress *prog)
 						}
 						catch (...)
 						{
-							v.pimpl->medlines[cid].emplace_back(std::make_shared<crn::LinearInterpolation>(medianline.begin(), medianline.end()), lbox.GetHeight());
-							v.pimpl->line_links.emplace(lid, std::make_pair(cid, v.pimpl->medlines[cid].size() - 1));
+							v.pimpl->medlines[c].emplace_back(std::make_shared<crn::LinearInterpolation>(medianline.begin(), medianline.end()), lbox.GetHeight());
+							v.pimpl->line_links[l] = std::make_pair(c, v.pimpl->medlines[c].size() - 1);
+							v.pimpl->modified.medlines = v.pimpl->modified.line_links = true;
 						}
 					}
 
@@ -2263,7 +3447,23 @@ void Document::TidyUp(crn::Progress *prog)
 
 		} // pages
 		if (need_lines)
-			v.detectLines();
+			v.DetectLines();
+		if (prog)
+			prog->Advance();
+	}
+}
+
+/*! Replaces the graphical lines of all views with automatically detected ones
+ * \param[in]	prog	a progress bar
+ */
+void Document::DetectLines(crn::Progress *prog)
+{
+	if (prog)
+		prog->SetMaxCount(int(views.size()));
+	for (const auto &vid : views)
+	{
+		auto v = GetView(vid);
+		v.DetectLines();
 		if (prog)
 			prog->Advance();
 	}
@@ -2271,58 +3471,195 @@ void Document::TidyUp(crn::Progress *prog)
 
 void Document::Save() const
 {
-	local_onto.Save();
-	// save distance matrices
-	auto dmdoc = crn::xml::Document{};
-	auto root = dmdoc.PushBackElement("charsdm");
-	auto cnt = 0;
-	for (const auto &dm : chars_dm)
+	SaveAsync().get();
+}
+
+std::shared_future<void> Document::SaveAsync() const
+{
+	auto done = std::make_shared<std::promise<void>>();
+	auto res = done->get_future().share();
+	if (!bgsave)
+	{ // moved-from document
+		done->set_value();
+		return res;
+	}
+
+	// copy the modified data
+	auto writes = std::vector<std::function<void()>>{};
+	auto saved_views = std::vector<std::shared_ptr<View::Impl>>{};
+	for (const auto &ref : view_refs)
+	{
+		auto v = ref.second.lock();
+		if (!v)
+			continue; // closed views were saved when they were released
+		std::lock_guard<std::mutex> flock(crn::FileShield::GetMutex("views://" + v->id));
+		const auto nw = writes.size();
+		v->prepareSave(writes);
+		if (writes.size() != nw)
+		{
+			v->pending_save = res;
+			saved_views.push_back(std::move(v)); // keep the view alive so that its own save is written afterwards
+		}
+	}
+	const auto failed = bgsave->failed.exchange(false);
+	if (pending_snapshot)
+	{
+		auto snap = std::move(pending_snapshot);
+		const auto fname = snapshotPath();
+		writes.push_back([snap, fname]()
+			{
+				try
+				{
+					WriteFileAtomically(fname, snap->data(), snap->size());
+				}
+				catch (crn::Exception &ex)
+				{ // the project will be read again next time
+					CRNWarning(ex.what());
+				}
+			});
+	}
+	if (*onto_modified || failed)
+	{
+		writes.push_back(writeLater(base / ONTODIR / name + "_ontology.xml", local_onto.AsString()));
+		*onto_modified = false;
+	}
+	for (auto &dm : chars_dm)
+		if (!dm.second.saved || (failed && dm.second.loaded))
+		{
+			auto mat = dm.second.dm; // the matrix is shared, not copied
+			const auto fname = distanceMatrixPath(dm.second.num);
+			const auto dense = denseMatrixPath(dm.second.num);
+			writes.push_back([mat, fname, dense]()
+				{
+					mat->second.Save(fname);
+					if (crn::IO::Access(dense, crn::IO::EXISTS))
+						crn::IO::Rm(dense); // the former file was converted
+				});
+			dm.second.saved = true;
+		}
+	if (dm_modified || failed)
 	{
-		auto el = root.PushBackElement("dm");
-		el.SetAttribute("charname", dm.first.CStr());
-		el.SetAttribute("num", cnt);
-		std::ofstream matfile;
-		matfile.open((base / ORIDIR / "dm"_p + cnt + ".dat"_p).CStr(), std::ios::out|std::ios::binary);
-		matfile.write(reinterpret_cast<const char *>(dm.second.second.Std().data()), dm.second.second.Std().size() * sizeof(double));
-		//dm.second.second.Serialize(el);
-		el = el.PushBackElement("ids");
-		auto idlist = crn::StringUTF8{};
-		for (const auto &id : dm.second.first)
+		auto dmdoc = crn::xml::Document{};
+		auto root = dmdoc.PushBackElement("charsdm");
+		for (const auto &dm : chars_dm)
 		{
-			idlist += id;
-			idlist += ' ';
+			auto el = root.PushBackElement("dm");
+			el.SetAttribute("charname", dm.first.CStr());
+			el.SetAttribute("num", dm.second.num);
+			if (dm.second.method.IsNotEmpty())
+				el.SetAttribute("method", dm.second.method);
+			auto iel = el.PushBackElement("ids");
+			auto idlist = crn::StringUTF8{};
+			for (const auto &id : dm.second.dm->first)
+			{
+				idlist += id;
+				idlist += ' ';
+			}
+			iel.PushBackText(idlist);
+			if (!dm.second.hashes.empty())
+			{
+				auto hlist = std::string{};
+				char buf[20];
+				for (const auto h : dm.second.hashes)
+				{
+					snprintf(buf, sizeof(buf), "%llx ", static_cast<unsigned long long>(h));
+					hlist += buf;
+				}
+				el.PushBackElement("hashes").PushBackText(hlist);
+			}
 		}
-		el.PushBackText(idlist);
-		cnt += 1;
+		writes.push_back(writeLater(base / ORIDIR / "char_dm.xml", dmdoc.AsString()));
+		dm_modified = false;
 	}
-	dmdoc.Save(base / ORIDIR / "char_dm.xml");
+
+	// write in the background
+	auto *state = bgsave.get();
+	auto pwrites = std::make_shared<std::vector<std::function<void()>>>(std::move(writes));
+	auto pviews = std::make_shared<std::vector<std::shared_ptr<View::Impl>>>(std::move(saved_views));
+	bgsave->writer.Submit([pwrites, pviews, done, state]()
+		{
+			try
+			{
+				for (const auto &w : *pwrites)
+					w();
+				done->set_value();
+			}
+			catch (...)
+			{
+				for (const auto &v : *pviews)
+					v->write_failed = true;
+				state->failed = true;
+				done->set_exception(std::current_exception());
+			}
+		});
+	return res;
+}
+
+/*! Selects the signature table of the document's script and signs the transcription again. The choice is saved at once.
+ * \throws	crn::ExceptionNotFound	no such table
+ * \throws	crn::ExceptionIO	cannot save the choice
+ * \param[in]	tname	the name of the table, or an empty string for the default table
+ */
+void Document::SetSignatureTable(const crn::StringUTF8 &tname)
+{
+	sigdb = TextSignatureDB::Get(tname); // may throw
+	sigdb_name = tname;
+	for (auto &vs : view_struct)
+		signStructure(vs.second);
+	auto sigdoc = crn::xml::Document{};
+	auto root = sigdoc.PushBackElement("signatures");
+	root.SetAttribute("table", sigdb_name);
+	saveXml(sigdoc, base / ORIDIR / "signatures.xml");
 }
 
 const ElementPosition& Document::GetPosition(const Id &elem_id) const
 {
-	auto it = positions.find(elem_id);
-	if (it == positions.end())
+	auto it = position_index.find(elem_id);
+	if (it == position_index.end())
 		throw crn::ExceptionNotFound("Document::GetPosition(): "_s + _("invalid id: ") + elem_id);
-	return it->second;
+	return positions[it->second];
+}
+
+/*! Stores the position of an element. The first position stored for an id is kept. */
+void Document::setPosition(const Id &elem_id, const ElementPosition &pos)
+{
+	if (position_index.emplace(elem_id, uint32_t(positions.size())).second)
+		positions.push_back(pos);
 }
 
 View Document::GetView(const Id &id)
 {
-	std::lock_guard<std::mutex> flock(crn::FileShield::GetMutex("views://doc/" + id));
+	return openView(id, false);
+}
 
-	auto it = view_refs.find(id);
-	if (it == view_refs.end())
-		throw crn::ExceptionNotFound("Document::GetView(): "_s + _("Cannot find view with id ") + id);
+/*!
+ * \throws	crn::ExceptionNotFound	invalid id
+ * \param[in]	view_id	the id of the view
+ * \return	the number of characters in the transcription of the view
+ */
+size_t Document::CountCharacters(const Id &view_id) const
+{
+	auto it = view_struct.find(view_id);
+	if (it == view_struct.end())
+		throw crn::ExceptionNotFound("Document::CountCharacters(): "_s + _("Cannot find view with id ") + view_id);
+	return it->second.characters.size();
+}
 
-	auto v = std::shared_ptr<View::Impl>{};
-	if (it->second.expired())
-	{
-		v = std::make_shared<View::Impl>(id, view_struct[id], base, name, false); // may throw
-		it->second = v;
-	}
-	else
-		v = it->second.lock();
-	return View(v);
+/*! The view is saved by the last View that refers to it
+ * \param[in]	view_id	the id of the view
+ */
+void Document::ReleaseView(const Id &view_id)
+{
+	auto it = view_refs.find(view_id);
+	if (it == view_refs.end())
+		return;
+	// the view cannot be opened again before it is saved
+	std::lock_guard<std::mutex> flock(crn::FileShield::GetMutex("views://doc/" + view_id));
+	auto v = it->second.lock();
+	if (!v)
+		return;
+	std::lock_guard<std::mutex> lock(crn::FileShield::GetMutex("views://cache/" + name));
+	view_cache.remove(v); // the view is saved once the cache is unlocked
 }
 
 /*! Erases image signatures in the document
@@ -2336,8 +3673,9 @@ void Document::ClearSignatures(crn::Progress *prog)
 	{
 		auto v = GetView(vid);
 		for (auto &col : v.pimpl->medlines)
-			for (auto &gl : col.second)
+			for (auto &gl : col)
 				gl.ClearFeatures();
+		v.pimpl->modified.medlines = true;
 		if (prog)
 			prog->Advance();
 	}
@@ -2375,34 +3713,46 @@ void Document::PropagateValidation(crn::Progress *prog)
 	for (const auto &vid : views)
 	{
 		auto v = GetView(vid);
-		for (const auto &lp : v.pimpl->struc.lines)
+		auto &val = v.pimpl->validation;
+		auto changed = std::vector<size_t>{};
+		for (const auto &line : v.pimpl->struc.lines)
 		{
-			if (lp.second.GetWords().size() < 3)
+			if (line.GetWords().size() < 3)
 				continue;
 
-			for (size_t w = 1; w < lp.second.GetWords().size() - 1; ++w)
+			const auto fw = line.first_word;
+			for (auto w = fw + 1; w < fw + line.GetWords().size() - 1; ++w)
 			{
-				const auto &precid = lp.second.GetWords()[w - 1];
-				const auto &currid = lp.second.GetWords()[w];
-				const auto &nextid = lp.second.GetWords()[w + 1];
+				auto &prec = val[w - 1].ok;
+				auto &curr = val[w].ok;
+				auto &next = val[w + 1].ok;
 				
-				if (v.IsValid(precid).IsTrue() && v.IsValid(currid).IsUnknown() && v.IsValid(nextid).IsTrue())
+				if (prec.IsTrue() && curr.IsUnknown() && next.IsTrue())
 				{
 					// 1 ? 1 -> 1 1 1
-					v.SetValid(currid, true);
+					curr = true;
+					changed.push_back(w);
 				}
-				if (v.IsValid(precid).IsTrue() && v.IsValid(currid).IsFalse() && v.IsValid(nextid).IsUnknown())
+				if (prec.IsTrue() && curr.IsFalse() && next.IsUnknown())
 				{
 					// 1 0 ? -> 1 0 0
-					v.SetValid(nextid, false);
+					next = false;
+					changed.push_back(w + 1);
 				}
-				if (v.IsValid(precid).IsUnknown() && v.IsValid(currid).IsFalse() && v.IsValid(nextid).IsTrue())
+				if (prec.IsUnknown() && curr.IsFalse() && next.IsTrue())
 				{
 					// ? 0 1 -> 0 0 1
-					v.SetValid(precid, false);
+					prec = false;
+					changed.push_back(w - 1);
 				}
 			} // words
 		} // lines
+		if (!changed.empty())
+		{
+			v.pimpl->modified.validation = true;
+			for (auto w : changed)
+				v.pimpl->journalWord(w, false);
+		}
 		if (prog)
 			prog->Advance();
 	} // views
@@ -2416,7 +3766,7 @@ std::map<crn::String, std::unordered_map<Id, std::vector<Id>>> Document::Collect
 	for (const auto &v : view_struct)
 	{
 		for (const auto &c : v.second.characters)
-			res[c.second.GetText()][v.first].push_back(c.first);
+			res[c.GetText()][v.first].push_back(c.GetId());
 	}
 	return res;
 }
@@ -2451,13 +3801,16 @@ Glyph& Document::AddGlyph(const Id &id, const crn::StringUTF8 &desc, const Id &p
 	if (glyphs.find(lid) != glyphs.end())
 		throw crn::ExceptionDomain("Document::AddGlyph(): "_s + _("the glyph already exists: ") + id);
 	auto el = charDecl->PushBackElement("glyph");
-	el.SetAttribute("xml:id", id);
+	el.SetAttribute("xml:id", id.Str());
 	el.PushBackElement("desc").PushBackText(desc);
 	if (parent.IsNotEmpty())
 		el.PushBackElement("note").PushBackText("parent=" + parent);
 	if (automatic)
 		el.SetAttribute("change", "#auto");
-	return glyphs.emplace(lid, Glyph{el}).first->second;
+	*onto_modified = true;
+	auto &g = glyphs.emplace(lid, Glyph{el}).first->second;
+	g.modified = onto_modified.get();
+	return g;
 }
 
 static crn::xml::Element addcell(crn::xml::Element &row)
@@ -2703,16 +4056,17 @@ void Document::ExportStats(const crn::Path &fname)
 		{
 			auto err = false;
 			auto precend = U' ';
-			for (auto tmpw = size_t(0); tmpw < l.second.GetWords().size(); ++tmpw)
+			const auto words = v.GetWords(l);
+			for (auto tmpw = size_t(0); tmpw < words.size(); ++tmpw)
 			{
-				const auto &wid = l.second.GetWords()[tmpw];
-				const auto &w = v.GetWord(wid);
+				const auto &w = words[tmpw];
 				if (w.GetText().IsEmpty())
 					continue;
+				const auto &val = v.pimpl->validation[l.first_word + tmpw];
 				auto nextini = U' ';
-				if ((tmpw + 1 < l.second.GetWords().size()) && !v.GetWord(l.second.GetWords()[tmpw + 1]).GetText().IsEmpty())
-					nextini = v.GetWord(l.second.GetWords()[tmpw + 1]).GetText()[0];
-				if (v.IsValid(wid).IsTrue())
+				if ((tmpw + 1 < words.size()) && !words[tmpw + 1].GetText().IsEmpty())
+					nextini = words[tmpw + 1].GetText()[0];
+				if (val.ok.IsTrue())
 				{
 					wok += 1;
 					wordstat[w.GetText()].ok += 1;
@@ -2724,7 +4078,7 @@ void Document::ExportStats(const crn::Path &fname)
 					precend_startstat[precend][w.GetText()[0]].ok += 1;
 					end_nextinistat[w.GetText()[w.GetText().Length() - 1]][nextini].ok += 1;
 				}
-				else if (v.IsValid(wid).IsFalse())
+				else if (val.ok.IsFalse())
 				{
 					wko += 1;
 					wordstat[w.GetText()].ko += 1;
@@ -2751,7 +4105,7 @@ void Document::ExportStats(const crn::Path &fname)
 				}
 				precend = w.GetText()[w.GetText().Length() - 1];
 				auto corr = false;
-				const auto lcorr = v.GetLeftCorrection(wid);
+				const auto lcorr = val.left_corr;
 				if (lcorr != 0)
 				{
 					if (tmpw == 0)
@@ -2764,7 +4118,7 @@ void Document::ExportStats(const crn::Path &fname)
 					inistat[w.GetText()[0]].leftc += lcorr;
 					inistat[w.GetText()[0]].leftac += crn::Abs(lcorr);
 				}
-				const auto rcorr = v.GetRightCorrection(wid);
+				const auto rcorr = val.right_corr;
 				if (rcorr != 0)
 				{
 					corr = true;
@@ -3126,17 +4480,89 @@ void Document::ExportStats(const crn::Path &fname)
 	ods.Save();
 }
 
+/*! Path to the file of a distance matrix */
+crn::Path Document::distanceMatrixPath(int num) const
+{
+	return base / ORIDIR / "dm"_p + num + ".odm"_p;
+}
+
+/*! Path to the dense matrix of doubles written by former versions */
+crn::Path Document::denseMatrixPath(int num) const
+{
+	return base / ORIDIR / "dm"_p + num + ".dat"_p;
+}
+
 /*!
  * \throws	crn::ExceptionNotFound	the distance matrix was not computed for this character
  * \param[in]	character	the character string
  * \return	the distance matrix for the character
  */
-const std::pair<std::vector<Id>, crn::SquareMatrixDouble>& Document::GetDistanceMatrix(const crn::String &character) const
+const std::pair<std::vector<Id>, DistanceMatrix>& Document::GetDistanceMatrix(const crn::String &character) const
 {
 	auto it = chars_dm.find(character);
 	if (it == chars_dm.end())
 		throw crn::ExceptionNotFound{"Document::GetDistanceMatrix(): "_s + _("character not found.")};
-	return it->second;
+	if (!it->second.loaded)
+	{
+		const auto fname = distanceMatrixPath(it->second.num);
+		const auto dense = denseMatrixPath(it->second.num);
+		if (!crn::IO::Access(fname, crn::IO::EXISTS) && crn::IO::Access(dense, crn::IO::EXISTS))
+		{ // dense matrix of doubles written by former versions, converted by the next save
+			it->second.dm->second = DistanceMatrix::ReadDense(dense, it->second.dm->first.size()); // may throw
+			it->second.saved = false;
+		}
+		else
+			it->second.dm->second = DistanceMatrix::Map(fname); // may throw
+		it->second.loaded = true;
+	}
+	return *it->second.dm;
+}
+
+/*!
+ * \throws	crn::ExceptionNotFound	the distance matrix was not computed for this character
+ * \param[in]	character	the character string
+ * \return	the hashes of the zones of the occurrences, in the order of the matrix, or an empty list if the matrix was computed by a former version
+ */
+const std::vector<uint64_t>& Document::GetDistanceHashes(const crn::String &character) const
+{
+	auto it = chars_dm.find(character);
+	if (it == chars_dm.end())
+		throw crn::ExceptionNotFound{"Document::GetDistanceHashes(): "_s + _("character not found.")};
+	return it->second.hashes;
+}
+
+/*!
+ * \throws	crn::ExceptionNotFound	the distance matrix was not computed for this character
+ * \param[in]	character	the character string
+ * \return	the name of the descriptor, or an empty string if the matrix was computed by a former version
+ */
+const crn::StringUTF8& Document::GetDistanceMethod(const crn::String &character) const
+{
+	auto it = chars_dm.find(character);
+	if (it == chars_dm.end())
+		throw crn::ExceptionNotFound{"Document::GetDistanceMethod(): "_s + _("character not found.")};
+	return it->second.method;
+}
+
+/*! Sets or replaces the distance matrix for a character. The matrix is written at the next save.
+ *
+ * A replaced matrix is written to a new file so that the former one can stay mapped while it is in use.
+ * \param[in]	character	the character string
+ * \param[in]	ids	the ids of the occurrences of the character
+ * \param[in]	dm	the distances between the occurrences
+ * \param[in]	hashes	the hashes of the zones of the occurrences (may be empty)
+ * \param[in]	method	the name of the descriptor used to compute the distances (may be empty)
+ */
+void Document::SetDistanceMatrix(const crn::String &character, std::vector<Id> ids, DistanceMatrix dm, std::vector<uint64_t> hashes, const crn::StringUTF8 &method)
+{
+	auto num = 0;
+	for (const auto &cdm : chars_dm)
+		num = crn::Max(num, cdm.second.num + 1);
+	auto desc = CharacterDistances{std::make_shared<std::pair<std::vector<Id>, DistanceMatrix>>(std::move(ids), std::move(dm)), num, true, false, std::move(hashes), method};
+	if (chars_dm.find(character) != chars_dm.end())
+		EraseDistanceMatrix(character);
+	chars_dm.emplace(character, std::move(desc));
+	dm_modified = true;
 }
 
 /*! Erases the distance matrix for a character
@@ -3148,7 +4574,26 @@ void Document::EraseDistanceMatrix(const crn::String &character)
 	auto it = chars_dm.find(character);
 	if (it == chars_dm.end())
 		throw crn::ExceptionNotFound{"Document::EraseDistanceMatrix(): "_s + _("character not found.")};
-	chars_dm.erase(it);
+	const auto fname = distanceMatrixPath(it->second.num);
+	const auto dense = denseMatrixPath(it->second.num);
+	chars_dm.erase(it); // unmaps the file unless it is being written
+	dm_modified = true;
+	if (!bgsave)
+		return;
+	bgsave->writer.Submit([fname, dense]()
+		{ // after the pending saves, that may write the file
+			try
+			{
+				if (crn::IO::Access(fname, crn::IO::EXISTS))
+					crn::IO::Rm(fname);
+				if (crn::IO::Access(dense, crn::IO::EXISTS))
+					crn::IO::Rm(dense);
+			}
+			catch (crn::Exception &ex)
+			{
+				CRNWarning("Document::EraseDistanceMatrix(): "_s + _("Cannot remove file ") + fname + ": " + ex.what());
+			}
+		});
 }
 
 struct WStream
@@ -3189,18 +4634,18 @@ void Document::ExportSpacings(const crn::Path &filename, crn::Progress *prog)
 		const auto &lines = v.GetLines();
 		for (const auto &l : lines)
 		{
-			const auto &lzone = v.GetZone(l.second.GetZone());
+			const auto &lzone = v.GetZone(l.GetZone());
 			if (!lzone.GetPosition().IsValid())
 				continue; // do not process line if it wasn't aligned
 
 			try
 			{
-				//const auto &wids = l.second.GetWords(); // in theory if the line has a bbox, all words are aligned
+				//const auto &wids = l.GetWords(); // in theory if the line has a bbox, all words are aligned
 				auto wids = std::vector<Id>{};
 				auto cids = std::vector<Id>{};
 				auto wboxes = std::vector<crn::Rect>{};
 				auto cboxes = std::vector<crn::Rect>{};
-				for (const auto &wid : l.second.GetWords())
+				for (const auto &wid : l.GetWords())
 				{ // add validated words and aligned characters
 					if (v.IsValid(wid).IsTrue())
 					{
@@ -3221,11 +4666,11 @@ void Document::ExportSpacings(const crn::Path &filename, crn::Progress *prog)
 				}
 				if (wids.empty())
 				{
-					root.PushBackComment(_("Line") + " "_s + l.first + ": "_s + _("no validated word found."));
+					root.PushBackComment(_("Line") + " "_s + l.GetId() + ": "_s + _("no validated word found."));
 					continue;
 				}
 				
-				const auto &medline = v.GetGraphicalLine(l.first);
+				const auto &medline = v.GetGraphicalLine(l.GetId());
 				const auto bx = medline.GetFront().X;
 				const auto ex = medline.GetBack().X;
 				const auto lh = medline.GetLineHeight();
@@ -3311,7 +4756,7 @@ void Document::ExportSpacings(const crn::Path &filename, crn::Progress *prog)
 				} // follow medline
 				if (streams.empty())
 				{
-					root.PushBackComment(_("Line") + " "_s + l.first + ": "_s + _("no white space found."));
+					root.PushBackComment(_("Line") + " "_s + l.GetId() + ": "_s + _("no white space found."));
 					continue;
 				}
 
@@ -3487,224 +4932,429 @@ void Document::ExportSpacings(const crn::Path &filename, crn::Progress *prog)
 	outx.Save(filename);
 }
 
-static crn::StringUTF8 allTextInElement(crn::xml::Element &el)
+/*! Names of the TEI elements and attributes of the transcriptions */
+namespace tei
 {
-	auto txt = ""_s;
-	for (auto n = el.BeginNode(); n != el.EndNode(); ++n)
-	{
-		if (n.IsText())
-		{
-			txt += n.AsText().GetValue();
-		}
-		else if (n.IsElement())
-		{
-			auto sel = n.AsElement();
-			if (sel.GetAttribute<crn::StringUTF8>("ana", true) != "ori:align-no")
-				txt += allTextInElement(sel);
-		}
-	}
-	return txt;
+	static constexpr XmlName milestone{"milestone"}, pb{"pb"}, cb{"cb"}, lb{"lb"}, w{"w"}, pc{"pc"}, seg{"seg"}, c{"c"};
+	static constexpr XmlName id{"xml:id"}, ana{"ana"}, unit{"unit"}, n{"n"}, type{"type"}, corresp{"corresp"}, rend{"rend"};
 }
 
-void Document::readTextWElements(crn::xml::Element &el, ElementPosition &pos, std::multimap<int, Id> &milestones, char lpos)
+/*! Reads the structure of the views up to word level
+ *
+ * Words that have a seg child are not words, their segs are. Since the children are not known when a word is read, it is added and then removed if a seg is found.
+ */
+void Document::readTextW(const crn::Path &fname, std::unordered_map<Id, ViewSkeleton> &skel, std::multimap<int, Id> &milestones)
 {
-	for (auto sel = el.BeginElement(); sel != el.EndElement(); ++sel)
+	struct Level
+	{
+		char lpos; // alignment of the words in the line, applies to the following siblings and their descendants
+		bool word; // a w or pc element
+		bool removable; // the word was added
+		ViewSkeleton *vs;
+		size_t word_index;
+		std::vector<Id> *line;
+		size_t line_index;
+	};
+	auto levels = std::vector<Level>{};
+	auto pos = ElementPosition{};
+	XmlReader xml{fname};
+	for (auto ev = xml.Next(); ev != XmlReader::Event::DONE; ev = xml.Next())
 	{
-		const auto elname = sel.GetName();
-		if (sel.GetAttribute<crn::StringUTF8>("ana", true) != "ori:align-no")
+		if (ev == XmlReader::Event::END)
 		{
-			const auto elid = sel.GetAttribute<Id>("xml:id", true);
-			if (elname == "milestone")
+			if (levels.empty())
+				continue;
+			if (levels.back().word && !levels.back().removable)
+				throw crn::ExceptionNotFound(name + "-w: "_s + _("word or pc without an id."));
+			levels.pop_back();
+			continue;
+		}
+		if (ev != XmlReader::Event::START)
+			continue;
+		if (levels.empty())
+		{ // root
+			levels.push_back(Level{'l', false, false, nullptr, 0, nullptr, 0});
+			continue;
+		}
+
+		auto &parent = levels.back();
+		const auto isseg = xml.IsElement(tei::seg);
+		if (parent.word && isseg)
+		{ // the parent is not a word
+			parent.word = false;
+			if (parent.removable)
 			{
-				if (sel.GetAttribute<crn::StringUTF8>("unit", true) == "surface")
-				{
-					if (elid.IsEmpty())
-						throw crn::ExceptionNotFound(name + "-w: "_s + _("milestone without an id."));
-					milestones.emplace(sel.GetAttribute<int>("n", true), elid);
-					pos.view = elid;
-				}
+				parent.vs->words.erase(parent.vs->words.begin() + parent.word_index);
+				parent.line->erase(parent.line->begin() + parent.line_index);
+				parent.removable = false;
 			}
-			else if (elname == "pb")
+		}
+		if (xml.AttributeIs(tei::ana, "ori:align-no"))
+		{
+			xml.SkipElement();
+			continue;
+		}
+
+		auto &lpos = parent.lpos;
+		auto level = Level{lpos, false, false, nullptr, 0, nullptr, 0};
+		const auto elid = Id{xml.GetAttribute(tei::id)};
+		const auto addWord = [&]()
+		{
+			auto &vs = skel[pos.view];
+			vs.words.push_back(elid);
+			auto &line = lpos == 'r' ? vs.right[pos.line] : lpos == 'c' ? vs.center[pos.line] : vs.children[pos.line];
+			line.push_back(elid);
+			level.vs = &vs;
+			level.word_index = vs.words.size() - 1;
+			level.line = &line;
+			level.line_index = line.size() - 1;
+		};
+		if (xml.IsElement(tei::milestone))
+		{
+			if (xml.AttributeIs(tei::unit, "surface"))
 			{
 				if (elid.IsEmpty())
-					throw crn::ExceptionNotFound(name + "-w: "_s + _("page without an id."));
-				view_struct[pos.view].pages.emplace(elid, Page{});
-				view_struct[pos.view].pageorder.push_back(elid);
-				pos.page = elid;
+					throw crn::ExceptionNotFound(name + "-w: "_s + _("milestone without an id."));
+				milestones.emplace(xml.GetAttribute(tei::n).ToInt(), elid);
+				pos.view = elid;
 			}
-			else if (elname == "cb")
+		}
+		else if (xml.IsElement(tei::pb))
+		{
+			if (elid.IsEmpty())
+				throw crn::ExceptionNotFound(name + "-w: "_s + _("page without an id."));
+			skel[pos.view].pages.push_back(elid);
+			pos.page = elid;
+		}
+		else if (xml.IsElement(tei::cb))
+		{
+			if (elid.IsEmpty())
+				throw crn::ExceptionNotFound(name + "-w: "_s + _("column without an id."));
+			auto &vs = skel[pos.view];
+			vs.columns.push_back(elid);
+			vs.children[pos.page].push_back(elid);
+			pos.column = elid;
+		}
+		else if (xml.IsElement(tei::lb))
+		{
+			if (elid.IsEmpty())
+				throw crn::ExceptionNotFound(name + "-w: "_s + _("line without an id."));
+			if (xml.AttributeIs(tei::type, "rejet"))
 			{
-				if (elid.IsEmpty())
-					throw crn::ExceptionNotFound(name + "-w: "_s + _("column without an id."));
-				view_struct[pos.view].columns.emplace(elid, Column{});
-				view_struct[pos.view].pages[pos.page].columns.push_back(elid);
-				pos.column = elid;
+				auto corresp = xml.GetAttribute(tei::corresp);
+				if (corresp.IsEmpty())
+					throw crn::ExceptionNotFound(name + "-w: "_s + _("line @type=\"rejet\" without @corresp."));
+				if (corresp[0] != '#')
+					throw crn::ExceptionNotFound(name + "-w: "_s + _("line @type=\"rejet\" with malformed @corresp."));
+				corresp.Crop(1);
+				if (xml.AttributeIs(tei::rend, "align(center)"))
+					lpos = 'c';
+				else // should be "align(right)"
+					lpos = 'r';
+				skel[pos.view].lines.emplace_back(corresp);
+				pos.line = Id{corresp};
 			}
-			else if (elname == "lb")
+			else
 			{
-				if (elid.IsEmpty())
-					throw crn::ExceptionNotFound(name + "-w: "_s + _("line without an id."));
-				if (sel.GetAttribute<crn::StringUTF8>("type", true) == "rejet")
-				{
-					auto corresp = sel.GetAttribute<Id>("corresp", true);
-					if (corresp.IsEmpty())
-						throw crn::ExceptionNotFound(name + "-w: "_s + _("line @type=\"rejet\" without @corresp."));
-					if (corresp[0] != '#')
-						throw crn::ExceptionNotFound(name + "-w: "_s + _("line @type=\"rejet\" with malformed @corresp."));
-					corresp.Crop(1);
-					if (sel.GetAttribute<crn::StringUTF8>("rend", true) == "align(center)")
-						lpos = 'c';
-					else // should be "align(right)"
-						lpos = 'r';
-					if (view_struct[pos.view].lines.find(corresp) == view_struct[pos.view].lines.end())
-					{
-						view_struct[pos.view].lines.emplace(corresp, Line{});
-						//view_struct[pos.view].columns[pos.column].lines.push_back(corresp);
-					}
-					pos.line = corresp;
-				}
-				else
-				{
-					if (view_struct[pos.view].lines.find(elid) == view_struct[pos.view].lines.end())
-						view_struct[pos.view].lines.emplace(elid, Line{});
-					view_struct[pos.view].columns[pos.column].lines.push_back(elid);
-					pos.line = elid;
-					lpos = 'l';
-				}
+				auto &vs = skel[pos.view];
+				vs.lines.push_back(elid);
+				vs.children[pos.column].push_back(elid);
+				pos.line = elid;
+				lpos = 'l';
 			}
-			else if ((elname == "w") || (elname == "pc"))
+			level.lpos = lpos;
+		}
+		else if (xml.IsElement(tei::w) || xml.IsElement(tei::pc))
+		{
+			level.word = true;
+			if (elid.IsNotEmpty())
 			{
-				if (!sel.GetFirstChildElement("seg"))
-				{
-					if (elid.IsEmpty())
-						throw crn::ExceptionNotFound(name + "-w: "_s + _("word or pc without an id."));
-					view_struct[pos.view].words.emplace(elid, Word{});
-					//view_struct[pos.view].words[elid].text = allTextInElement(sel);
-					switch (lpos)
-					{
-						case 'r':
-							view_struct[pos.view].lines[pos.line].right.push_back(elid);
-							break;
-						case 'c':
-							view_struct[pos.view].lines[pos.line].center.push_back(elid);
-							break;
-						default:
-							view_struct[pos.view].lines[pos.line].left.push_back(elid);
-					}
-				}
+				addWord();
+				level.removable = true;
 			}
-			else if (elname == "seg")
+		}
+		else if (isseg)
+		{
+			if (xml.AttributeIs(tei::type, "wp") || xml.AttributeIs(tei::type, "deleted"))
 			{
-				const auto type = sel.GetAttribute<crn::StringUTF8>("type", true);
-				if (type == "wp" || type == "deleted")
-				{
-					if (elid.IsEmpty())
-						throw crn::ExceptionNotFound(name + "-w: "_s + _("seg without an id."));
-					view_struct[pos.view].words.emplace(elid, Word{});
-					//view_struct[pos.view].words[elid].text = allTextInElement(sel);
-					switch (lpos)
-					{
-						case 'r':
-							view_struct[pos.view].lines[pos.line].right.push_back(elid);
-							break;
-						case 'c':
-							view_struct[pos.view].lines[pos.line].center.push_back(elid);
-							break;
-						default:
-							view_struct[pos.view].lines[pos.line].left.push_back(elid);
-					}
-				}
+				if (elid.IsEmpty())
+					throw crn::ExceptionNotFound(name + "-w: "_s + _("seg without an id."));
+				addWord();
 			}
-
-			readTextWElements(sel, pos, milestones, lpos);
 		}
+		levels.push_back(level);
 	}
 }
 
-void Document::readTextCElements(crn::xml::Element &el, ElementPosition &pos)
+/*! Reads the characters of the views
+ *
+ * Words that have a seg child are not words. Since the children are not known when a word is read, it becomes the current word and its characters are given back to the previous word if a seg is found.
+ */
+void Document::readTextC(const crn::Path &fname, std::unordered_map<Id, ViewSkeleton> &skel)
 {
-	for (auto sel = el.BeginElement(); sel != el.EndElement(); ++sel)
+	struct Level
+	{
+		bool word; // a w or pc element that has no seg child yet
+		Id id; // id of the word or character
+		Id previous_word;
+		ViewSkeleton *vs; // view of the word or character
+		bool character;
+		crn::StringUTF8 text; // text of the character
+	};
+	auto levels = std::vector<Level>{};
+	auto pos = ElementPosition{};
+	XmlReader xml{fname};
+	for (auto ev = xml.Next(); ev != XmlReader::Event::DONE; ev = xml.Next())
 	{
-		const auto elname = sel.GetName();
-		if (sel.GetAttribute<crn::StringUTF8>("ana", true) != "ori:align-no")
+		if (ev == XmlReader::Event::TEXT)
+		{
+			const auto txt = xml.GetText();
+			for (auto &l : levels)
+				if (l.character)
+					l.text += txt;
+			continue;
+		}
+		if (ev == XmlReader::Event::END)
 		{
-			const auto elid = sel.GetAttribute<Id>("xml:id", true);
-			if (elname == "milestone")
+			if (levels.empty())
+				continue;
+			auto &level = levels.back();
+			if (level.word && level.id.IsEmpty())
+				throw crn::ExceptionNotFound(name + "-c: "_s + _("word or pc without an id."));
+			if (level.character)
+				level.vs->text.emplace(level.id, level.text);
+			levels.pop_back();
+			xml.SetKeepSpaces(std::any_of(levels.begin(), levels.end(), [](const Level &l) { return l.character; }));
+			continue;
+		}
+		if (levels.empty())
+		{ // root
+			levels.push_back(Level{false, Id{}, Id{}, nullptr, false, ""_s});
+			continue;
+		}
+
+		auto &parent = levels.back();
+		const auto isseg = xml.IsElement(tei::seg);
+		if (parent.word && isseg)
+		{ // the parent is not a word
+			parent.word = false;
+			if (parent.id.IsNotEmpty())
 			{
-				if (sel.GetAttribute<crn::StringUTF8>("unit", true) == "surface")
+				auto it = parent.vs->children.find(parent.id);
+				if (it != parent.vs->children.end())
 				{
-					if (elid.IsEmpty())
-						throw crn::ExceptionNotFound(name + "-c: "_s + _("milestone without an id."));
-					pos.view = elid;
+					auto &prev = parent.vs->children[parent.previous_word];
+					prev.insert(prev.end(), it->second.begin(), it->second.end());
+					parent.vs->children.erase(it);
 				}
+				pos.word = parent.previous_word;
 			}
-			else if (elname == "pb")
-			{
-				if (elid.IsEmpty())
-					throw crn::ExceptionNotFound(name + "-c: "_s + _("page without an id."));
-				//pos.page = elid;
-			}
-			else if (elname == "cb")
-			{
-				if (elid.IsEmpty())
-					throw crn::ExceptionNotFound(name + "-c: "_s + _("column without an id."));
-				//pos.column = elid;
-			}
-			else if (elname == "lb")
+		}
+		if (xml.AttributeIs(tei::ana, "ori:align-no"))
+		{
+			xml.SkipElement();
+			continue;
+		}
+
+		auto level = Level{false, Id{}, Id{}, nullptr, false, ""_s};
+		const auto elid = Id{xml.GetAttribute(tei::id)};
+		if (xml.IsElement(tei::milestone))
+		{
+			if (xml.AttributeIs(tei::unit, "surface"))
 			{
 				if (elid.IsEmpty())
-					throw crn::ExceptionNotFound(name + "-c: "_s + _("line without an id."));
-				//pos.line = elid;
-			}
-			else if ((elname == "w") || (elname == "pc"))
-			{
-				if (!sel.GetFirstChildElement("seg"))
-				{
-					if (elid.IsEmpty())
-						throw crn::ExceptionNotFound(name + "-c: "_s + _("word or pc without an id."));
-					pos.word = elid;
-				}
-			}
-			else if (elname == "seg")
-			{
-				const auto type = sel.GetAttribute<crn::StringUTF8>("type", true);
-				if (type == "wp" || type == "deleted")
-				{
-					if (elid.IsEmpty())
-						throw crn::ExceptionNotFound(name + "-c: "_s + _("seg without an id."));
-					pos.word = elid;
-				}
+					throw crn::ExceptionNotFound(name + "-c: "_s + _("milestone without an id."));
+				pos.view = elid;
 			}
-			else if (elname == "c")
+		}
+		else if (xml.IsElement(tei::pb))
+		{
+			if (elid.IsEmpty())
+				throw crn::ExceptionNotFound(name + "-c: "_s + _("page without an id."));
+		}
+		else if (xml.IsElement(tei::cb))
+		{
+			if (elid.IsEmpty())
+				throw crn::ExceptionNotFound(name + "-c: "_s + _("column without an id."));
+		}
+		else if (xml.IsElement(tei::lb))
+		{
+			if (elid.IsEmpty())
+				throw crn::ExceptionNotFound(name + "-c: "_s + _("line without an id."));
+		}
+		else if (xml.IsElement(tei::w) || xml.IsElement(tei::pc))
+		{
+			level.word = true;
+			level.id = elid;
+			level.vs = &skel[pos.view];
+			level.previous_word = pos.word;
+			if (elid.IsNotEmpty())
+				pos.word = elid;
+		}
+		else if (isseg)
+		{
+			if (xml.AttributeIs(tei::type, "wp") || xml.AttributeIs(tei::type, "deleted"))
 			{
 				if (elid.IsEmpty())
-					throw crn::ExceptionNotFound(name + "-c: "_s + _("character without an id."));
-				view_struct[pos.view].characters.emplace(elid, Character{});
-				view_struct[pos.view].characters[elid].text = allTextInElement(sel);
-				view_struct[pos.view].words[pos.word].characters.push_back(elid);
+					throw crn::ExceptionNotFound(name + "-c: "_s + _("seg without an id."));
+				pos.word = elid;
 			}
-
-			readTextCElements(sel, pos);
 		}
+		else if (xml.IsElement(tei::c))
+		{
+			if (elid.IsEmpty())
+				throw crn::ExceptionNotFound(name + "-c: "_s + _("character without an id."));
+			auto &vs = skel[pos.view];
+			vs.characters.push_back(elid);
+			vs.children[pos.word].push_back(elid);
+			level.character = true;
+			level.id = elid;
+			level.vs = &vs;
+			xml.SetKeepSpaces(true); // the text of a character may be a space
+		}
+		levels.push_back(std::move(level));
 	}
 }
 
 View Document::getCleanView(const Id &id)
 {
-	std::lock_guard<std::mutex> flock(crn::FileShield::GetMutex("views://doc/" + id));
+	return openView(id, true);
+}
 
+/*! Gets a view, opening it if needed, and keeps it in the cache
+ * \throws	crn::ExceptionNotFound	invalid id
+ * \param[in]	id	the id of the view
+ * \param[in]	clean	shall invalid links be removed instead of reported?
+ */
+View Document::openView(const Id &id, bool clean)
+{
 	auto it = view_refs.find(id);
 	if (it == view_refs.end())
 		throw crn::ExceptionNotFound("Document::GetView(): "_s + _("Cannot find view with id ") + id);
 
 	auto v = std::shared_ptr<View::Impl>{};
-	if (it->second.expired())
+	auto evicted = std::vector<std::shared_ptr<View::Impl>>{};
 	{
-		v = std::make_shared<View::Impl>(id, view_struct[id], base, name, true); // may throw
-		it->second = v;
+		std::lock_guard<std::mutex> flock(crn::FileShield::GetMutex("views://doc/" + id));
+		v = it->second.lock(); // a single test, the view may be released by another thread
+		if (!v)
+		{
+			v = std::make_shared<View::Impl>(id, view_struct.find(id)->second, base, name, clean); // may throw
+			it->second = v;
+		}
+		cacheView(v, evicted);
+	}
+	// the evicted views are saved without holding the locks of the cache and of the requested view
+	for (auto &ev : evicted)
+	{
+		std::lock_guard<std::mutex> flock(crn::FileShield::GetMutex("views://doc/" + ev->id));
+		ev.reset(); // the view cannot be opened again before it is saved
 	}
-	else
-		v = it->second.lock();
 	return View(v);
 }
 
+/*! Keeps a view in the cache of recently used views and frees memory if the budget is exceeded.
+ * The image buffers of the least recently used views are freed first, then the views themselves are released.
+ * Views that are used outside of the cache, or being opened by another thread, are kept.
+ * \param[in]	v	the view that is used
+ * \param[out]	evicted	the views removed from the cache, that the caller must release once the cache is unlocked
+ */
+void Document::cacheView(const std::shared_ptr<View::Impl> &v, std::vector<std::shared_ptr<View::Impl>> &evicted)
+{
+	std::lock_guard<std::mutex> lock(crn::FileShield::GetMutex("views://cache/" + name));
+	auto it = std::find(view_cache.begin(), view_cache.end(), v);
+	if (it != view_cache.end())
+		view_cache.splice(view_cache.begin(), view_cache, it);
+	else
+		view_cache.push_front(v);
+
+	const auto budget = Config::GetViewCacheMemory();
+	auto total = size_t(0);
+	for (const auto &cv : view_cache)
+		total += cv->memorySize();
+	for (auto rit = view_cache.rbegin(); (total > budget) && (rit != view_cache.rend()); ++rit)
+	{
+		if ((*rit == v) || (rit->use_count() != 1))
+			continue;
+		// a view being opened by GetView is locked, it may be handed out and its image read
+		std::unique_lock<std::mutex> vlock(crn::FileShield::GetMutex("views://doc/" + (*rit)->id), std::try_to_lock);
+		if (vlock && (rit->use_count() == 1))
+		{
+			total -= (*rit)->bufferSize();
+			(*rit)->releaseBuffers();
+		}
+	}
+	for (auto cit = std::prev(view_cache.end()); (total > budget) && (cit != view_cache.begin()); )
+	{
+		auto prev = std::prev(cit);
+		if (cit->use_count() == 1)
+		{
+			total -= (*cit)->memorySize();
+			evicted.push_back(std::move(*cit));
+			view_cache.erase(cit);
+		}
+		cit = prev;
+	}
+}
+
+/*! Gathers the ids of the zones of a view */
+static void collectZoneIds(crn::xml::Element &el, std::unordered_set<Id> &ids)
+{
+	if (el.GetName() == "zone")
+		ids.insert(Id{el.GetAttribute<crn::StringUTF8>("xml:id", true)});
+	for (auto sel = el.BeginElement(); sel != el.EndElement(); ++sel)
+		collectZoneIds(sel, ids);
+}
+
+/*! Checks the links of a view without opening it. Nothing is written to disk.
+ * \throws	crn::Exception	the files of the view cannot be read or are malformed
+ * \param[in]	id	the id of the view
+ * \return	the report of invalid links
+ */
+crn::StringUTF8 Document::checkLinks(const Id &id) const
+{
+	std::lock_guard<std::mutex> flock(crn::FileShield::GetMutex("views://" + id));
+	const auto &struc = view_struct.find(id)->second;
+	auto log = ""_s;
+
+	const auto files = linkFiles(id);
+	auto zonesdoc = crn::xml::Document{files[0]};
+	auto root = zonesdoc.GetRoot();
+	auto zone_ids = std::unordered_set<Id>{};
+	collectZoneIds(root, zone_ids);
+
+	auto linksdoc = crn::xml::Document{files[1]};
+	auto el = linksdoc.GetRoot().GetFirstChildElement("text");
+	if (el)
+		el = el.GetFirstChildElement("body");
+	if (el)
+		el = el.GetFirstChildElement("ab");
+	if (!el)
+		throw crn::ExceptionNotFound(name + "_" + id + "-links.xml: " + _("no ab element."));
+	readLinks(el, id, struc,
+			[&zone_ids](const Id &zid) { return zone_ids.find(zid) != zone_ids.end(); },
+			[](const crn::StringUTF8 &, crn::xml::Element &) { },
+			[](ElementKind, size_t, const Id &) { },
+			false, log);
+
+	if (!crn::IO::Access(files[2], crn::IO::EXISTS))
+		return log; // will be created when the view is opened
+	auto ontolinksdoc = crn::xml::Document{files[2]};
+	el = ontolinksdoc.GetRoot().GetFirstChildElement("text");
+	if (el)
+		el = el.GetFirstChildElement("body");
+	if (el)
+		el = el.GetFirstChildElement("ab");
+	if (el)
+		el = el.GetFirstChildElement("linkGrp");
+	if (!el)
+		throw crn::ExceptionNotFound(name + "_" + id + "-ontolinks.xml: " + _("no linkGrp element."));
+	for (auto lel = el.GetFirstChildElement("link"); lel; lel = lel.GetNextSiblingElement("link"))
+	{
+		for (const auto &part : lel.GetAttribute<crn::StringUTF8>("target").Split(" \t"))
+			if (part.StartsWith("txt:") && !struc.Find(ElementKind::Character, Id::Find(part.SubString(4))))
+				log += id + "-ontolinks: "_s + _("target points to an unknown character: ") + part.SubString(4) + "\n";
+	}
+	return log;
+}
+
@@ -28,16 +28,26 @@
 #include <CRNGeometry/CRNPoint2DInt.h>
 #include <CRNXml/CRNXml.h>
 #include <CRNUtils/CRNProgress.h>
-#include <CRNMath/CRNSquareMatrixDouble.h>
 #include <CRNBlock.h>
 #include <OriAlignConfig.h>
+#include <OriId.h>
+#include <OriDistanceMatrix.h>
+#include <OriFeatures.h>
+#include <OriTextSignature.h>
+#include <OriThreadPool.h>
+#include <atomic>
+#include <future>
 #include <vector>
+#include <list>
 #include <unordered_map>
 
 namespace ori
 {
-	using Id = crn::StringUTF8;
-
+	/*! \brief Position of an element in the document
+	 *
+	 * The position is made of the interned handles of the ids of the view, page, column, line and word containing the element.
+	 * Equality tests are integer operations. The order is lexicographic on the ids, equal components are skipped by handle.
+	 */
 	struct ElementPosition
 	{
 		ElementPosition() = default;
@@ -52,22 +62,11 @@ namespace ori
 		ElementPosition& operator=(ElementPosition&&) = default;
 		bool operator<(const ElementPosition &other) const noexcept
 		{
-			if (view < other.view) return true;
-			else if (view == other.view)
-			{
-				if (page < other.page) return true;
-				else if (page == other.page)
-				{
-					if (column < other.column) return true;
-					else if (column == other.column)
-					{
-						if (line < other.line) return true;
-						else if (line == other.line)
-							return word < other.word;
-					}
-				}
-			}
-			return false;
+			if (view != other.view) return view < other.view;
+			if (page != other.page) return page < other.page;
+			if (column != other.column) return column < other.column;
+			if (line != other.line) return line < other.line;
+			return word < other.word;
 		}
 		bool operator==(const ElementPosition &other) const noexcept
 		{ 
@@ -77,14 +76,8 @@ namespace ori
 				(line == other.line) && 
 				(word == other.word); 
 		}
-		bool operator!=(const ElementPosition &other) const noexcept
-		{ 
-			return (view != other.view) || 
-				(page != other.page) || 
-				(column != other.column) || 
-				(line != other.line) || 
-				(word != other.word); 
-		}
+		bool operator!=(const ElementPosition &other) const noexcept { return !(*this == other); }
+		bool IsEmpty() const noexcept { return view.IsEmpty(); }
 		Id view;
 		Id page;
 		Id column;
@@ -102,6 +95,7 @@ namespace ori
 
 	class View;
 	class Document;
+	class WeightMap;
 	class Zone
 	{
 		public:
@@ -112,19 +106,43 @@ namespace ori
 			Zone& operator=(Zone&&) = default;
 			const crn::Rect& GetPosition() const noexcept;
 			const std::vector<crn::Point2DInt>& GetContour() const noexcept { return box; }
+			/*! \brief Hash of the position and contour, that changes when the zone is moved or reshaped */
+			uint64_t GetHash() const noexcept;
 
 			void SetPosition(const crn::Rect &r);
 			void SetContour(const std::vector<crn::Point2DInt> &c);
 			void Clear();
 		private:
+			void touch() noexcept { if (modified) *modified = true; }
+
 			mutable crn::Rect pos;
 			std::vector<crn::Point2DInt> box;
 			crn::xml::Element el;
+			bool *modified = nullptr; // dirty flag of the view's zones
 		
 		friend class View;
 		friend class Document;
 	};
 
+	/*! \brief A contiguous range of elements stored in a view */
+	template<typename T> class ElementRange
+	{
+		public:
+			ElementRange() noexcept:b(nullptr), e(nullptr) {}
+			ElementRange(const T *first, const T *last) noexcept:b(first), e(last) {}
+			const T* begin() const noexcept { return b; }
+			const T* end() const noexcept { return e; }
+			size_t size() const noexcept { return size_t(e - b); }
+			bool empty() const noexcept { return b == e; }
+			const T& operator[](size_t i) const noexcept { return b[i]; }
+			const T& front() const noexcept { return *b; }
+			const T& back() const noexcept { return *(e - 1); }
+		private:
+			const T *b, *e;
+	};
+	/*! \brief A contiguous range of element ids */
+	using IdRange = ElementRange<Id>;
+
 	class Character
 	{
 		public:
@@ -133,10 +151,12 @@ namespace ori
 			Character(Character&&) = default;
 			Character& operator=(const Character&) = delete;
 			Character& operator=(Character&&) = default;
+			const Id& GetId() const noexcept { return id; }
 			const crn::String& GetText() const noexcept { return text; }
 			const Id& GetZone() const noexcept { return zone; }
 
 		private:
+			Id id;
 			Id zone;
 			crn::String text;
 		
@@ -152,12 +172,15 @@ namespace ori
 			Word(Word&&) = default;
 			Word& operator=(const Word&) = delete;
 			Word& operator=(Word&&) = default;
+			const Id& GetId() const noexcept { return id; }
 			const crn::String& GetText() const noexcept { return text; }
-			const std::vector<Id>& GetCharacters() const noexcept { return characters; }
+			const IdRange& GetCharacters() const noexcept { return characters; }
 			const Id& GetZone() const noexcept { return zone; }
 
 		private:
-			std::vector<Id> characters;
+			Id id;
+			IdRange characters;
+			size_t first_character = 0; // index of the first character in the view
 			Id zone;
 			crn::String text;
 		
@@ -173,11 +196,15 @@ namespace ori
 			Line(Line&&) = default;
 			Line& operator=(const Line&) = delete;
 			Line& operator=(Line&&) = default;
-			const std::vector<Id>& GetWords() const;
+			const Id& GetId() const noexcept { return id; }
+			/*! \brief Returns the words of the line, including the rejected words at the center or right of the line */
+			const IdRange& GetWords() const noexcept { return words; }
 			const Id& GetZone() const noexcept { return zone; }
 
 		private:
-			mutable std::vector<Id> left, center, right;
+			Id id;
+			IdRange words;
+			size_t first_word = 0; // index of the first word in the view
 			Id zone;
 		
 		friend class View;
@@ -192,11 +219,14 @@ namespace ori
 			Column(Column&&) = default;
 			Column& operator=(const Column&) = delete;
 			Column& operator=(Column&&) = default;
-			const std::vector<Id>& GetLines() const noexcept { return lines; }
+			const Id& GetId() const noexcept { return id; }
+			const IdRange& GetLines() const noexcept { return lines; }
 			const Id& GetZone() const noexcept { return zone; }
 
 		private:
-			std::vector<Id> lines;
+			Id id;
+			IdRange lines;
+			size_t first_line = 0; // index of the first line in the view
 			Id zone;
 		
 		friend class View;
@@ -211,17 +241,23 @@ namespace ori
 			Page(Page&&) = default;
 			Page& operator=(const Page&) = delete;
 			Page& operator=(Page&&) = default;
-			const std::vector<Id>& GetColumns() const noexcept { return columns; }
+			const Id& GetId() const noexcept { return id; }
+			const IdRange& GetColumns() const noexcept { return columns; }
 			const Id& GetZone() const noexcept { return zone; }
 
 		private:
-			std::vector<Id> columns;
+			Id id;
+			IdRange columns;
+			size_t first_column = 0; // index of the first column in the view
 			Id zone;
 		
 		friend class View;
 		friend class Document;
 	};
 
+	/*! \brief Type of a text element */
+	enum class ElementKind { Page, Column, Line, Word, Character };
+
 	class GraphicalLine;
 	class View
 	{
@@ -234,6 +270,10 @@ namespace ori
 			~View();
 
 			void Save();
+			/*! \brief Exports the validation, median lines and line links to an XML file */
+			void ExportData(const crn::Path &fname) const;
+			/*! \brief Imports the validation, median lines and line links from an XML file */
+			void ImportData(const crn::Path &fname);
 
 			/*! \brief Full path of the image */
 			const crn::Path& GetImageName() const noexcept;
@@ -245,7 +285,10 @@ namespace ori
 			const Page& GetPage(const Id &page_id) const;
 			Page& GetPage(const Id &page_id);
 
-			const std::unordered_map<Id, Column>& GetColumns() const;
+			/*! \brief Returns all columns in order of the document */
+			const std::vector<Column>& GetColumns() const noexcept;
+			/*! \brief Returns the columns of a page */
+			ElementRange<Column> GetColumns(const Page &page) const noexcept;
 			const Column& GetColumn(const Id &col_id) const;
 			Column& GetColumn(const Id &col_id);
 			/*! \brief Returns all median lines of a column */
@@ -256,10 +299,15 @@ namespace ori
 			void RemoveGraphicalLine(const Id &col_id, size_t index);
 			/*! \brief Removes all median lines from a column */
 			void RemoveGraphicalLines(const Id &col_id);
+			/*! \brief Replaces the median lines of all columns with automatically detected ones */
+			void DetectLines();
 			/*! \brief Removes all aligned coordinates in a column */
 			void ClearAlignment(const Id &col_id);
 
-			const std::unordered_map<Id, Line>& GetLines() const;
+			/*! \brief Returns all lines in order of the document */
+			const std::vector<Line>& GetLines() const noexcept;
+			/*! \brief Returns the lines of a column */
+			ElementRange<Line> GetLines(const Column &col) const noexcept;
 			const Line& GetLine(const Id &line_id) const;
 			Line& GetLine(const Id &line_id);
 			/*! \brief Returns the median line of a text line */
@@ -269,7 +317,10 @@ namespace ori
 			/*! \brief Returns the median line's index of a text line */
 			size_t GetGraphicalLineIndex(const Id &line_id) const;
 
-			const std::unordered_map<Id, Word>& GetWords() const;
+			/*! \brief Returns all words in order of the document */
+			const std::vector<Word>& GetWords() const noexcept;
+			/*! \brief Returns the words of a line */
+			ElementRange<Word> GetWords(const Line &line) const noexcept;
 			const Word& GetWord(const Id &word_id) const;
 			Word& GetWord(const Id &word_id);
 			/*! \brief Checks if a word was validated or rejected by the user */
@@ -277,7 +328,7 @@ namespace ori
 			/*! \brief Sets if a word was validated or rejected by the user */
 			void SetValid(const Id &word_id, const crn::Prop3 &val);
 			/*! \brief Returns the alignable characters in word */
-			crn::String GetAlignableText(const Id &word_id) const;
+			const crn::String& GetAlignableText(const Id &word_id) const;
 			/*! \brief Sets a word's image signature after alignment */
 			void SetWordImageSignature(const Id &word_id, const crn::StringUTF8 &s);
 			/*! \brief Gets a word's image signature after alignment */
@@ -285,13 +336,18 @@ namespace ori
 			/*! \brief Clears alignment for characters in a word */
 			void ClearCharactersAlignment(const Id &word_id);
 
-			const std::unordered_map<Id, Character>& GetCharacters() const;
+			/*! \brief Returns all characters in order of the document */
+			const std::vector<Character>& GetCharacters() const noexcept;
+			/*! \brief Returns the characters of a word */
+			ElementRange<Character> GetCharacters(const Word &word) const noexcept;
 			const Character& GetCharacter(const Id &char_id) const;
 			Character& GetCharacter(const Id &char_id);
 			/*! \brief Returns the list of glyph Ids associated to a character */
 			const std::vector<Id>& GetClusters(const Id &char_id) const;
-			/*! \brief Returns the list of glyph Ids associated to a character */
-			std::vector<Id>& GetClusters(const Id &char_id);
+			/*! \brief Associates a glyph to a character */
+			void AddCluster(const Id &char_id, const Id &glyph_id);
+			/*! \brief Dissociates a glyph from a character */
+			void RemoveCluster(const Id &char_id, const Id &glyph_id);
 
 			const Zone& GetZone(const Id &zone_id) const;
 			Zone& GetZone(const Id &zone_id);
@@ -337,9 +393,11 @@ namespace ori
 			struct Impl;
 
 			View(const std::shared_ptr<Impl> &ptr):pimpl(ptr) { }
-			const crn::ImageGray& getWeight() const;
-			Id addZone(Id id_base, crn::xml::Element &elem);
-			void detectLines();
+			void alignRange(AlignConfig conf, size_t line, size_t first_word, size_t last_word);
+			void alignWordCharacters(AlignConfig conf, size_t line, size_t word);
+			void computeContour(Zone &zone);
+			const WeightMap& getWeight() const;
+			Id addZone(crn::StringUTF8 id_base, crn::xml::Element &elem, ElementKind kind, size_t index);
 
 			std::shared_ptr<Impl> pimpl;
 			
@@ -368,12 +426,15 @@ namespace ori
 
 		private:
 			mutable crn::xml::Element el;
+			bool *modified = nullptr; // dirty flag of the local ontology, null for the global ontology
+
+		friend class Document;
 	};
 
 	class Document
 	{
 		public:
-			Document(const crn::Path &dirpath, crn::Progress *prog = nullptr);
+			Document(const crn::Path &dirpath, crn::Progress *prog = nullptr, size_t nthreads = 0);
 			~Document();
 
 			Document(const Document&) = delete;
@@ -386,13 +447,35 @@ namespace ori
 			const crn::StringUTF8& ErrorReport() const noexcept { return report; }
 			const crn::StringUTF8& WarningReport() const noexcept { return warningreport; }
 			void TidyUp(crn::Progress *prog);
+			/*! \brief Detects the graphical lines of all views again */
+			void DetectLines(crn::Progress *prog = nullptr);
 
+			/*! \brief Writes the modified data and waits until it is written
+			 * \throws	crn::ExceptionIO	cannot write a file
+			 */
 			void Save() const;
+			/*! \brief Writes the modified data in the background
+			 *
+			 * The modified data of the document and of the open views is copied at once, then written by a background thread.
+			 * Saves are written in the order of the calls and each file is replaced atomically.
+			 * If a write fails, all the data will be written again by the next save.
+			 * \return	a future that is ready when the files are written and holds the exception if a write failed
+			 */
+			std::shared_future<void> SaveAsync() const;
+
+			/*! \brief Gets the name of the signature table of the document's script (empty for the default table) */
+			const crn::StringUTF8& GetSignatureTable() const noexcept { return sigdb_name; }
+			/*! \brief Selects the signature table of the document's script */
+			void SetSignatureTable(const crn::StringUTF8 &tname);
 
 			const ElementPosition& GetPosition(const Id &elem_id) const;
 
 			const std::vector<Id>& GetViews() const noexcept { return views; }
 			View GetView(const Id &id);
+			/*! \brief Gets the number of characters in the transcription of a view */
+			size_t CountCharacters(const Id &view_id) const;
+			/*! \brief Removes a view from the cache of recently used views, so that it is saved and freed once it is not used anymore */
+			void ReleaseView(const Id &view_id);
 
 			/*! \brief Erases image signatures in the document */
 			void ClearSignatures(crn::Progress *prog);
@@ -414,44 +497,108 @@ namespace ori
 			void ExportStats(const crn::Path &fname);
 
 			/*! \brief Returns the distance matrix for a character */
-			const std::pair<std::vector<Id>, crn::SquareMatrixDouble>& GetDistanceMatrix(const crn::String &character) const;
-			/*! \brief Sets the distance matrix for a character */
-			template<typename VectorOdIds, typename DistanceMatrix> void SetDistanceMatrix(const crn::String &character, VectorOdIds &&ids, DistanceMatrix &&dm) { chars_dm.emplace(character, std::make_pair(std::forward<VectorOdIds>(ids), std::forward<DistanceMatrix>(dm))); }
+			const std::pair<std::vector<Id>, DistanceMatrix>& GetDistanceMatrix(const crn::String &character) const;
+			/*! \brief Returns the hashes of the zones of the occurrences when the distance matrix of a character was computed (empty if unknown) */
+			const std::vector<uint64_t>& GetDistanceHashes(const crn::String &character) const;
+			/*! \brief Returns the name of the descriptor used to compute the distance matrix of a character (empty if unknown) */
+			const crn::StringUTF8& GetDistanceMethod(const crn::String &character) const;
+			/*! \brief Sets or replaces the distance matrix for a character */
+			void SetDistanceMatrix(const crn::String &character, std::vector<Id> ids, DistanceMatrix dm, std::vector<uint64_t> hashes = std::vector<uint64_t>{}, const crn::StringUTF8 &method = "");
 			/*! \brief Erases the distance matrix for a character */
 			void EraseDistanceMatrix(const crn::String &character);
 
 			/*! \brief Saves word and character spacings to an XML file */
 			void ExportSpacings(const crn::Path &filename, crn::Progress *prog = nullptr);
 
+			/*! \brief Elements of a view
+			 *
+			 * The elements are stored in dense arrays in order of the document, the children of an element are contiguous.
+			 * The ids are only used through the side tables to find the index of an element.
+			 */
 			struct ViewStructure
 			{
-				std::unordered_map<Id, Page> pages;
-				std::vector<Id> pageorder;
-				std::unordered_map<Id, Column> columns;
-				std::unordered_map<Id, Line> lines;
-				std::unordered_map<Id, Word> words;
-				std::unordered_map<Id, Character> characters;
+				std::vector<Page> pages;
+				std::vector<Column> columns;
+				std::vector<Line> lines;
+				std::vector<Word> words;
+				std::vector<Character> characters;
+				std::vector<Id> page_ids, column_ids, line_ids, word_ids, character_ids; // ids in the same order as the elements
+				std::vector<TextSignature> signatures; // signatures of the characters, in order of the characters
+				std::vector<size_t> character_signatures; // index of the first signature of each character, followed by the number of signatures
+				struct ElementRef
+				{
+					ElementKind kind;
+					size_t index;
+				};
+				std::unordered_map<Id, ElementRef> index; // id -> type and index of the element
+				/*! \brief Gets the index of an element of a given type, or nullptr */
+				const ElementRef* Find(ElementKind kind, const Id &id) const
+				{
+					auto it = index.find(id);
+					return ((it != index.end()) && (it->second.kind == kind)) ? &it->second : nullptr;
+				}
 			};
 
 		private:
-			void readTextWElements(crn::xml::Element &el, ElementPosition &pos, std::multimap<int, Id> &milestones, char lpos);
-			void readTextCElements(crn::xml::Element &el, ElementPosition &pos);
+			struct ViewSkeleton;
+			void readTextW(const crn::Path &fname, std::unordered_map<Id, ViewSkeleton> &skel, std::multimap<int, Id> &milestones);
+			void readTextC(const crn::Path &fname, std::unordered_map<Id, ViewSkeleton> &skel);
+			static void buildStructure(ViewSkeleton &skel, ViewStructure &struc);
+			static void linkStructure(ViewStructure &struc, const std::vector<size_t> &cfirst, const std::vector<size_t> &lfirst, const std::vector<size_t> &wfirst, const std::vector<size_t> &chfirst);
+			void signStructure(ViewStructure &struc) const;
+			crn::Path snapshotPath() const;
+			std::vector<crn::Path> linkFiles(const Id &id) const;
+			bool readSnapshot(std::unordered_map<Id, crn::StringUTF8> &linkwarnings);
+			std::shared_ptr<std::string> snapshotData(const crn::StringUTF8 &textreport, const std::unordered_map<Id, crn::StringUTF8> &linkwarnings) const;
 			View getCleanView(const Id &id);
+			View openView(const Id &id, bool clean);
+			void cacheView(const std::shared_ptr<View::Impl> &v, std::vector<std::shared_ptr<View::Impl>> &evicted);
+			crn::StringUTF8 checkLinks(const Id &id) const;
+			void setPosition(const Id &elem_id, const ElementPosition &pos);
 
+			Id::Scope id_scope; // first member, so that the ids are released after everything else
 			using ViewRef = std::weak_ptr<View::Impl>;
 			std::unordered_map<Id, ViewRef> view_refs; // weak references to views
 			std::vector<Id> views; // views in order of the document
 			std::unordered_map<Id, ViewStructure> view_struct;
-			std::unordered_map<Id, ElementPosition> positions;
+			std::list<std::shared_ptr<View::Impl>> view_cache; // recently used views, most recent first
+			std::unordered_map<Id, uint32_t> position_index; // element id -> index in positions
+			std::vector<ElementPosition> positions; // in document order
 			std::unordered_map<Id, Glyph> glyphs;
-			std::unordered_map<crn::String, std::pair<std::vector<Id>, crn::SquareMatrixDouble>> chars_dm;
+			/*! \brief Distance matrix of a character, mapped from its file when it is first used */
+			struct CharacterDistances
+			{
+				std::shared_ptr<std::pair<std::vector<Id>, DistanceMatrix>> dm; // shared with the background save, never modified once set
+				int num; // number of the matrix file
+				bool loaded; // the matrix is in memory or mapped
+				bool saved; // the matrix file is up to date
+				std::vector<uint64_t> hashes; // hash of the zone of each occurrence when the matrix was computed
+				crn::StringUTF8 method; // descriptor used to compute the distances
+			};
+			crn::Path distanceMatrixPath(int num) const;
+			crn::Path denseMatrixPath(int num) const;
+			mutable std::unordered_map<crn::String, CharacterDistances> chars_dm;
+			mutable bool dm_modified = false; // the list of matrices changed
 
 			crn::Path base;
+			size_t nthreads; // number of threads used to read the views (0 for the number of cores)
 			crn::StringUTF8 name;
 			crn::StringUTF8 report, warningreport;
+			mutable std::shared_ptr<std::string> pending_snapshot; // written with the first save
 			crn::xml::Document global_onto;
 			mutable crn::xml::Document local_onto;
+			std::unique_ptr<bool> onto_modified = std::make_unique<bool>(false); // allocated apart so that the glyphs keep pointing to it when the document is moved
 			std::unique_ptr<crn::xml::Element> charDecl;
+			std::shared_ptr<const TextSignatureDB> sigdb; // signatures of the document's script
+			crn::StringUTF8 sigdb_name;
+
+			/*! \brief Writer of the saves */
+			struct BackgroundSave
+			{
+				ThreadPool writer{1}; // a single thread, so that the files are written in the order of the saves
+				std::atomic<bool> failed{false}; // a write failed, everything must be written again
+			};
+			mutable std::unique_ptr<BackgroundSave> bgsave = std::make_unique<BackgroundSave>();
 	};
 
 }
@@ -120,6 +120,7 @@ GUI::GUI():
 
 	// Alignment menu
 	actions->add(Gtk::Action::create("align-clear-sig", Gtk::Stock::CLEAR, _("_Clear image signatures"), _("Clear image signatures")), sigc::mem_fun(this, &GUI::clear_sig));
+	actions->add(Gtk::Action::create("align-sig-table", Gtk::Stock::PROPERTIES, _("Signature _table"), _("Signature table")), sigc::mem_fun(this, &GUI::select_signatures));
 	actions->add(Gtk::Action::create("align-all", Gtk::StockID("gtk-crn-two-pages"), _("Align _all"), _("Align all")), sigc::mem_fun(this, &GUI::align_all));
 	actions->add(Gtk::Action::create("align-selection", Gtk::StockID("gtk-crn-block"), _("Align _selection"), _("Align selection")), sigc::mem_fun(this, &GUI::align_selection));
 
@@ -169,6 +170,7 @@ GUI::GUI():
 		"			<menuitem action='align-selection'/>"
 		"			<menuitem action='rem-lines'/>"
 		"			<menuitem action='align-clear-sig'/>"
+		"			<menuitem action='align-sig-table'/>"
 		"		</menu>"
 		"		<menu action='display-menu'>"
 		"			<menuitem action='image-zoom-in'/>"
@@ -480,6 +482,8 @@ void GUI::set_win_title()
 	Glib::ustring t(wintitle);
 	if (need_save)
 		t += " *";
+	if (!saving.empty())
+		t += _(" (saving…)");
 	if (doc)
 	{
 		t += " (";
@@ -631,7 +635,7 @@ void GUI::rem_superline(const Id &colid, size_t num)
 Glib::RefPtr<Gtk::TreeStore> GUI::fill_tree(crn::Progress *prog)
 {
 	Glib::RefPtr<Gtk::TreeStore> newstore = Gtk::TreeStore::create(columns);
-	current_view_id = "";
+	current_view_id = Id{};
 	current_view = View{};
 	if (!doc)
 		return newstore;
@@ -658,15 +662,15 @@ Glib::RefPtr<Gtk::TreeStore> GUI::fill_tree(crn::Progress *prog)
 			xnum = crn::StringUTF8(int(p.GetColumns().size())).CStr() + Glib::ustring(" ") + _("column(s)");
 			pit->set_value(columns.xml, xnum);
 
-			for (const auto &cid : p.GetColumns())
+			for (const auto &c : view.GetColumns(p))
 			{ // display column
+				const auto &cid = c.GetId();
 				auto cit = newstore->append(pit->children());
 				cit->set_value(columns.id, Glib::ustring{cid.CStr()});
 				name = _("Column");
 				name += " ";
 				name += cid.CStr();
 				cit->set_value(columns.name, name);
-				const auto &c = view.GetColumn(cid);
 				const auto xlines = c.GetLines().size();
 				xnum = crn::StringUTF8(int(xlines)).CStr() + Glib::ustring(" ") + _("line(s)");
 				cit->set_value(columns.xml, xnum);
@@ -677,22 +681,22 @@ Glib::RefPtr<Gtk::TreeStore> GUI::fill_tree(crn::Progress *prog)
 					cit->set_value(columns.error, Pango::STYLE_ITALIC);
 
 				auto ctxt = Glib::ustring("");
-				for (const auto &lid : c.GetLines())
+				for (const auto &l : view.GetLines(c))
 				{ // display line
+					const auto &lid = l.GetId();
 					auto lit = newstore->append(cit->children());
 					lit->set_value(columns.id, Glib::ustring{lid.CStr()});
 					name = _("Line");
 					name += " ";
 					name += lid.CStr();
 					lit->set_value(columns.name, name);
-					const auto &l = view.GetLine(lid);
 					xnum = crn::StringUTF8(int(l.GetWords().size())).CStr() + Glib::ustring(" ") + _("word(s)");
 					lit->set_value(columns.xml, xnum);
 
 					// get text and remove html elements
 					auto s = ""_s;
-					for (const auto &wid : l.GetWords())
-						s += view.GetWord(wid).GetText().CStr() + " "_s;
+					for (const auto &w : view.GetWords(l))
+						s += w.GetText().CStr() + " "_s;
 					auto ltxt = Glib::ustring{};
 					ltxt.reserve(s.Size() * 2);
 					for (size_t tmp = 0; tmp < s.Size(); ++tmp)
@@ -934,7 +938,7 @@ void GUI::tree_selection_changed(bool focus)
 					{
 						try
 						{
-							const auto &gl = current_view.GetGraphicalLine(linid);
+							const auto &gl = static_cast<const View&>(current_view).GetGraphicalLine(linid); // read only
 							img.focus_on((gl.GetFront().X + gl.GetBack().X) / 2, gl.GetFront().Y);
 						}
 						catch (...) { }
@@ -1013,7 +1017,7 @@ void GUI::display_line(const Id &linid)
 {
 	try
 	{
-		const auto &gl = current_view.GetGraphicalLine(linid);
+		const auto &gl = static_cast<const View&>(current_view).GetGraphicalLine(linid); // read only
 		auto pts = std::vector<crn::Point2DInt>{};
 		for (const auto &p : gl.GetMidline())
 			pts.emplace_back(int(p.X), int(p.Y));
@@ -1350,7 +1354,7 @@ void GUI::on_rmb_clicked(guint mouse_button, guint32 time, std::vector<std::pair
 			if (it->first == superlinesOverlay)
 			{ // if it is a line, pop a menu up
 				auto sit = tv.get_selection()->get_selected();
-				const auto colid = Id{sit->get_value(columns.id)};
+				const auto colid = Id{sit->get_value(columns.id).c_str()};
 				const auto linenum = size_t(it->second.ToInt());
 				superline_rem_connection.disconnect();
 				superline_rem_connection = actions->get_action("remove-superline")->signal_activate().connect(sigc::bind(sigc::mem_fun(this, &GUI::rem_superline), colid, linenum));
@@ -1469,17 +1473,54 @@ void GUI::save_project()
 {
 	if (doc)
 	{
-		current_view.Save();
-		doc->Save();
+		const auto checking = !saving.empty();
+		saving.push_back(doc->SaveAsync()); // the files are written after the former save
 		need_save = false;
 		set_win_title();
+		if (!checking)
+			Glib::signal_timeout().connect(sigc::mem_fun(this, &GUI::check_save), 100);
 	}
 }
 
+/*! Reports the end of the background saves, in order
+ * \return	true to be called again
+ */
+bool GUI::check_save()
+{
+	const auto pending = saving.size();
+	while (!saving.empty() && (saving.front().wait_for(std::chrono::seconds(0)) == std::future_status::ready))
+	{
+		try
+		{
+			saving.front().get();
+		}
+		catch (crn::Exception &ex)
+		{
+			need_save = true;
+			GtkCRN::App::show_exception(ex, false);
+		}
+		catch (std::exception &ex)
+		{
+			need_save = true;
+			GtkCRN::App::show_message(ex.what(), Gtk::MESSAGE_ERROR);
+		}
+		saving.pop_front();
+	}
+	if (saving.size() != pending)
+		set_win_title();
+	return !saving.empty();
+}
+
 void GUI::on_close()
 {
 	if (need_save)
 		save_project();
+	if (!saving.empty())
+	{ // report the errors of the background saves before quitting
+		for (auto &s : saving)
+			s.wait();
+		check_save();
+	}
 }
 
 void GUI::change_font()
@@ -1574,6 +1615,53 @@ void GUI::clear_sig()
 	}
 }
 
+/*! Selects the signature table of the script of the document */
+void GUI::select_signatures()
+{
+	if (!doc)
+		return;
+	Gtk::Dialog dial(_("Signature table"), this, true);
+	dial.add_button(Gtk::Stock::CANCEL, Gtk::RESPONSE_CANCEL);
+	dial.add_button(Gtk::Stock::OK, Gtk::RESPONSE_ACCEPT);
+	std::vector<int> altbut;
+	altbut.push_back(Gtk::RESPONSE_ACCEPT);
+	altbut.push_back(Gtk::RESPONSE_CANCEL);
+	dial.set_alternative_button_order_from_array(altbut);
+	dial.set_default_response(Gtk::RESPONSE_ACCEPT);
+	Gtk::HBox hbox;
+	dial.get_vbox()->pack_start(hbox, false, true, 4);
+	hbox.pack_start(*Gtk::manage(new Gtk::Label(_("Table"))), false, true, 4);
+	Gtk::ComboBoxText tables;
+	tables.append_text(_("Default"));
+	tables.set_active(0);
+	const auto names = TextSignatureDB::GetNames();
+	for (auto tmp = size_t(0); tmp < names.size(); ++tmp)
+	{
+		tables.append_text(names[tmp].CStr());
+		if (names[tmp] == doc->GetSignatureTable())
+			tables.set_active(int(tmp + 1));
+	}
+	hbox.pack_start(tables, true, true, 4);
+	dial.get_vbox()->show_all_children();
+
+	if (dial.run() == Gtk::RESPONSE_ACCEPT)
+	{
+		dial.hide();
+		const auto sel = tables.get_active_row_number();
+		const auto name = sel > 0 ? names[size_t(sel - 1)] : crn::StringUTF8{};
+		if (name == doc->GetSignatureTable())
+			return;
+		try
+		{
+			doc->SetSignatureTable(name);
+		}
+		catch (crn::Exception &ex)
+		{
+			GtkCRN::App::show_exception(ex, false);
+		}
+	}
+}
+
 void GUI::propagate_validation()
 {
 	GtkCRN::ProgressWindow pwin(_("Propagating validation…"), this, true);
@@ -1596,11 +1684,11 @@ void GUI::display_search(Gtk::Entry *entry, ori::ValidationPanel *panel)
 			auto pb = GdkCRN::PixbufFromFile(view.GetImageName());
 			for (const auto &w : view.GetWords())
 			{ // for each character
-				const auto &wzone = view.GetZone(w.second.GetZone());
+				const auto &wzone = view.GetZone(w.GetZone());
 				if (!wzone.GetPosition().IsValid())
 					continue;
 				// look for searched string
-				const auto &text = view.GetAlignableText(w.first);//w.second.GetText();
+				const auto &text = view.GetAlignableText(w.GetId());//w.GetText();
 				auto pos = text.Find(str);
 				while (pos != text.NPos())
 				{ // found
@@ -1616,21 +1704,21 @@ void GUI::display_search(Gtk::Entry *entry, ori::ValidationPanel *panel)
 					const auto str0 = text.SubString(0, pos + 1);
 					auto cpos0 = size_t(0);
 					auto tstr = U""_s;
-					for (; cpos0 < w.second.GetCharacters().size(); ++cpos0)
+					for (; cpos0 < w.GetCharacters().size(); ++cpos0)
 					{
-						tstr += view.GetCharacter(w.second.GetCharacters()[cpos0]).GetText();
+						tstr += view.GetCharacter(w.GetCharacters()[cpos0]).GetText();
 						if (tstr.Size() > str0.Size())
 							tstr.Crop(0, str0.Size());
 						if (tstr == str0)
 							break;
 					}
-					if (cpos0 >= w.second.GetCharacters().size())
-						cpos0 = w.second.GetCharacters().size() - 1;
-					const auto &fczone = view.GetZone(view.GetCharacter(w.second.GetCharacters()[cpos0]).GetZone());
+					if (cpos0 >= w.GetCharacters().size())
+						cpos0 = w.GetCharacters().size() - 1;
+					const auto &fczone = view.GetZone(view.GetCharacter(w.GetCharacters()[cpos0]).GetZone());
 					if (!fczone.GetPosition().IsValid())
 						continue;
-					const auto cpos1 = crn::Min(cpos0 + str.Size() - 1, w.second.GetCharacters().size() - 1);
-					const auto &bczone = view.GetZone(view.GetCharacter(w.second.GetCharacters()[cpos1]).GetZone());
+					const auto cpos1 = crn::Min(cpos0 + str.Size() - 1, w.GetCharacters().size() - 1);
+					const auto &bczone = view.GetZone(view.GetCharacter(w.GetCharacters()[cpos1]).GetZone());
 					if (!bczone.GetPosition().IsValid())
 						continue;
 					// retrieve frontiers
@@ -1755,15 +1843,15 @@ void GUI::display_search(Gtk::Entry *entry, ori::ValidationPanel *panel)
 						tippixs[(xx + dx) * tipchannels + (j + dy) * tiprowstrides + 2] = 0;
 					}
 
-					if (view.IsValid(w.first).IsFalse())
+					if (view.IsValid(w.GetId()).IsFalse())
 					{
 						// add to reject list
-						panel->add_element(doc->GetPosition(w.first), panel->label_ko, wpb, tippb, w.second.GetCharacters()[cpos0]);
+						panel->add_element(doc->GetPosition(w.GetId()), panel->label_ko, wpb, tippb, w.GetCharacters()[cpos0]);
 					}
-					else if (view.IsValid(w.first).IsTrue())
-						panel->add_element(doc->GetPosition(w.first), panel->label_ok, wpb, tippb, w.second.GetCharacters()[cpos0]);
+					else if (view.IsValid(w.GetId()).IsTrue())
+						panel->add_element(doc->GetPosition(w.GetId()), panel->label_ok, wpb, tippb, w.GetCharacters()[cpos0]);
 					else
-						panel->add_element(doc->GetPosition(w.first), panel->label_unknown, wpb, tippb, w.second.GetCharacters()[cpos0]);
+						panel->add_element(doc->GetPosition(w.GetId()), panel->label_unknown, wpb, tippb, w.GetCharacters()[cpos0]);
 
 				}
 			}
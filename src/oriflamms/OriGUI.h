@@ -30,6 +30,7 @@
 #include <OriValidation.h>
 #include <CRNUtils/CRNOption.h>
 #include <OriAlignDialog.h>
+#include <deque>
 
 namespace ori
 {
@@ -61,6 +62,7 @@ namespace ori
 			void validate();
 			void set_need_save();
 			void save_project();
+			bool check_save();
 			void on_close();
 			void change_font();
 			void set_font();
@@ -71,6 +73,7 @@ namespace ori
 			void display_characters(const Id &linid);
 			void display_update_word(const Id &wordid, const crn::Option<int> &newleft = crn::Option<int>(), const crn::Option<int> &newright = crn::Option<int>());
 			void clear_sig();
+			void select_signatures();
 			void show_chars();
 			void go_to();
 			void export_spaces();
@@ -107,6 +110,7 @@ namespace ori
 
 			std::unique_ptr<Document> doc;
 			bool need_save;
+			std::deque<std::shared_future<void>> saving; // background saves in progress, oldest first
 
 			static const Glib::ustring wintitle;
 			static const crn::String linesOverlay;
@@ -0,0 +1,200 @@
+/*! Copyright 2013-2016 A2IA, CNRS, École Nationale des Chartes, ENS Lyon, INSA Lyon, Université Paris Descartes, Université de Poitiers
+ *
+ * This file is part of Oriflamms.
+ *
+ * Oriflamms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oriflamms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Oriflamms.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \file OriIO.cpp
+ */
+
+#include <OriIO.h>
+#include <CRNException.h>
+#include <CRNi18n.h>
+#include <fstream>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#	include <windows.h>
+#else
+#	include <sys/mman.h>
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <cstdio>
+#endif
+
+using namespace ori;
+using namespace crn::literals;
+
+MappedFile::MappedFile(const crn::Path &fname, Mode m, size_t s)
+{
+	const auto rw = m == Mode::READWRITE;
+#ifdef _WIN32
+	file = CreateFileA(fname.CStr(), rw ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ, FILE_SHARE_READ, nullptr, rw ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		file = nullptr;
+		throw crn::ExceptionIO("MappedFile::MappedFile(): "_s + _("Cannot open file: ") + fname);
+	}
+	auto fsize = LARGE_INTEGER{};
+	GetFileSizeEx(file, &fsize);
+	size = rw && s ? s : size_t(fsize.QuadPart);
+	if (!size)
+	{
+		Close();
+		throw crn::ExceptionIO("MappedFile::MappedFile(): "_s + _("Cannot map an empty file: ") + fname);
+	}
+	auto msize = LARGE_INTEGER{};
+	msize.QuadPart = LONGLONG(size);
+	mapping = CreateFileMappingA(file, nullptr, rw ? PAGE_READWRITE : PAGE_READONLY, msize.HighPart, msize.LowPart, nullptr);
+	if (mapping)
+		data = reinterpret_cast<uint8_t*>(MapViewOfFile(mapping, rw ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size));
+	if (!data)
+	{
+		Close();
+		throw crn::ExceptionIO("MappedFile::MappedFile(): "_s + _("Cannot map file: ") + fname);
+	}
+#else
+	fd = open(fname.CStr(), rw ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+	if (fd == -1)
+		throw crn::ExceptionIO("MappedFile::MappedFile(): "_s + _("Cannot open file: ") + fname);
+	struct stat st;
+	if (fstat(fd, &st))
+	{
+		Close();
+		throw crn::ExceptionIO("MappedFile::MappedFile(): "_s + _("Cannot read file size: ") + fname);
+	}
+	size = size_t(st.st_size);
+	if (rw && s && (s != size))
+	{
+		if (ftruncate(fd, off_t(s)))
+		{
+			Close();
+			throw crn::ExceptionIO("MappedFile::MappedFile(): "_s + _("Cannot resize file: ") + fname);
+		}
+		size = s;
+	}
+	if (!size)
+	{
+		Close();
+		throw crn::ExceptionIO("MappedFile::MappedFile(): "_s + _("Cannot map an empty file: ") + fname);
+	}
+	auto ptr = mmap(nullptr, size, rw ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+	if (ptr == MAP_FAILED)
+	{
+		Close();
+		throw crn::ExceptionIO("MappedFile::MappedFile(): "_s + _("Cannot map file: ") + fname);
+	}
+	data = reinterpret_cast<uint8_t*>(ptr);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile &&other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		std::swap(data, other.data);
+		std::swap(size, other.size);
+#ifdef _WIN32
+		std::swap(file, other.file);
+		std::swap(mapping, other.mapping);
+#else
+		std::swap(fd, other.fd);
+#endif
+	}
+	return *this;
+}
+
+void MappedFile::Flush()
+{
+	if (!data)
+		return;
+#ifdef _WIN32
+	FlushViewOfFile(data, size);
+#else
+	msync(data, size, MS_SYNC);
+#endif
+}
+
+void MappedFile::Close() noexcept
+{
+#ifdef _WIN32
+	if (data)
+		UnmapViewOfFile(data);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file)
+		CloseHandle(file);
+	mapping = nullptr;
+	file = nullptr;
+#else
+	if (data)
+		munmap(data, size);
+	if (fd != -1)
+		close(fd);
+	fd = -1;
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+void ori::ReplaceFileAtomically(const crn::Path &src, const crn::Path &dst)
+{
+#ifdef _WIN32
+	if (!MoveFileExA(src.CStr(), dst.CStr(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+#else
+	if (rename(src.CStr(), dst.CStr()))
+#endif
+		throw crn::ExceptionIO("ReplaceFileAtomically(): "_s + _("Cannot replace file: ") + dst);
+}
+
+void ori::WriteFileAtomically(const crn::Path &fname, const void *data, size_t size)
+{
+	const auto tmpname = fname + ".tmp";
+	std::ofstream f;
+	f.open(tmpname.CStr(), std::ios::out | std::ios::binary | std::ios::trunc);
+	f.write(reinterpret_cast<const char*>(data), std::streamsize(size));
+	f.close();
+	if (!f)
+		throw crn::ExceptionIO("WriteFileAtomically(): "_s + _("Cannot write file: ") + tmpname);
+	ReplaceFileAtomically(tmpname, fname);
+}
+
+FileStamp ori::GetFileStamp(const crn::Path &fname) noexcept
+{
+	auto stamp = FileStamp{};
+#ifdef _WIN32
+	struct _stat64 st;
+	if (!_stat64(fname.CStr(), &st))
+#else
+	struct stat st;
+	if (!stat(fname.CStr(), &st))
+#endif
+	{
+		stamp.size = uint64_t(st.st_size);
+		stamp.mtime = int64_t(st.st_mtime);
+	}
+	return stamp;
+}
+
@@ -0,0 +1,107 @@
+/*! Copyright 2013-2016 A2IA, CNRS, École Nationale des Chartes, ENS Lyon, INSA Lyon, Université Paris Descartes, Université de Poitiers
+ *
+ * This file is part of Oriflamms.
+ *
+ * Oriflamms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oriflamms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Oriflamms.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \file OriIO.h
+ */
+
+#ifndef OriIO_HEADER
+#define OriIO_HEADER
+
+#include <oriflamms_config.h>
+#include <CRNIO/CRNPath.h>
+#include <cstdint>
+
+namespace ori
+{
+	/*! \brief A file mapped in memory
+	 *
+	 * The whole file is mapped. In read-write mode, the file is created or resized if needed and modifications are written back to the disk.
+	 */
+	class MappedFile
+	{
+		public:
+			enum class Mode { READ, READWRITE };
+
+			/*! \brief Creates an empty mapping */
+			MappedFile() noexcept {}
+			/*! \brief Maps a file
+			 * \throws	crn::ExceptionIO	cannot open or map the file
+			 * \param[in]	fname	the path to the file
+			 * \param[in]	m	the access mode
+			 * \param[in]	size	in read-write mode, the size of the file (0 to keep the current size)
+			 */
+			MappedFile(const crn::Path &fname, Mode m = Mode::READ, size_t size = 0);
+			~MappedFile();
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+			MappedFile(MappedFile &&other) noexcept;
+			MappedFile& operator=(MappedFile &&other) noexcept;
+
+			/*! \brief Is a file mapped? */
+			bool IsOpen() const noexcept { return data != nullptr; }
+			/*! \brief Gets the size of the mapping */
+			size_t GetSize() const noexcept { return size; }
+			/*! \brief Gets a pointer to the mapped data */
+			const uint8_t* GetData() const noexcept { return data; }
+			/*! \brief Gets a pointer to the mapped data (read-write mode only) */
+			uint8_t* GetData() noexcept { return data; }
+			/*! \brief Writes the modified pages back to the disk */
+			void Flush();
+			/*! \brief Unmaps the file */
+			void Close() noexcept;
+
+		private:
+			uint8_t *data = nullptr;
+			size_t size = 0;
+#ifdef _WIN32
+			void *file = nullptr;
+			void *mapping = nullptr;
+#else
+			int fd = -1;
+#endif
+	};
+
+	/*! \brief Atomically replaces a file by another one
+	 * \throws	crn::ExceptionIO	cannot rename the file
+	 * \param[in]	src	the new file, that will be removed
+	 * \param[in]	dst	the file to replace
+	 */
+	void ReplaceFileAtomically(const crn::Path &src, const crn::Path &dst);
+
+	/*! \brief Writes a file through a temporary file that then replaces it
+	 * \throws	crn::ExceptionIO	cannot write the file
+	 * \param[in]	fname	the file to write
+	 * \param[in]	data	the content of the file
+	 * \param[in]	size	the size of the content
+	 */
+	void WriteFileAtomically(const crn::Path &fname, const void *data, size_t size);
+
+	/*! \brief Size and modification time of a file, used to detect changes */
+	struct FileStamp
+	{
+		uint64_t size = 0;
+		int64_t mtime = 0;
+		bool operator==(const FileStamp &other) const noexcept { return (size == other.size) && (mtime == other.mtime); }
+		bool operator!=(const FileStamp &other) const noexcept { return !(*this == other); }
+	};
+	/*! \brief Gets the size and modification time of a file
+	 * \return	an empty stamp if the file does not exist
+	 */
+	FileStamp GetFileStamp(const crn::Path &fname) noexcept;
+}
+
+#endif
@@ -0,0 +1,222 @@
+/*! Copyright 2013-2016 A2IA, CNRS, École Nationale des Chartes, ENS Lyon, INSA Lyon, Université Paris Descartes, Université de Poitiers
+ *
+ * This file is part of Oriflamms.
+ *
+ * Oriflamms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oriflamms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Oriflamms.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \file OriId.cpp
+ */
+
+#include <OriId.h>
+#include <CRNException.h>
+#include <CRNi18n.h>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+using namespace ori;
+using namespace crn::literals;
+
+namespace
+{
+	/*! \brief Hash of a C string */
+	struct CStrHash
+	{
+		size_t operator()(const char *s) const noexcept
+		{ // FNV-1a
+			auto h = size_t(2166136261u);
+			for (; *s; ++s)
+				h = (h ^ size_t(uint8_t(*s))) * size_t(16777619u);
+			return h;
+		}
+	};
+	struct CStrEqual
+	{
+		bool operator()(const char *s1, const char *s2) const noexcept { return !strcmp(s1, s2); }
+	};
+
+	/*! \brief The table of interned strings
+	 *
+	 * Strings are stored in fixed-size chunks that are never moved, so that reading a string needs no lock.
+	 * Chunks are reached through a two-level directory, so that only the directories in use are allocated.
+	 * The index points to the stored strings, so each string is stored only once.
+	 */
+	class IdTable
+	{
+		public:
+			static IdTable& Get()
+			{
+				static IdTable table;
+				return table;
+			}
+
+			uint32_t Lookup(const char *s)
+			{
+				if (!*s)
+					return 0;
+				std::lock_guard<std::mutex> lock(mutex);
+				auto it = index.find(s);
+				return it != index.end() ? it->second : 0;
+			}
+			uint32_t Intern(const char *s)
+			{
+				if (!*s)
+					return 0;
+				std::lock_guard<std::mutex> lock(mutex);
+				auto it = index.find(s);
+				if (it != index.end())
+					return it->second;
+				const auto h = uint32_t(count.load(std::memory_order_relaxed));
+				if (h >= CHUNK_SIZE * DIR_SIZE * MAX_DIRS)
+					throw crn::ExceptionDomain("Id::Id(): "_s + _("too many identifiers."));
+				if (!(h % CHUNK_SIZE))
+					allocChunk(h / CHUNK_SIZE);
+				auto &str = chunk(h / CHUNK_SIZE, std::memory_order_relaxed)[h % CHUNK_SIZE];
+				str = s;
+				index.emplace(str.CStr(), h);
+				count.store(h + 1, std::memory_order_release);
+				return h;
+			}
+
+			const crn::StringUTF8& Str(uint32_t h) const noexcept
+			{
+				if (h >= count.load(std::memory_order_acquire))
+					return chunk(0, std::memory_order_acquire)[0]; // released with the last Scope
+				return chunk(h / CHUNK_SIZE, std::memory_order_acquire)[h % CHUNK_SIZE];
+			}
+
+			size_t Count() const noexcept { return count.load(std::memory_order_acquire); }
+
+			void Acquire()
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				scopes += 1;
+			}
+			/*! \brief Releases all strings when the last scope is gone */
+			void Release()
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (--scopes)
+					return;
+				index.clear();
+				count.store(1, std::memory_order_release);
+				for (auto &d : dirs)
+				{
+					freeDir(d.load(std::memory_order_relaxed));
+					d.store(nullptr, std::memory_order_relaxed);
+				}
+				allocChunk(0); // handle 0 is the empty string
+			}
+
+		private:
+			IdTable():count(1)
+			{
+				for (auto &d : dirs)
+					d.store(nullptr, std::memory_order_relaxed);
+				allocChunk(0); // handle 0 is the empty string
+			}
+			~IdTable()
+			{
+				for (auto &d : dirs)
+					freeDir(d.load());
+			}
+			static void freeDir(std::atomic<crn::StringUTF8*> *dir) noexcept
+			{
+				if (!dir)
+					return;
+				for (auto c = size_t(0); c < DIR_SIZE; ++c)
+					delete [] dir[c].load();
+				delete [] dir;
+			}
+			/*! \brief Gets a chunk (the caller knows it exists) */
+			crn::StringUTF8* chunk(size_t c, std::memory_order order) const noexcept
+			{
+				return dirs[c / DIR_SIZE].load(order)[c % DIR_SIZE].load(order);
+			}
+			/*! \brief Allocates a chunk (under lock) */
+			void allocChunk(size_t c)
+			{
+				auto &d = dirs[c / DIR_SIZE];
+				auto dir = d.load(std::memory_order_relaxed);
+				if (!dir)
+				{
+					dir = new std::atomic<crn::StringUTF8*>[DIR_SIZE];
+					for (auto i = size_t(0); i < DIR_SIZE; ++i)
+						dir[i].store(nullptr, std::memory_order_relaxed);
+					d.store(dir, std::memory_order_release);
+				}
+				dir[c % DIR_SIZE].store(new crn::StringUTF8[CHUNK_SIZE], std::memory_order_release);
+			}
+
+			static constexpr size_t CHUNK_SIZE = 4096;
+			static constexpr size_t DIR_SIZE = 256;
+			static constexpr size_t MAX_DIRS = 256;
+			std::atomic<std::atomic<crn::StringUTF8*>*> dirs[MAX_DIRS]; // directories are allocated on demand, 2 KB are reserved
+			std::atomic<size_t> count;
+			std::unordered_map<const char*, uint32_t, CStrHash, CStrEqual> index;
+			std::mutex mutex;
+			size_t scopes = 0; // number of Scope objects alive
+	};
+	constexpr size_t IdTable::CHUNK_SIZE;
+	constexpr size_t IdTable::DIR_SIZE;
+	constexpr size_t IdTable::MAX_DIRS;
+}
+
+Id::Id(const crn::StringUTF8 &s):
+	handle(IdTable::Get().Intern(s.CStr()))
+{ }
+
+Id::Id(const char *s):
+	handle(IdTable::Get().Intern(s))
+{ }
+
+/*! Gets the id of a string that was already interned. Unlike the constructors, this does not add the string to the table.
+ * \param[in]	s	a string
+ * \return	the id of the string or an empty id if it was never interned
+ */
+Id Id::Find(const crn::StringUTF8 &s)
+{
+	return FromHandle(IdTable::Get().Lookup(s.CStr()));
+}
+
+Id Id::Find(const char *s)
+{
+	return FromHandle(IdTable::Get().Lookup(s));
+}
+
+const crn::StringUTF8& Id::Str() const noexcept
+{
+	return IdTable::Get().Str(handle);
+}
+
+size_t Id::Count() noexcept
+{
+	return IdTable::Get().Count();
+}
+
+Id::Scope::Scope()
+{
+	IdTable::Get().Acquire();
+}
+
+Id::Scope::Scope(const Scope&)
+{
+	IdTable::Get().Acquire();
+}
+
+Id::Scope::~Scope()
+{
+	IdTable::Get().Release();
+}
@@ -0,0 +1,123 @@
+/*! Copyright 2013-2016 A2IA, CNRS, École Nationale des Chartes, ENS Lyon, INSA Lyon, Université Paris Descartes, Université de Poitiers
+ *
+ * This file is part of Oriflamms.
+ *
+ * Oriflamms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oriflamms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Oriflamms.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \file OriId.h
+ */
+
+#ifndef OriId_HEADER
+#define OriId_HEADER
+
+#include <oriflamms_config.h>
+#include <CRNStringUTF8.h>
+#include <CRNString.h>
+#include <iostream>
+#include <type_traits>
+
+namespace ori
+{
+	/*! \brief Interned identifier
+	 *
+	 * An Id is a 32 bits handle on a string stored once in a global table.
+	 * Hashing and equality tests are integer operations, the string is only needed at the XML boundaries.
+	 * Handles are dense, the empty string has handle 0.
+	 * Ids can be created concurrently.
+	 * Interning is explicit: use Find() to look a string up without growing the table.
+	 *
+	 * The table lives as long as a Scope does: when the last Scope is destroyed, all strings are released and handles start over.
+	 * Objects that keep ids (documents, views…) hold a Scope, an Id must not be used after the Scopes that were alive when it was created.
+	 */
+	class Id
+	{
+		public:
+			/*! \brief Creates an empty id */
+			Id() noexcept:handle(0) {}
+			/*! \brief Interns a string */
+			explicit Id(const crn::StringUTF8 &s);
+			/*! \brief Interns a string */
+			explicit Id(const char *s);
+			/*! \brief Interns a string */
+			explicit Id(const std::string &s):Id(s.c_str()) {}
+
+			/*! \brief Gets the interned string */
+			const crn::StringUTF8& Str() const noexcept;
+			operator const crn::StringUTF8&() const noexcept { return Str(); }
+			const char* CStr() const noexcept { return Str().CStr(); }
+			size_t Size() const noexcept { return Str().Size(); }
+			bool IsEmpty() const noexcept { return handle == 0; }
+			bool IsNotEmpty() const noexcept { return handle != 0; }
+
+			/*! \brief Appends a suffix (creates a new id) */
+			Id& operator+=(const crn::StringUTF8 &s) { return *this = Id{Str() + s}; }
+			void Swap(Id &other) noexcept { std::swap(handle, other.handle); }
+
+			/*! \brief Gets the handle of the id */
+			uint32_t GetHandle() const noexcept { return handle; }
+			/*! \brief Gets an id from its handle (no checking) */
+			static Id FromHandle(uint32_t h) noexcept { auto id = Id{}; id.handle = h; return id; }
+			/*! \brief Gets the id of an already interned string (does not intern) */
+			static Id Find(const crn::StringUTF8 &s);
+			/*! \brief Gets the id of an already interned string (does not intern) */
+			static Id Find(const char *s);
+			/*! \brief Number of interned ids (all handles are lower than this value) */
+			static size_t Count() noexcept;
+
+			/*! \brief Keeps the interned strings alive */
+			class Scope
+			{
+				public:
+					Scope();
+					Scope(const Scope&);
+					~Scope();
+					Scope& operator=(const Scope&) noexcept { return *this; }
+			};
+
+		private:
+			uint32_t handle;
+	};
+
+	inline bool operator==(const Id &id1, const Id &id2) noexcept { return id1.GetHandle() == id2.GetHandle(); }
+	inline bool operator!=(const Id &id1, const Id &id2) noexcept { return id1.GetHandle() != id2.GetHandle(); }
+	/* Mixed operators are templates so that no implicit conversion to Id is involved. */
+	template<typename T> using IfId = typename std::enable_if<std::is_same<T, Id>::value, int>::type;
+	template<typename T, IfId<T> = 0> inline bool operator==(const T &id, const crn::StringUTF8 &s) { return id.Str() == s; }
+	template<typename T, IfId<T> = 0> inline bool operator!=(const T &id, const crn::StringUTF8 &s) { return id.Str() != s; }
+	template<typename T, IfId<T> = 0> inline bool operator==(const crn::StringUTF8 &s, const T &id) { return id.Str() == s; }
+	template<typename T, IfId<T> = 0> inline bool operator!=(const crn::StringUTF8 &s, const T &id) { return id.Str() != s; }
+	template<typename T, IfId<T> = 0> inline bool operator==(const T &id, const char *s) { return id.Str() == s; }
+	template<typename T, IfId<T> = 0> inline bool operator!=(const T &id, const char *s) { return id.Str() != s; }
+	inline crn::StringUTF8 operator+(const Id &id1, const Id &id2) { return id1.Str() + id2.Str(); }
+	template<typename T, IfId<T> = 0> inline crn::StringUTF8 operator+(const T &id, const crn::StringUTF8 &s) { return id.Str() + s; }
+	template<typename T, IfId<T> = 0> inline crn::StringUTF8 operator+(const crn::StringUTF8 &s, const T &id) { return s + id.Str(); }
+	template<typename T, IfId<T> = 0> inline crn::StringUTF8 operator+(const T &id, const char *s) { return id.Str() + s; }
+	template<typename T, IfId<T> = 0> inline crn::StringUTF8 operator+(const char *s, const T &id) { return s + id.Str(); }
+	template<typename T, IfId<T> = 0> inline crn::String operator+(const T &id, const crn::String &s) { return crn::String{id.Str()} + s; }
+	template<typename T, IfId<T> = 0> inline crn::String operator+(const crn::String &s, const T &id) { return s + crn::String{id.Str()}; }
+	/*! \brief Lexicographic order (for display) */
+	inline bool operator<(const Id &id1, const Id &id2) { return id1.Str() < id2.Str(); }
+	inline std::ostream& operator<<(std::ostream &out, const Id &id) { return out << id.CStr(); }
+}
+
+namespace std
+{
+	template<> struct hash<ori::Id>
+	{
+		inline size_t operator()(const ori::Id &id) const noexcept { return id.GetHandle(); }
+	};
+}
+
+#endif
+
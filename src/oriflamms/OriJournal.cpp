@@ -0,0 +1,296 @@
+/*! Copyright 2013-2016 A2IA, CNRS, École Nationale des Chartes, ENS Lyon, INSA Lyon, Université Paris Descartes, Université de Poitiers
+ *
+ * This file is part of Oriflamms.
+ *
+ * Oriflamms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oriflamms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Oriflamms.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \file OriJournal.cpp
+ */
+
+#include <OriJournal.h>
+#include <OriIO.h>
+#include <CRNException.h>
+#include <CRNi18n.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#ifdef _WIN32
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <unistd.h>
+#endif
+
+using namespace ori;
+using namespace crn::literals;
+
+static const char JOURNALMAGIC[8] = { 'O', 'R', 'I', 'J', 'N', 'L', '0', '2' };
+/*! Beginning of the file */
+struct JournalHeader
+{
+	char magic[8];
+	uint32_t base; // number of the last discarded record
+	uint32_t reserved;
+};
+
+Journal::Journal(const crn::Path &fname):
+	filename(fname)
+{
+	auto hbase = uint32_t(0);
+	auto end = size_t(0);
+	const auto entries = readAll(hbase, end);
+	base = hbase;
+	last = entries.empty() ? base : entries.back().header.num;
+}
+
+Journal::~Journal()
+{
+	close();
+}
+
+uint32_t Journal::Append(Record type, const std::string &payload)
+{
+	return Append(std::vector<std::pair<Record, std::string>>{std::make_pair(type, payload)});
+}
+
+uint32_t Journal::Append(const std::vector<std::pair<Record, std::string>> &records)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (records.empty())
+		return last;
+	if (!isOpen())
+	{
+		auto hbase = uint32_t(0);
+		auto end = size_t(0);
+		const auto entries = readAll(hbase, end);
+		if (!end || (end != GetFileStamp(filename).size))
+			rewrite(base, entries); // new file, or the last record was not completely written
+		open();
+	}
+	auto buf = std::string{};
+	auto num = last;
+	for (const auto &rec : records)
+	{
+		auto h = RecordHeader{uint32_t(rec.second.size()), uint32_t(rec.first), ++num, 0};
+		h.checksum = checksum(h, rec.second);
+		buf.append(reinterpret_cast<const char*>(&h), sizeof(h));
+		buf += rec.second;
+	}
+	write(buf.data(), buf.size()); // a single write so that records are never interleaved
+	sync();
+	last = num;
+	return last;
+}
+
+uint32_t Journal::GetLastNumber() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return last;
+}
+
+void Journal::Replay(uint32_t after, const std::function<void(Record, const std::string&)> &fun) const
+{
+	auto entries = std::vector<Entry>{};
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto hbase = uint32_t(0);
+		auto end = size_t(0);
+		entries = readAll(hbase, end);
+	}
+	for (const auto &e : entries)
+		if (e.header.num > after)
+			fun(Record(e.header.type), e.payload);
+}
+
+void Journal::Discard(uint32_t upto)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (upto <= base)
+		return;
+	auto hbase = uint32_t(0);
+	auto end = size_t(0);
+	auto entries = readAll(hbase, end);
+	entries.erase(std::remove_if(entries.begin(), entries.end(), [upto](const Entry &e) { return e.header.num <= upto; }), entries.end());
+	close();
+	rewrite(upto, entries);
+	base = upto;
+	open();
+}
+
+/*! Reads the valid records
+ * \param[out]	hbase	number of the last discarded record
+ * \param[out]	end	size of the valid part of the file (0 if the file does not exist or is not a journal)
+ */
+std::vector<Journal::Entry> Journal::readAll(uint32_t &hbase, size_t &end) const
+{
+	auto entries = std::vector<Entry>{};
+	hbase = 0;
+	end = 0;
+	std::ifstream f(filename.CStr(), std::ios::in | std::ios::binary);
+	auto jh = JournalHeader{};
+	if (!f.read(reinterpret_cast<char*>(&jh), sizeof(jh)) || memcmp(jh.magic, JOURNALMAGIC, sizeof(JOURNALMAGIC)))
+		return entries;
+	hbase = jh.base;
+	end = sizeof(jh);
+	auto e = Entry{};
+	f.seekg(0, std::ios::end);
+	const auto fsize = size_t(f.tellg());
+	f.seekg(std::streamoff(end));
+	while (f.read(reinterpret_cast<char*>(&e.header), sizeof(e.header)))
+	{
+		if (e.header.size > fsize - end - sizeof(e.header))
+			break; // garbage or interrupted write, do not allocate an arbitrary size
+		e.payload.resize(e.header.size);
+		if (!f.read(&e.payload[0], std::streamsize(e.payload.size())) || (checksum(e.header, e.payload) != e.header.checksum))
+			break; // interrupted write
+		end += sizeof(e.header) + e.payload.size();
+		entries.push_back(e);
+	}
+	return entries;
+}
+
+/*! Replaces the file */
+void Journal::rewrite(uint32_t hbase, const std::vector<Entry> &entries)
+{
+	auto jh = JournalHeader{};
+	memcpy(jh.magic, JOURNALMAGIC, sizeof(JOURNALMAGIC));
+	jh.base = hbase;
+	jh.reserved = 0;
+	auto buf = std::string(reinterpret_cast<const char*>(&jh), sizeof(jh));
+	for (const auto &e : entries)
+	{
+		buf.append(reinterpret_cast<const char*>(&e.header), sizeof(e.header));
+		buf += e.payload;
+	}
+	WriteFileAtomically(filename, buf.data(), buf.size());
+}
+
+/*! Opens the file for appending */
+void Journal::open()
+{
+#ifdef _WIN32
+	file = CreateFileA(filename.CStr(), FILE_APPEND_DATA, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		file = nullptr;
+#else
+	fd = ::open(filename.CStr(), O_WRONLY | O_APPEND);
+	if (fd == -1)
+	{
+#endif
+		throw crn::ExceptionIO("Journal::Journal(): "_s + _("Cannot open file: ") + filename);
+	}
+}
+
+void Journal::close() noexcept
+{
+#ifdef _WIN32
+	if (file)
+		CloseHandle(file);
+	file = nullptr;
+#else
+	if (fd != -1)
+		::close(fd);
+	fd = -1;
+#endif
+}
+
+bool Journal::isOpen() const noexcept
+{
+#ifdef _WIN32
+	return file != nullptr;
+#else
+	return fd != -1;
+#endif
+}
+
+void Journal::write(const void *data, size_t size)
+{
+	const auto *p = reinterpret_cast<const char*>(data);
+	while (size)
+	{
+#ifdef _WIN32
+		auto n = DWORD(0);
+		if (!WriteFile(file, p, DWORD(size), &n, nullptr))
+#else
+		const auto n = ::write(fd, p, size);
+		if (n <= 0)
+#endif
+			throw crn::ExceptionIO("Journal::Append(): "_s + _("Cannot write file: ") + filename);
+		p += n;
+		size -= size_t(n);
+	}
+}
+
+/*! Flushes the file to the disk */
+void Journal::sync()
+{
+#if defined(_WIN32)
+	if (!FlushFileBuffers(file))
+#elif defined(__APPLE__)
+	if (fsync(fd))
+#else
+	if (fdatasync(fd))
+#endif
+		throw crn::ExceptionIO("Journal::Append(): "_s + _("Cannot write file: ") + filename);
+}
+
+/*! FNV-1a hash of a record */
+uint32_t Journal::checksum(const RecordHeader &h, const std::string &payload) noexcept
+{
+	auto sum = uint32_t(2166136261u);
+	const auto add = [&sum](const char *b, size_t n)
+		{
+			for (auto i = size_t(0); i < n; ++i)
+				sum = (sum ^ uint32_t(uint8_t(b[i]))) * 16777619u;
+		};
+	add(reinterpret_cast<const char*>(&h), offsetof(RecordHeader, checksum));
+	add(payload.data(), payload.size());
+	return sum;
+}
+
+Journal::Writer& Journal::Writer::operator<<(int32_t i)
+{
+	data.append(reinterpret_cast<const char*>(&i), sizeof(i));
+	return *this;
+}
+
+Journal::Writer& Journal::Writer::operator<<(const crn::StringUTF8 &s)
+{
+	*this << int32_t(s.Size());
+	data.append(s.CStr(), s.Size());
+	return *this;
+}
+
+Journal::Reader& Journal::Reader::operator>>(int32_t &i)
+{
+	if (pos + sizeof(i) > data.size())
+		throw crn::ExceptionDomain("Journal::Reader(): "_s + _("truncated record."));
+	memcpy(&i, data.data() + pos, sizeof(i));
+	pos += sizeof(i);
+	return *this;
+}
+
+Journal::Reader& Journal::Reader::operator>>(crn::StringUTF8 &s)
+{
+	auto n = int32_t(0);
+	*this >> n;
+	if ((n < 0) || (pos + size_t(n) > data.size()))
+		throw crn::ExceptionDomain("Journal::Reader(): "_s + _("truncated record."));
+	s = crn::StringUTF8{std::string(data.data() + pos, size_t(n))};
+	pos += size_t(n);
+	return *this;
+}
+
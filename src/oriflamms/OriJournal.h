@@ -0,0 +1,137 @@
+/*! Copyright 2013-2016 A2IA, CNRS, École Nationale des Chartes, ENS Lyon, INSA Lyon, Université Paris Descartes, Université de Poitiers
+ *
+ * This file is part of Oriflamms.
+ *
+ * Oriflamms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oriflamms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Oriflamms.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \file OriJournal.h
+ */
+
+#ifndef OriJournal_HEADER
+#define OriJournal_HEADER
+
+#include <oriflamms_config.h>
+#include <CRNIO/CRNPath.h>
+#include <CRNStringUTF8.h>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ori
+{
+	/*! \brief Append-only file of edits
+	 *
+	 * Each record is written to the disk before Append() returns, so that an edit survives a crash without rewriting whole files.
+	 * Records are numbered. Once the data they hold is saved in the regular files, they are discarded.
+	 * A record that was only partly written when the program stopped is ignored and removed.
+	 */
+	class Journal
+	{
+		public:
+			/*! \brief Type of a record */
+			enum class Record: uint32_t { WORD = 1, CLUSTERS = 2, ZONE = 3 };
+
+			/*! \brief Opens a journal
+			 *
+			 * Nothing is written until the first record is appended: the file is created, or repaired if its last record was not completely written, at that time.
+			 */
+			Journal(const crn::Path &fname);
+			~Journal();
+			Journal(const Journal&) = delete;
+			Journal& operator=(const Journal&) = delete;
+
+			/*! \brief Writes a record and flushes it to the disk
+			 * \throws	crn::ExceptionIO	cannot create or write the file
+			 * \return	the number of the record
+			 */
+			uint32_t Append(Record type, const std::string &payload);
+			/*! \brief Writes several records and flushes them to the disk at once
+			 * \throws	crn::ExceptionIO	cannot create or write the file
+			 * \return	the number of the last record
+			 */
+			uint32_t Append(const std::vector<std::pair<Record, std::string>> &records);
+			/*! \brief Gets the number of the last record (or of the last discarded record if the journal is empty) */
+			uint32_t GetLastNumber() const;
+			/*! \brief Reads the records in order
+			 * \param[in]	after	only the records with a greater number are read
+			 * \param[in]	fun	function called for each record
+			 */
+			void Replay(uint32_t after, const std::function<void(Record, const std::string&)> &fun) const;
+			/*! \brief Removes the records that were saved
+			 * \throws	crn::ExceptionIO	cannot write the file
+			 * \param[in]	upto	number of the last record to remove
+			 */
+			void Discard(uint32_t upto);
+
+			/*! \brief Builds the payload of a record */
+			class Writer
+			{
+				public:
+					Writer& operator<<(int32_t i);
+					Writer& operator<<(const crn::StringUTF8 &s);
+					const std::string& GetData() const noexcept { return data; }
+				private:
+					std::string data;
+			};
+			/*! \brief Reads the payload of a record */
+			class Reader
+			{
+				public:
+					Reader(const std::string &payload) noexcept:data(payload) {}
+					/*! \throws	crn::ExceptionDomain	truncated record */
+					Reader& operator>>(int32_t &i);
+					/*! \throws	crn::ExceptionDomain	truncated record */
+					Reader& operator>>(crn::StringUTF8 &s);
+				private:
+					const std::string &data;
+					size_t pos = 0;
+			};
+
+		private:
+			struct RecordHeader
+			{
+				uint32_t size, type, num, checksum;
+			};
+			struct Entry
+			{
+				RecordHeader header;
+				std::string payload;
+			};
+
+			std::vector<Entry> readAll(uint32_t &hbase, size_t &end) const;
+			void rewrite(uint32_t hbase, const std::vector<Entry> &entries);
+			void open();
+			void close() noexcept;
+			bool isOpen() const noexcept;
+			void write(const void *data, size_t size);
+			void sync();
+			static uint32_t checksum(const RecordHeader &h, const std::string &payload) noexcept;
+
+			crn::Path filename;
+			mutable std::mutex mutex;
+			uint32_t base = 0; // number of the last discarded record
+			uint32_t last = 0; // number of the last record
+#ifdef _WIN32
+			void *file = nullptr;
+#else
+			int fd = -1;
+#endif
+	};
+}
+
+#endif
+
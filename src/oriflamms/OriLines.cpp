@@ -530,13 +530,12 @@ using namespace ori;
 /*! Detects lines and columns on an image
  *
  * \warning	an image of two one-columned pages returns the same results as an image of a one two-columned page
- *
- * \param[in]	b	the block to analyze
- * \return	a vector of columns, columns being vectors of lines, a line being a LinearInterpolation
  */
-void View::detectLines()
+void View::DetectLines()
 {
-	pimpl->medlines.clear();
+	for (auto &col : pimpl->medlines)
+		col.clear();
+	pimpl->modified.medlines = true;
 	auto &b = GetBlock();
 	const auto w = b.GetGray()->GetWidth();
 	const auto h = b.GetGray()->GetHeight();
@@ -664,13 +663,7 @@ void View::detectLines()
 	ig.Convolve(ydiff);
 
 	// Columns
-	auto column_ids = std::vector<Id>{};
-	for (const auto &p : pimpl->struc.pages)
-	{
-		std::copy(p.second.GetColumns().begin(), p.second.GetColumns().end(), std::back_inserter(column_ids));
-	}
-
-	auto thumbzones = detectColumns(*b.GetGray(), column_ids.size());
+	auto thumbzones = detectColumns(*b.GetGray(), pimpl->struc.columns.size());
 	for (Rect &r : thumbzones)
 	{
 		r.SetLeft(int(r.GetLeft() / xdiv));
@@ -901,7 +894,7 @@ void View::detectLines()
 		/////////////////////////////////////////////////////////////
 		// Remove supernumerary lines
 		/////////////////////////////////////////////////////////////
-		const auto nlines = GetColumn(column_ids[tmpz]).GetLines().size();
+		const auto nlines = pimpl->struc.columns[tmpz].GetLines().size();
 		auto fw = tz.GetWidth() * int(xdiv);
 		while (log2(fw) != floor(log2(fw))) fw += 1;
 		//const auto adiv = 32;
@@ -1092,7 +1085,7 @@ void View::detectLines()
 			for (const auto &l : lines)
 			{
 				auto sline = SimplifyCurve(l->GetData(), 0.1); // why 0.1?
-				pimpl->medlines[column_ids[tmpz]].emplace_back(std::make_shared<LinearInterpolation>(sline.begin(), sline.end()), lspace1);
+				pimpl->medlines[tmpz].emplace_back(std::make_shared<LinearInterpolation>(sline.begin(), sline.end()), lspace1);
 			}
 		} // line list not empty
 	} // for each column
@@ -65,6 +65,10 @@ namespace ori
 			const std::vector<ImageSignature>& ExtractFeatures(crn::Block &b) const;
 			/*! \brief Deletes the cached signature string */
 			void ClearFeatures() { features.clear(); }
+			/*! \brief Gets the cached signature string (empty if it was not computed) */
+			const std::vector<ImageSignature>& GetFeatures() const noexcept { return features; }
+			/*! \brief Sets the cached signature string */
+			void SetFeatures(std::vector<ImageSignature> sig) { features = std::move(sig); }
 
 			void Deserialize(crn::xml::Element &el);
 			crn::xml::Element Serialize(crn::xml::Element &parent) const;
@@ -0,0 +1,127 @@
+/*! Copyright 2013-2016 A2IA, CNRS, École Nationale des Chartes, ENS Lyon, INSA Lyon, Université Paris Descartes, Université de Poitiers
+ *
+ * This file is part of Oriflamms.
+ *
+ * Oriflamms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oriflamms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Oriflamms.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \file OriShapeContext.cpp
+ */
+
+#include <OriShapeContext.h>
+#include <CRNException.h>
+#include <CRNi18n.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#	define ORI_SSE2
+#	include <emmintrin.h>
+#endif
+
+using namespace ori;
+using namespace crn::literals;
+
+/*! L1 distance between two rows of n values, n being a multiple of 4 */
+static inline float rowDistance(const float *a, const float *b, size_t n) noexcept
+{
+#ifdef ORI_SSE2
+	const auto absmask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	auto acc0 = _mm_setzero_ps();
+	auto acc1 = _mm_setzero_ps();
+	auto i = size_t(0);
+	for (; i + 8 <= n; i += 8)
+	{
+		acc0 = _mm_add_ps(acc0, _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)), absmask));
+		acc1 = _mm_add_ps(acc1, _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)), absmask));
+	}
+	if (i < n)
+		acc0 = _mm_add_ps(acc0, _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)), absmask));
+	acc0 = _mm_add_ps(acc0, acc1);
+	acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+	acc0 = _mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, 1));
+	return _mm_cvtss_f32(acc0);
+#else
+	auto d = 0.0f;
+	for (auto i = size_t(0); i < n; ++i)
+		d += std::abs(a[i] - b[i]);
+	return d;
+#endif
+}
+
+/*! L1 norm of a row of n values */
+static inline float rowNorm(const float *a, size_t n) noexcept
+{
+	auto d = 0.0f;
+	for (auto i = size_t(0); i < n; ++i)
+		d += std::abs(a[i]);
+	return d;
+}
+
+void ShapeContextSet::addRow(const std::vector<float> &row)
+{
+	if (!rows)
+	{
+		dim = row.size();
+		stride = (dim + 3) & ~size_t(3);
+	}
+	else if (row.size() != dim)
+		throw crn::ExceptionDimension("ShapeContextSet::Add(): "_s + _("The shape contexts do not have the same size."));
+	values.insert(values.end(), row.begin(), row.end());
+	values.resize(values.size() + stride - dim, 0.0f);
+	rows += 1;
+}
+
+double ShapeContextSet::Distance(size_t i, size_t j) const
+{
+	const auto *a = values.data() + first[i] * stride;
+	const auto na = first[i + 1] - first[i];
+	const auto *b = values.data() + first[j] * stride;
+	const auto nb = first[j + 1] - first[j];
+	if (!na || !nb)
+	{ // distance to a null context
+		const auto *p = na ? a : b;
+		const auto n = na + nb;
+		if (!n)
+			return 0.0;
+		auto d = 0.0;
+		auto nearest = std::numeric_limits<float>::max();
+		for (auto r = size_t(0); r < n; ++r)
+		{
+			const auto norm = rowNorm(p + r * stride, dim);
+			d += norm;
+			nearest = std::min(nearest, norm);
+		}
+		return (d + nearest) / double(n + 1);
+	}
+
+	// nearest neighbours in both directions from a single pass on the pairs
+	auto bmin = std::vector<float>(nb, std::numeric_limits<float>::max());
+	auto d = 0.0;
+	for (auto ra = size_t(0); ra < na; ++ra)
+	{
+		const auto *rowa = a + ra * stride;
+		auto amin = std::numeric_limits<float>::max();
+		for (auto rb = size_t(0); rb < nb; ++rb)
+		{
+			const auto rd = rowDistance(rowa, b + rb * stride, stride);
+			amin = std::min(amin, rd);
+			bmin[rb] = std::min(bmin[rb], rd);
+		}
+		d += amin;
+	}
+	for (auto m : bmin)
+		d += m;
+	return d / double(na + nb);
+}
+
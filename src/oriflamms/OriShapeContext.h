@@ -0,0 +1,89 @@
+/*! Copyright 2013-2016 A2IA, CNRS, École Nationale des Chartes, ENS Lyon, INSA Lyon, Université Paris Descartes, Université de Poitiers
+ *
+ * This file is part of Oriflamms.
+ *
+ * Oriflamms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oriflamms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Oriflamms.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \file OriShapeContext.h
+ */
+
+#ifndef OriShapeContext_HEADER
+#define OriShapeContext_HEADER
+
+#include <oriflamms_config.h>
+#include <type_traits>
+#include <vector>
+
+namespace ori
+{
+	/*! \brief Shape contexts of a set of images, packed in a single matrix of floats
+	 *
+	 * Each shape context is a row of single precision values, padded with zeros to a multiple of 4 so that distances are computed 4 values at a time.
+	 * The rows of an image are contiguous and the images are stored one after the other.
+	 */
+	class ShapeContextSet
+	{
+		public:
+			/*! \brief Creates an empty set */
+			ShapeContextSet() noexcept {}
+
+			/*! \brief Adds the shape contexts of an image
+			 * \throws	crn::ExceptionDimension	the contexts do not have the same number of values as the previous ones
+			 * \param[in]	contexts	a list of shape contexts, each being a (possibly nested) array of numbers
+			 */
+			template<typename SC> void Add(const std::vector<SC> &contexts)
+			{
+				auto row = std::vector<float>{};
+				for (const auto &sc : contexts)
+				{
+					row.clear();
+					flatten(sc, row);
+					addRow(row);
+				}
+				first.push_back(rows);
+			}
+
+			/*! \brief Gets the number of images */
+			size_t GetSize() const noexcept { return first.size() - 1; }
+
+			/*! \brief Distance between the shape contexts of two images
+			 *
+			 * Each context is matched to the nearest context of the other image (L1 distance) and the distances are averaged on both images.
+			 * An image without contexts is compared as if it had a single null context.
+			 * It is not the distance of crn::GradientShapeContext, so the matrices it fills are tagged "gsc-nn" and never mixed with the former "gsc" ones.
+			 * \param[in]	i	the index of the first image (no bound checking)
+			 * \param[in]	j	the index of the second image (no bound checking)
+			 */
+			double Distance(size_t i, size_t j) const;
+
+		private:
+			template<typename T> static void flatten(const T &val, std::vector<float> &out, std::true_type) { out.push_back(float(val)); }
+			template<typename T> static void flatten(const T &range, std::vector<float> &out, std::false_type)
+			{
+				for (const auto &val : range)
+					flatten(val, out);
+			}
+			template<typename T> static void flatten(const T &val, std::vector<float> &out) { flatten(val, out, std::is_arithmetic<T>{}); }
+			void addRow(const std::vector<float> &row);
+
+			size_t dim = 0; // number of values in a context
+			size_t stride = 0; // number of values in a row
+			size_t rows = 0;
+			std::vector<float> values;
+			std::vector<size_t> first = std::vector<size_t>(1, 0); // first row of each image, followed by the number of rows
+	};
+}
+
+#endif
+
@@ -23,51 +23,147 @@
 #include <OriFeatures.h>
 #include <CRNXml/CRNXml.h>
 #include <CRNi18n.h>
+#include <OriDefaultSignatures.h>
+#include <OriConfig.h>
+#include <CRNIO/CRNIO.h>
+#include <CRNException.h>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <unordered_map>
 
 using namespace ori;
+using namespace crn::literals;
 
-TextSignatureDB::TextSignatureDB() = default;
+static const auto NBLOCKS = size_t(0x110000 >> 8); // up to the last Unicode code point
 
-TextSignatureDB& TextSignatureDB::getInstance()
+TextSignatureDB::TextSignatureDB():
+	blocks(NBLOCKS, 0),
+	entries(256)
 {
-	static auto instance = TextSignatureDB{};
-	return instance;
+	for (const auto &e : defaultsig::table)
+		add(e.c, e.sig, strlen(e.sig));
 }
 
-void TextSignatureDB::Load(const crn::Path &fname)
+TextSignatureDB::TextSignatureDB(const crn::Path &fname):
+	blocks(NBLOCKS, 0),
+	entries(256)
 {
-	auto &inst = getInstance();
-	inst.signature_db.clear();
 	auto doc = crn::xml::Document(fname); // may throw
 	auto root = doc.GetRoot();
 	for (auto el = root.BeginElement(); el != root.EndElement(); ++el)
 	{
-		inst.signature_db.emplace(char32_t(el.GetAttribute<int>("char")), el.GetAttribute<crn::StringUTF8>("sig"));
+		const auto sig = el.GetAttribute<crn::StringUTF8>("sig");
+		add(char32_t(el.GetAttribute<int>("char")), sig.CStr(), sig.Size());
 	}
 }
 
-crn::StringUTF8 TextSignatureDB::Convert(char32_t c)
+/*! Sets the signature of a character */
+void TextSignatureDB::add(char32_t c, const char *sig, size_t len)
 {
-	return getInstance().signature_db[c];
+	const auto b = size_t(c >> 8);
+	if (b >= NBLOCKS)
+		return;
+	if (!blocks[b])
+	{ // first character of the block
+		blocks[b] = uint32_t(entries.size());
+		entries.resize(entries.size() + 256);
+	}
+	auto &e = entries[blocks[b] + (c & 0xFF)];
+	e.offset = uint32_t(pool.size());
+	e.size = uint32_t(len);
+	pool.append(sig, len);
+}
+
+std::shared_ptr<const TextSignatureDB> TextSignatureDB::GetDefault()
+{
+	static const auto defaultdb = std::make_shared<const TextSignatureDB>();
+	return defaultdb;
 }
 
-crn::StringUTF8 TextSignatureDB::Convert(const crn::String &str)
+/*! Path to the file of a named database, or an empty path */
+static crn::Path signatureFile(const crn::StringUTF8 &name)
 {
-	auto &inst = getInstance();
-	auto res = crn::StringUTF8{};
+	for (const auto &dir : { Config::GetUserDirectory(), Config::GetStaticDataDir() })
+	{
+		const auto fname = dir / "signatures" / name + ".xml";
+		if (crn::IO::Access(fname, crn::IO::EXISTS))
+			return fname;
+	}
+	return crn::Path{};
+}
+
+std::shared_ptr<const TextSignatureDB> TextSignatureDB::Get(const crn::StringUTF8 &name)
+{
+	if (name.IsEmpty())
+		return GetDefault();
+	static std::mutex mutex;
+	static auto registry = std::unordered_map<crn::StringUTF8, std::shared_ptr<const TextSignatureDB>>{};
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = registry.find(name);
+	if (it != registry.end())
+		return it->second;
+	const auto fname = signatureFile(name);
+	if (fname.IsEmpty())
+		throw crn::ExceptionNotFound("TextSignatureDB::Get(): "_s + _("Cannot find signature table: ") + name);
+	auto db = std::make_shared<const TextSignatureDB>(fname); // may throw
+	registry.emplace(name, db);
+	return db;
+}
+
+std::vector<crn::StringUTF8> TextSignatureDB::GetNames()
+{
+	auto names = std::set<crn::StringUTF8>{};
+	for (const auto &dir : { Config::GetUserDirectory(), Config::GetStaticDataDir() })
+	{
+		const auto sigdir = dir / "signatures";
+		if (!crn::IO::Access(sigdir, crn::IO::EXISTS))
+			continue;
+		for (const auto &fname : crn::IO::Directory{sigdir}.GetFiles())
+			if (fname.EndsWith(".xml"_s))
+				names.emplace(fname.GetBase());
+	}
+	return std::vector<crn::StringUTF8>(names.begin(), names.end());
+}
+
+crn::StringUTF8 TextSignatureDB::Convert(char32_t c) const
+{
+	const auto &e = find(c);
+	return std::string(pool.data() + e.offset, e.size);
+}
+
+crn::StringUTF8 TextSignatureDB::Convert(const crn::String &str) const
+{
+	auto len = size_t(0);
+	for (auto tmp = size_t(0); tmp < str.Size(); ++tmp)
+		len += find(str[tmp]).size;
+	auto res = std::string{};
+	res.reserve(len);
 	for (auto tmp = size_t(0); tmp < str.Size(); ++tmp)
-		res += inst.signature_db[str[tmp]];
+	{
+		const auto &e = find(str[tmp]);
+		res.append(pool.data() + e.offset, e.size);
+	}
 	return res;
 }
 
-std::vector<TextSignature> TextSignatureDB::Sign(const crn::String &str)
+void TextSignatureDB::Sign(const crn::String &str, std::vector<TextSignature> &sig) const
+{
+	auto start = true;
+	for (auto tmp = size_t(0); tmp < str.Size(); ++tmp)
+	{
+		const auto &e = find(str[tmp]);
+		for (auto i = e.offset; i < e.offset + e.size; ++i)
+		{
+			sig.emplace_back(start, pool[i]);
+			start = false;
+		}
+	}
+}
+
+std::vector<TextSignature> TextSignatureDB::Sign(const crn::String &str) const
 {
-	const auto f = Convert(str);
 	auto sig = std::vector<TextSignature>{};
-	if (f.IsEmpty())
-		return sig;
-	sig.emplace_back(true, f[0]);
-	for (auto tmp = size_t(1); tmp < f.Size(); ++tmp)
-		sig.emplace_back(false, f[tmp]);
+	Sign(str, sig);
 	return sig;
 }
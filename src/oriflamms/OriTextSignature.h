@@ -25,22 +25,68 @@
 #include <oriflamms_config.h>
 #include <CRNString.h>
 #include <CRNIO/CRNPath.h>
-#include <unordered_map>
+#include <memory>
+#include <string>
+#include <vector>
 #include <OriFeatures.h> // MSVC cannot link if we forward declare class TextSignature
 
 namespace ori
 {
+	/*! \brief Signatures of the characters of a script
+	 *
+	 * A database is immutable once read, so that it can be used by several threads and documents without locking.
+	 * The signatures are stored in a single pool, and a two-level table over the code points gives their position in the pool.
+	 */
 	class TextSignatureDB
 	{
 		public:
-			static void Load(const crn::Path &fname);
-			static crn::StringUTF8 Convert(char32_t c);
-			static crn::StringUTF8 Convert(const crn::String &str);
-			static std::vector<TextSignature> Sign(const crn::String &str);
-		private:
+			/*! \brief Creates the default database, compiled in the program */
 			TextSignatureDB();
-			static TextSignatureDB& getInstance();
-			std::unordered_map<char32_t, crn::StringUTF8> signature_db; /*!< signature database */
+			/*! \brief Reads a signature file, to override the default database
+			 * \throws	crn::Exception	cannot read the file
+			 */
+			TextSignatureDB(const crn::Path &fname);
+			/*! \brief Gets the default database, compiled in the program */
+			static std::shared_ptr<const TextSignatureDB> GetDefault();
+			/*! \brief Gets a named database
+			 *
+			 * A named database is read from the file <name>.xml in the "signatures" folder of the user directory or else of the data directory.
+			 * It is read once and shared by all the documents that use it.
+			 * \throws	crn::ExceptionNotFound	no such database
+			 * \throws	crn::Exception	cannot read the file
+			 * \param[in]	name	the name of the database, or an empty string for the default database
+			 */
+			static std::shared_ptr<const TextSignatureDB> Get(const crn::StringUTF8 &name);
+			/*! \brief Lists the names of the databases that can be read */
+			static std::vector<crn::StringUTF8> GetNames();
+
+			/*! \brief Gets the signature of a character (empty if unknown) */
+			crn::StringUTF8 Convert(char32_t c) const;
+			/*! \brief Gets the signature of a string */
+			crn::StringUTF8 Convert(const crn::String &str) const;
+			/*! \brief Appends the signature of a string to a buffer. The first element of the string is marked as a start. */
+			void Sign(const crn::String &str, std::vector<TextSignature> &sig) const;
+			/*! \brief Gets the signature of a string. The first element is marked as a start. */
+			std::vector<TextSignature> Sign(const crn::String &str) const;
+
+		private:
+			/*! \brief Position of a signature in the pool */
+			struct Entry
+			{
+				uint32_t offset = 0, size = 0;
+			};
+			const Entry& find(char32_t c) const noexcept
+			{
+				static const auto none = Entry{};
+				const auto b = size_t(c >> 8);
+				return b < blocks.size() ? entries[blocks[b] + (c & 0xFF)] : none;
+			}
+
+			void add(char32_t c, const char *sig, size_t len);
+
+			std::vector<uint32_t> blocks; // code point / 256 -> index of the block's first entry
+			std::vector<Entry> entries; // 256 entries per block, the first block is empty and shared by the unused blocks
+			std::string pool; // all signatures
 	};
 }
 #endif
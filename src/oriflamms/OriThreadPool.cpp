@@ -0,0 +1,62 @@
+/*! Copyright 2013-2016 A2IA, CNRS, École Nationale des Chartes, ENS Lyon, INSA Lyon, Université Paris Descartes, Université de Poitiers
+ *
+ * This file is part of Oriflamms.
+ *
+ * Oriflamms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oriflamms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Oriflamms.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \file OriThreadPool.cpp
+ */
+
+#include <OriThreadPool.h>
+#include <algorithm>
+
+using namespace ori;
+
+ThreadPool::ThreadPool(size_t nthreads)
+{
+	if (!nthreads)
+		nthreads = std::max(size_t(std::thread::hardware_concurrency()), size_t(1));
+	threads.reserve(nthreads);
+	for (auto i = size_t(0); i < nthreads; ++i)
+		threads.emplace_back(&ThreadPool::run, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+	cond.notify_all();
+	for (auto &t : threads)
+		t.join();
+}
+
+void ThreadPool::run()
+{
+	while (true)
+	{
+		auto task = std::function<void()>{};
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cond.wait(lock, [this]() { return stop || !tasks.empty(); });
+			if (tasks.empty())
+				return; // stopped and nothing left to do
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
+
@@ -0,0 +1,84 @@
+/*! Copyright 2013-2016 A2IA, CNRS, École Nationale des Chartes, ENS Lyon, INSA Lyon, Université Paris Descartes, Université de Poitiers
+ *
+ * This file is part of Oriflamms.
+ *
+ * Oriflamms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oriflamms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Oriflamms.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \file OriThreadPool.h
+ */
+
+#ifndef OriThreadPool_HEADER
+#define OriThreadPool_HEADER
+
+#include <oriflamms_config.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ori
+{
+	/*! \brief A fixed set of threads running tasks in order of submission
+	 *
+	 * The results and exceptions of the tasks are returned through futures.
+	 * The destructor waits for all submitted tasks to be run.
+	 */
+	class ThreadPool
+	{
+		public:
+			/*! \brief Starts the threads
+			 * \param[in]	nthreads	number of threads (0 for the number of cores)
+			 */
+			ThreadPool(size_t nthreads = 0);
+			~ThreadPool();
+			ThreadPool(const ThreadPool&) = delete;
+			ThreadPool& operator=(const ThreadPool&) = delete;
+
+			/*! \brief Gets the number of threads */
+			size_t GetSize() const noexcept { return threads.size(); }
+
+			/*! \brief Adds a task to the queue
+			 * \param[in]	f	a function with no argument
+			 * \return	the future result of the function
+			 */
+			template<typename F> auto Submit(F &&f) -> std::future<decltype(f())>
+			{
+				using R = decltype(f());
+				auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+				auto res = task->get_future();
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					tasks.emplace_back([task]() { (*task)(); });
+				}
+				cond.notify_one();
+				return res;
+			}
+
+		private:
+			void run();
+
+			std::vector<std::thread> threads;
+			std::deque<std::function<void()>> tasks;
+			std::mutex mutex;
+			std::condition_variable cond;
+			bool stop = false;
+	};
+}
+
+#endif
+
@@ -126,9 +126,9 @@ void Validation::update_words(crn::Progress *prog)
 		auto view = doc.GetView(vid);
 		for (const auto &w : view.GetWords())
 		{
-			words[w.second.GetText()].push_back(w.first);
-			if (view.IsValid(w.first).IsUnknown())
-				kowords.insert(w.second.GetText());
+			words[w.GetText()].push_back(w.GetId());
+			if (view.IsValid(w.GetId()).IsUnknown())
+				kowords.insert(w.GetText());
 		}
 		prog->Advance();
 	}
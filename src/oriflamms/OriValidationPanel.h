@@ -35,7 +35,7 @@ namespace ori
 		public:
 			struct ElementId
 			{
-				ElementId(const ElementPosition &wid, const Id &cid = ""): word_id(wid), char_id(cid) {}
+				ElementId(const ElementPosition &wid, const Id &cid = Id{}): word_id(wid), char_id(cid) {}
 				ElementPosition word_id;
 				Id char_id;
 				inline bool operator<(const ElementId &other) const noexcept
@@ -58,7 +58,7 @@ namespace ori
 			ValidationPanel(Document &docu, const crn::StringUTF8 &name, bool active_m);
 			virtual ~ValidationPanel() override { }
 
-			void add_element(const ElementPosition &pos, const crn::StringUTF8 cluster, const Glib::RefPtr<Gdk::Pixbuf> &pb, const Glib::RefPtr<Gdk::Pixbuf> &tip_pb, const Id &char_id = "");
+			void add_element(const ElementPosition &pos, const crn::StringUTF8 cluster, const Glib::RefPtr<Gdk::Pixbuf> &pb, const Glib::RefPtr<Gdk::Pixbuf> &tip_pb, const Id &char_id = Id{});
 			/*! \brief Erases all elements */
 			void clear()
 			{
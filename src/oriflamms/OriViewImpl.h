@@ -22,6 +22,14 @@
 #ifndef OriViewImpl_HEADER
 #define OriViewImpl_HEADER
 
+#include <OriIO.h>
+#include <OriJournal.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <limits>
+
 namespace ori
 {
 	struct View::Impl
@@ -30,24 +38,52 @@ namespace ori
 		~Impl();
 		void readZoneElements(crn::xml::Element &el);
 		void readLinkElements(crn::xml::Element &el, bool clean);
+		void setZone(ElementKind kind, size_t index, const Id &zone_id);
 		void load();
+		bool loadBinary(const crn::Path &f, const FileStamp &xml);
+		void importXml(const crn::Path &f);
 		void save();
+		void prepareSave(std::vector<std::function<void()>> &writes);
+		std::vector<uint8_t> binaryData() const;
+		using JournalRecords = std::vector<std::pair<Journal::Record, std::string>>;
+		void journalWord(size_t w, bool with_zones = true);
+		void journalWords(size_t first, size_t end, bool with_zones = true);
+		void journalZones(const std::vector<size_t> &zs);
+		void wordRecords(size_t w, bool with_zones, JournalRecords &recs) const;
+		void zoneRecord(size_t z, JournalRecords &recs) const;
+		void journalClusters(size_t c);
+		void appendJournal(const JournalRecords &recs);
+		void replayJournal();
+		void exportXml(const crn::Path &f) const;
+		void linkZones();
+		template<typename T> void linkZones(std::vector<size_t> &links, const std::vector<T> &elems);
+		Zone& getZone(const std::vector<size_t> &links, size_t index, const Id &elem_id);
+		std::vector<size_t>& zoneLinks(ElementKind kind) noexcept;
+		size_t bufferSize() const;
+		size_t memorySize() const;
+		void releaseBuffers();
 
+		Id::Scope id_scope; // a view may outlive its document
 		Id id;
 		mutable crn::SBlock img;
 		crn::Path imagename;
-		mutable crn::SImageGray weight;
+		mutable std::unique_ptr<WeightMap> weight;
 
 		Document::ViewStructure &struc;
-		std::unordered_map<Id, Zone> zones;
+		std::deque<Zone> zones; // a deque so that references stay valid when a zone is added
+		std::unordered_map<Id, size_t> zone_index; // zone Id -> index in zones
+		static constexpr size_t NONE = std::numeric_limits<size_t>::max();
+		std::vector<size_t> page_zones, column_zones, line_zones, word_zones, character_zones; // element index -> index in zones or NONE
 
 		crn::xml::Document zonesdoc;
 		crn::xml::Document linksdoc;
 		std::unordered_map<crn::StringUTF8, crn::xml::Element> link_groups;
 		crn::xml::Document ontolinksdoc;
 		std::unique_ptr<crn::xml::Element> ontolinkgroup;
+		crn::Path zonespath, linkspath, ontolinkspath;
 
 		crn::Path datapath;
+		FileStamp xml_stamp; // the XML oridata file the data was imported from
 		struct WordValidation
 		{
 			WordValidation(crn::Prop3 val): ok(val) {}
@@ -55,11 +91,26 @@ namespace ori
 			int left_corr = 0, right_corr = 0;
 			crn::StringUTF8 imgsig;
 		};
-		std::unordered_map<Id, WordValidation> validation; // word Id
-		std::unordered_map<Id, std::vector<GraphicalLine>> medlines; // column Id
-		std::unordered_map<Id, std::pair<Id, size_t>> line_links; // line Id -> column Id + index
-		std::unordered_map<Id, std::vector<Id>> onto_links; // word Id -> { glyph Ids }
+		std::vector<WordValidation> validation; // word index
+		std::vector<std::vector<GraphicalLine>> medlines; // column index
+		std::vector<std::pair<size_t, size_t>> line_links; // line index -> column index + index or NONE
+		std::vector<std::vector<Id>> onto_links; // character index -> { glyph Ids }
 		crn::StringUTF8 logmsg;
+
+		/*! \brief Data modified since the last save, only the files holding them are written */
+		struct Modified
+		{
+			bool zones = false;
+			bool links = false;
+			bool ontolinks = false;
+			bool validation = false;
+			bool medlines = false;
+			bool line_links = false;
+		} modified;
+		std::atomic<bool> write_failed{false}; // a background write failed, all files must be written again
+		std::shared_future<void> pending_save; // last background save of the view
+		std::shared_ptr<Journal> journal; // edits since the last save
+		uint32_t journal_saved = 0; // number of the last journal record included in the data file
 	};
 }
 
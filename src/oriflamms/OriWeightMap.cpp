@@ -0,0 +1,147 @@
+/*! Copyright 2013-2016 A2IA, CNRS, École Nationale des Chartes, ENS Lyon, INSA Lyon, Université Paris Descartes, Université de Poitiers
+ *
+ * This file is part of Oriflamms.
+ *
+ * Oriflamms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oriflamms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Oriflamms.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \file OriWeightMap.cpp
+ */
+
+#include <OriWeightMap.h>
+#include <CRNImage/CRNDifferential.h>
+#include <CRNImage/CRNImageGray.h>
+#include <CRNi18n.h>
+#include <cstring>
+
+using namespace ori;
+
+constexpr int WeightMap::TILE_SIZE;
+constexpr int WeightMap::TILE_MARGIN;
+
+/* Tile file layout
+ * 	magic (8 bytes)
+ * 	width, height, tile size, margin (4 × uint32)
+ * 	size and modification time of the image file (uint64, int64)
+ * 	one byte per tile: 1 if the tile was computed
+ * 	padding up to a multiple of the page size
+ * 	tiles (TILE_SIZE × TILE_SIZE bytes each, incomplete tiles at the border are padded)
+ */
+static const char TILEMAGIC[8] = {'O', 'R', 'I', 'W', 'G', 'T', '0', '3'};
+static const size_t TILEHEADER = sizeof(TILEMAGIC) + 4 * sizeof(uint32_t) + sizeof(uint64_t) + sizeof(int64_t);
+static const size_t TILEALIGN = 4096;
+/*! Laplacian values mapped to the darkest and lightest weights. The scale does not depend on the tile, so that adjacent tiles match. */
+static const double LAPLACIAN_RANGE = 64.0;
+
+WeightMap::WeightMap(const crn::SBlock &b, const FileStamp &imgstamp, const crn::Path &tilefile, size_t cachesize):
+	block(b),
+	width(b->GetAbsoluteBBox().GetWidth()),
+	height(b->GetAbsoluteBBox().GetHeight()),
+	ntx((width + TILE_SIZE - 1) / TILE_SIZE),
+	nty((height + TILE_SIZE - 1) / TILE_SIZE),
+	maxtiles(crn::Max(cachesize, size_t(1))),
+	lastnum(std::numeric_limits<size_t>::max()),
+	lastdata(nullptr)
+{
+	if (tilefile.IsEmpty())
+		return;
+
+	const auto ntiles = ntx * nty;
+	dataoffset = ((TILEHEADER + ntiles + TILEALIGN - 1) / TILEALIGN) * TILEALIGN;
+	const auto fsize = dataoffset + ntiles * TILE_SIZE * TILE_SIZE;
+	const uint32_t header[4] = { uint32_t(width), uint32_t(height), uint32_t(TILE_SIZE), uint32_t(TILE_MARGIN) };
+	char stamp[sizeof(uint64_t) + sizeof(int64_t)];
+	memcpy(stamp, &imgstamp.size, sizeof(uint64_t));
+	memcpy(stamp + sizeof(uint64_t), &imgstamp.mtime, sizeof(int64_t));
+	try
+	{
+		file = MappedFile{tilefile, MappedFile::Mode::READWRITE, fsize};
+		auto *ptr = file.GetData();
+		if (memcmp(ptr, TILEMAGIC, sizeof(TILEMAGIC)) || memcmp(ptr + sizeof(TILEMAGIC), header, sizeof(header)) ||
+				memcmp(ptr + sizeof(TILEMAGIC) + sizeof(header), stamp, sizeof(stamp)))
+		{ // new or obsolete file, or the image was replaced
+			memset(ptr, 0, dataoffset);
+			memcpy(ptr, TILEMAGIC, sizeof(TILEMAGIC));
+			memcpy(ptr + sizeof(TILEMAGIC), header, sizeof(header));
+			memcpy(ptr + sizeof(TILEMAGIC) + sizeof(header), stamp, sizeof(stamp));
+		}
+	}
+	catch (crn::Exception &ex)
+	{ // cannot store the tiles, keep them in memory
+		CRNWarning(ex.what());
+		file.Close();
+	}
+}
+
+void WeightMap::Clear() noexcept
+{
+	cache.clear();
+	lru.clear();
+	lastnum = std::numeric_limits<size_t>::max();
+	lastdata = nullptr;
+}
+
+const uint8_t* WeightMap::getTile(size_t num) const
+{
+	if (file.IsOpen())
+	{ // tiles are stored in the file
+		auto *flags = const_cast<MappedFile&>(file).GetData() + TILEHEADER;
+		auto *tile = const_cast<MappedFile&>(file).GetData() + dataoffset + num * TILE_SIZE * TILE_SIZE;
+		if (!flags[num])
+		{
+			computeTile(num, tile);
+			flags[num] = 1;
+		}
+		return tile;
+	}
+
+	auto it = cache.find(num);
+	if (it != cache.end())
+	{ // move to the front of the LRU list
+		lru.splice(lru.begin(), lru, it->second.second);
+		return it->second.first.data();
+	}
+
+	if (cache.size() >= maxtiles)
+	{ // evict the least recently used tile
+		cache.erase(lru.back());
+		lru.pop_back();
+	}
+	lru.push_front(num);
+	auto &tile = cache.emplace(num, Tile{std::vector<uint8_t>(TILE_SIZE * TILE_SIZE, 0), lru.begin()}).first->second;
+	computeTile(num, tile.first.data());
+	return tile.first.data();
+}
+
+/*! Computes the weight of the pixels of a tile: a mix of the Laplacian of the diffused gradient and of the gray level */
+void WeightMap::computeTile(size_t num, uint8_t *dst) const
+{
+	const auto tx = int(num % ntx) * TILE_SIZE;
+	const auto ty = int(num / ntx) * TILE_SIZE;
+	const auto ex = crn::Min(tx + TILE_SIZE, width) - 1;
+	const auto ey = crn::Min(ty + TILE_SIZE, height) - 1;
+	const auto area = crn::Rect{crn::Max(0, tx - TILE_MARGIN), crn::Max(0, ty - TILE_MARGIN), crn::Min(width - 1, ex + TILE_MARGIN), crn::Min(height - 1, ey + TILE_MARGIN)};
+
+	auto diff = crn::Differential::NewGaussian(crn::ImageRGB(*block->GetRGB(), area), crn::Differential::RGBProjection::ABSMAX, 0);
+	diff.Diffuse(5);
+	const auto lap = diff.MakeLaplacian();
+	const auto &gray = *block->GetGray();
+	for (auto y = ty; y <= ey; ++y)
+		for (auto x = tx; x <= ex; ++x)
+		{
+			const auto l = crn::Cap<double>(lap.At(x - area.GetLeft(), y - area.GetTop()), -LAPLACIAN_RANGE, LAPLACIAN_RANGE);
+			const auto l8 = int((l + LAPLACIAN_RANGE) * 255.0 / (2.0 * LAPLACIAN_RANGE));
+			dst[(y - ty) * TILE_SIZE + x - tx] = uint8_t(l8 / 2 + 127 - gray.At(x, y) / 2);
+		}
+}
+
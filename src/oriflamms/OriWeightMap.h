@@ -0,0 +1,96 @@
+/*! Copyright 2013-2016 A2IA, CNRS, École Nationale des Chartes, ENS Lyon, INSA Lyon, Université Paris Descartes, Université de Poitiers
+ *
+ * This file is part of Oriflamms.
+ *
+ * Oriflamms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oriflamms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Oriflamms.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \file OriWeightMap.h
+ */
+
+#ifndef OriWeightMap_HEADER
+#define OriWeightMap_HEADER
+
+#include <oriflamms_config.h>
+#include <OriIO.h>
+#include <CRNBlock.h>
+#include <list>
+#include <unordered_map>
+
+namespace ori
+{
+	/*! \brief Cost map used to compute the frontiers between words
+	 *
+	 * The map is divided in square tiles that are computed on demand, with a margin around each tile to limit border effects.
+	 * The tiles are kept in a LRU cache. If a tile file is provided, the computed tiles are stored in it and mapped in memory instead.
+	 * The map is not thread-safe.
+	 */
+	class WeightMap
+	{
+		public:
+			/*! \brief Constructor
+			 * \param[in]	b	the image of the view
+			 * \param[in]	imgstamp	the stamp of the image file, the stored tiles are discarded if it changed
+			 * \param[in]	tilefile	path to a file where tiles are stored (empty for no storage)
+			 * \param[in]	cachesize	maximal number of tiles kept in memory when no tile file is used
+			 */
+			WeightMap(const crn::SBlock &b, const FileStamp &imgstamp, const crn::Path &tilefile, size_t cachesize);
+			WeightMap(const WeightMap&) = delete;
+			WeightMap& operator=(const WeightMap&) = delete;
+
+			/*! \brief Gets the weight of a pixel (no bound checking) */
+			inline uint8_t At(int x, int y) const
+			{
+				const auto num = size_t(y / TILE_SIZE) * ntx + size_t(x / TILE_SIZE);
+				if (num != lastnum)
+				{
+					lastdata = getTile(num);
+					lastnum = num;
+				}
+				return lastdata[(y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE];
+			}
+			/*! \brief Gets the width of the map */
+			int GetWidth() const noexcept { return width; }
+			/*! \brief Gets the height of the map */
+			int GetHeight() const noexcept { return height; }
+
+			/*! \brief Frees the tiles held in memory */
+			void Clear() noexcept;
+			/*! \brief Estimates the memory used by the tiles held in memory */
+			size_t GetMemorySize() const noexcept { return cache.size() * TILE_SIZE * TILE_SIZE; }
+
+			static constexpr int TILE_SIZE = 256;
+			static constexpr int TILE_MARGIN = 32;
+
+		private:
+			const uint8_t* getTile(size_t num) const;
+			void computeTile(size_t num, uint8_t *dst) const;
+
+			crn::SBlock block;
+			int width, height;
+			size_t ntx, nty;
+
+			MappedFile file;
+			size_t dataoffset = 0;
+
+			using Tile = std::pair<std::vector<uint8_t>, std::list<size_t>::iterator>;
+			mutable std::unordered_map<size_t, Tile> cache;
+			mutable std::list<size_t> lru;
+			size_t maxtiles;
+			mutable size_t lastnum;
+			mutable const uint8_t *lastdata;
+	};
+}
+
+#endif
+
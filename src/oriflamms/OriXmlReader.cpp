@@ -0,0 +1,309 @@
+/*! Copyright 2013-2016 A2IA, CNRS, École Nationale des Chartes, ENS Lyon, INSA Lyon, Université Paris Descartes, Université de Poitiers
+ *
+ * This file is part of Oriflamms.
+ *
+ * Oriflamms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oriflamms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Oriflamms.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \file OriXmlReader.cpp
+ */
+
+#include <OriXmlReader.h>
+#include <CRNException.h>
+#include <CRNi18n.h>
+#include <algorithm>
+#include <cstdlib>
+
+using namespace ori;
+using namespace crn::literals;
+
+static inline bool isSpace(char c) noexcept
+{
+	return (c == ' ') || (c == '\t') || (c == '\n') || (c == '\r');
+}
+
+static inline bool isNameEnd(char c) noexcept
+{
+	return isSpace(c) || (c == '/') || (c == '>') || (c == '=');
+}
+
+/*! Appends a code point to an UTF-8 string */
+static void appendUTF8(std::string &s, unsigned long cp)
+{
+	if (cp < 0x80)
+		s += char(cp);
+	else if (cp < 0x800)
+	{
+		s += char(0xC0 | (cp >> 6));
+		s += char(0x80 | (cp & 0x3F));
+	}
+	else if (cp < 0x10000)
+	{
+		s += char(0xE0 | (cp >> 12));
+		s += char(0x80 | ((cp >> 6) & 0x3F));
+		s += char(0x80 | (cp & 0x3F));
+	}
+	else
+	{
+		s += char(0xF0 | (cp >> 18));
+		s += char(0x80 | ((cp >> 12) & 0x3F));
+		s += char(0x80 | ((cp >> 6) & 0x3F));
+		s += char(0x80 | (cp & 0x3F));
+	}
+}
+
+XmlReader::XmlReader(const crn::Path &fname):
+	file(fname),
+	filename(fname),
+	cur(reinterpret_cast<const char*>(file.GetData())),
+	end(cur + file.GetSize())
+{
+	if ((end - cur >= 3) && !memcmp(cur, "\xEF\xBB\xBF", 3))
+		cur += 3; // BOM
+}
+
+XmlReader::Event XmlReader::Next()
+{
+	if (pending_end)
+	{ // end of an empty element
+		pending_end = false;
+		open.pop_back();
+		return Event::END;
+	}
+	attributes.clear();
+	while (cur < end)
+	{
+		if (*cur != '<')
+		{ // text
+			text_begin = cur;
+			cur = std::find(cur, end, '<');
+			text_end = cur;
+			text_raw = false;
+			if (!open.empty() && (keep_spaces || !std::all_of(text_begin, text_end, isSpace)))
+				return Event::TEXT;
+			continue;
+		}
+		++cur;
+		if (cur == end)
+			error("unexpected end of file");
+		if (*cur == '?')
+		{ // processing instruction
+			skipPast("?>");
+			continue;
+		}
+		if (*cur == '!')
+		{
+			if ((end - cur >= 3) && !memcmp(cur, "!--", 3))
+				skipPast("-->");
+			else if ((end - cur >= 8) && !memcmp(cur, "![CDATA[", 8))
+			{
+				text_begin = cur + 8;
+				text_end = skipPast("]]>");
+				text_raw = true;
+				return Event::TEXT;
+			}
+			else
+			{ // DOCTYPE, the internal subset is skipped
+				auto brackets = 0;
+				for (; (cur < end) && ((*cur != '>') || brackets); ++cur)
+				{
+					if (*cur == '[')
+						brackets += 1;
+					else if (*cur == ']')
+						brackets -= 1;
+				}
+				if (cur == end)
+					error("unterminated declaration");
+				++cur;
+			}
+			continue;
+		}
+		if (*cur == '/')
+		{ // closing tag
+			++cur;
+			name_begin = cur;
+			name_end = readName(name_hash);
+			skipSpaces();
+			if ((cur == end) || (*cur != '>'))
+				error("malformed closing tag");
+			++cur;
+			if (open.empty())
+				error("unbalanced closing tag");
+			const auto &opened = open.back();
+			if ((opened.second - opened.first != name_end - name_begin) || memcmp(opened.first, name_begin, size_t(name_end - name_begin)))
+				error("mismatched closing tag");
+			open.pop_back();
+			return Event::END;
+		}
+		// opening tag
+		name_begin = cur;
+		name_end = readName(name_hash);
+		while (true)
+		{
+			skipSpaces();
+			if (cur == end)
+				error("unterminated tag");
+			if (*cur == '>')
+			{
+				++cur;
+				break;
+			}
+			if (*cur == '/')
+			{
+				if ((end - cur < 2) || (cur[1] != '>'))
+					error("malformed tag");
+				cur += 2;
+				pending_end = true;
+				break;
+			}
+			auto attr = Attribute{};
+			attr.name_begin = cur;
+			attr.name_end = readName(attr.hash);
+			skipSpaces();
+			if ((cur == end) || (*cur != '='))
+				error("attribute without a value");
+			++cur;
+			skipSpaces();
+			if ((cur == end) || ((*cur != '"') && (*cur != '\'')))
+				error("unquoted attribute value");
+			const auto quote = *cur++;
+			attr.value_begin = cur;
+			cur = std::find(cur, end, quote);
+			if (cur == end)
+				error("unterminated attribute value");
+			attr.value_end = cur++;
+			attributes.push_back(attr);
+		}
+		open.emplace_back(name_begin, name_end);
+		return Event::START;
+	}
+	if (!open.empty())
+		error("unexpected end of file");
+	return Event::DONE;
+}
+
+void XmlReader::SkipElement()
+{
+	const auto d = open.size();
+	while (open.size() >= d)
+		if (Next() == Event::DONE)
+			break;
+}
+
+crn::StringUTF8 XmlReader::GetAttribute(const XmlName &n) const
+{
+	const auto *attr = findAttribute(n);
+	if (!attr)
+		return crn::StringUTF8{};
+	return decode(attr->value_begin, attr->value_end);
+}
+
+bool XmlReader::AttributeIs(const XmlName &n, const char *value) const
+{
+	const auto *attr = findAttribute(n);
+	if (!attr)
+		return !*value;
+	if (std::find(attr->value_begin, attr->value_end, '&') != attr->value_end)
+		return decode(attr->value_begin, attr->value_end) == value;
+	const auto len = size_t(attr->value_end - attr->value_begin);
+	return (strlen(value) == len) && !memcmp(attr->value_begin, value, len);
+}
+
+crn::StringUTF8 XmlReader::GetText() const
+{
+	if (text_raw)
+		return std::string{text_begin, text_end};
+	return decode(text_begin, text_end);
+}
+
+const XmlReader::Attribute* XmlReader::findAttribute(const XmlName &n) const noexcept
+{
+	for (const auto &attr : attributes)
+		if (n.Is(attr.hash, attr.name_begin, attr.name_end))
+			return &attr;
+	return nullptr;
+}
+
+/*! Reads a name and computes its hash
+ * \return	the end of the name
+ */
+const char* XmlReader::readName(uint32_t &h)
+{
+	const auto *b = cur;
+	h = 2166136261u;
+	for (; (cur < end) && !isNameEnd(*cur); ++cur)
+		h = (h ^ uint32_t(uint8_t(*cur))) * 16777619u;
+	if (cur == b)
+		error("empty name");
+	return cur;
+}
+
+/*! Moves after a pattern
+ * \return	the beginning of the pattern
+ */
+const char* XmlReader::skipPast(const char *pattern)
+{
+	const auto len = strlen(pattern);
+	const auto *p = std::search(cur, end, pattern, pattern + len);
+	if (p == end)
+		error("unterminated section");
+	cur = p + len;
+	return p;
+}
+
+void XmlReader::skipSpaces() noexcept
+{
+	while ((cur < end) && isSpace(*cur))
+		++cur;
+}
+
+void XmlReader::error(const char *what) const
+{
+	throw crn::ExceptionInvalidArgument("XmlReader::Next(): "_s + _("Malformed XML file: ") + filename + " (" + what + ")");
+}
+
+/*! Replaces the character references in a string */
+std::string XmlReader::decode(const char *b, const char *e)
+{
+	auto s = std::string{};
+	s.reserve(size_t(e - b));
+	while (b < e)
+	{
+		const auto *amp = std::find(b, e, '&');
+		s.append(b, amp);
+		if (amp == e)
+			break;
+		const auto *semi = std::find(amp, e, ';');
+		if (semi == e)
+		{ // not a reference
+			s.append(amp, e);
+			break;
+		}
+		const auto ref = std::string{amp + 1, semi};
+		if (ref == "lt") s += '<';
+		else if (ref == "gt") s += '>';
+		else if (ref == "amp") s += '&';
+		else if (ref == "quot") s += '"';
+		else if (ref == "apos") s += '\'';
+		else if ((ref.size() > 1) && (ref[0] == '#'))
+		{
+			const auto hex = (ref[1] == 'x') || (ref[1] == 'X');
+			appendUTF8(s, strtoul(ref.c_str() + (hex ? 2 : 1), nullptr, hex ? 16 : 10));
+		}
+		else // entity declared in a DTD, kept as is
+			s.append(amp, semi + 1);
+		b = semi + 1;
+	}
+	return s;
+}
+
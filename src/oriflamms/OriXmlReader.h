@@ -0,0 +1,133 @@
+/*! Copyright 2013-2016 A2IA, CNRS, École Nationale des Chartes, ENS Lyon, INSA Lyon, Université Paris Descartes, Université de Poitiers
+ *
+ * This file is part of Oriflamms.
+ *
+ * Oriflamms is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oriflamms is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Oriflamms.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * \file OriXmlReader.h
+ */
+
+#ifndef OriXmlReader_HEADER
+#define OriXmlReader_HEADER
+
+#include <oriflamms_config.h>
+#include <OriIO.h>
+#include <CRNStringUTF8.h>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace ori
+{
+	/*! \brief Name of an XML element or attribute, hashed at compile time */
+	class XmlName
+	{
+		public:
+			constexpr XmlName(const char *s):str(s), len(length(s)), hash(Hash(s, s + length(s))) {}
+
+			/*! \brief FNV-1a hash of a character range */
+			static constexpr uint32_t Hash(const char *b, const char *e, uint32_t h = 2166136261u)
+			{
+				return b == e ? h : Hash(b + 1, e, (h ^ uint32_t(uint8_t(*b))) * 16777619u);
+			}
+
+			/*! \brief Tests if a character range is this name */
+			bool Is(uint32_t h, const char *b, const char *e) const noexcept
+			{
+				return (h == hash) && (size_t(e - b) == len) && !memcmp(b, str, len);
+			}
+
+		private:
+			static constexpr size_t length(const char *s) { return *s ? 1 + length(s + 1) : 0; }
+
+			const char *str;
+			size_t len;
+			uint32_t hash;
+	};
+
+	/*! \brief Streaming XML reader
+	 *
+	 * The file is mapped in memory and read one event at a time, no tree is built.
+	 * Names are hashed while they are read so that they are compared with XmlName constants as integers.
+	 * Texts and attribute values are decoded only when they are requested.
+	 * The DTD is ignored and only the predefined and numeric character references are decoded.
+	 */
+	class XmlReader
+	{
+		public:
+			enum class Event { START, END, TEXT, DONE };
+
+			/*! \brief Opens a file
+			 * \throws	crn::ExceptionIO	cannot open the file
+			 */
+			XmlReader(const crn::Path &fname);
+			XmlReader(const XmlReader&) = delete;
+			XmlReader& operator=(const XmlReader&) = delete;
+
+			/*! \brief Reads the next event
+			 * \throws	crn::ExceptionInvalidArgument	malformed XML or closing tag that does not match the open element
+			 * \return	the type of the event. Empty elements produce a START and an END event, whitespace-only texts are skipped unless SetKeepSpaces(true) was called.
+			 */
+			Event Next();
+			/*! \brief Sets whether whitespace-only texts inside the root are returned (for elements whose content is significant) */
+			void SetKeepSpaces(bool keep) noexcept { keep_spaces = keep; }
+			/*! \brief Skips the content of the current element, up to its END event (after a START event) */
+			void SkipElement();
+
+			/*! \brief Tests the name of the current element (START and END events) */
+			bool IsElement(const XmlName &n) const noexcept { return n.Is(name_hash, name_begin, name_end); }
+			/*! \brief Gets the name of the current element (START and END events) */
+			crn::StringUTF8 GetName() const { return crn::StringUTF8{std::string{name_begin, name_end}}; }
+			/*! \brief Gets the number of open elements (1 after the START event of the root, 0 after its END event) */
+			size_t GetDepth() const noexcept { return open.size(); }
+			/*! \brief Gets the decoded value of an attribute of the current element (START event)
+			 * \return	the value or an empty string if the attribute does not exist
+			 */
+			crn::StringUTF8 GetAttribute(const XmlName &n) const;
+			/*! \brief Tests the value of an attribute of the current element (START event) */
+			bool AttributeIs(const XmlName &n, const char *value) const;
+			/*! \brief Gets the decoded text (TEXT event) */
+			crn::StringUTF8 GetText() const;
+
+		private:
+			struct Attribute
+			{
+				uint32_t hash;
+				const char *name_begin, *name_end;
+				const char *value_begin, *value_end;
+			};
+
+			const Attribute* findAttribute(const XmlName &n) const noexcept;
+			const char* readName(uint32_t &h);
+			const char* skipPast(const char *pattern);
+			void skipSpaces() noexcept;
+			[[noreturn]] void error(const char *what) const;
+			static std::string decode(const char *b, const char *e);
+
+			MappedFile file;
+			crn::StringUTF8 filename;
+			const char *cur, *end;
+			std::vector<std::pair<const char*, const char*>> open; // names of the open elements
+			bool pending_end = false;
+			bool keep_spaces = false;
+			uint32_t name_hash = 0;
+			const char *name_begin = nullptr, *name_end = nullptr;
+			std::vector<Attribute> attributes;
+			const char *text_begin = nullptr, *text_end = nullptr;
+			bool text_raw = false; // CDATA
+	};
+}
+
+#endif
+
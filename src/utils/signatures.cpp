@@ -22,8 +22,42 @@
 #include <CRNString.h>
 #include <CRNXml/CRNXml.h>
 #include <map>
+#include <fstream>
+#include <iostream>
+#include <cstring>
 
-int main(void)
+/*! Writes the table as a C++ header that is compiled into oriflamms */
+static bool writeHeader(const std::map<char32_t, crn::StringUTF8> &sig, const char *fname)
+{
+	std::ofstream out(fname);
+	out << "/* Default signature table, generated by the signatures utility. Do not edit. */\n\n";
+	out << "#ifndef OriDefaultSignatures_HEADER\n#define OriDefaultSignatures_HEADER\n\n";
+	out << "namespace ori\n{\n\tnamespace defaultsig\n\t{\n";
+	out << "\t\tstruct Entry\n\t\t{\n\t\t\tchar32_t c;\n\t\t\tconst char *sig;\n\t\t};\n";
+	out << "\t\tconstexpr Entry table[] =\n\t\t{\n";
+	for (std::map<char32_t, crn::StringUTF8>::const_iterator it = sig.begin(); it != sig.end(); ++it)
+	{
+		out << "\t\t\t{ " << uint32_t(it->first) << "u, \"";
+		for (size_t tmp = 0; tmp < it->second.Size(); ++tmp)
+		{
+			const unsigned char c = (unsigned char)it->second[tmp];
+			if ((c < 32) || (c > 126) || (c == '"') || (c == '\\') || (c == '?'))
+			{ // octal escape, that cannot be followed by a digit by mistake
+				const char oct[] = { '\\', char('0' + (c >> 6)), char('0' + ((c >> 3) & 7)), char('0' + (c & 7)), 0 };
+				out << oct;
+			}
+			else
+				out << c;
+		}
+		out << "\" },\n";
+	}
+	out << "\t\t};\n\t}\n}\n\n#endif\n";
+	out.close();
+	return bool(out);
+}
+
+/*! Writes the signature table to orisig.xml, or to a C++ header with -h <file> */
+int main(int argc, char **argv)
 {
 	std::map<char32_t, crn::StringUTF8> sig;
 	sig[U' '] = " ";
@@ -210,6 +244,16 @@ int main(void)
 	sig[U'ꝙ'] = "(l"; //
 	sig[U'ẜ'] = "l'"; // f barré
 #endif
+	if ((argc == 3) && !strcmp(argv[1], "-h"))
+	{
+		if (!writeHeader(sig, argv[2]))
+		{
+			std::cerr << "Cannot write " << argv[2] << std::endl;
+			return 1;
+		}
+		return 0;
+	}
+
 	crn::xml::Document doc;
 	doc.PushBackComment("oriflamms signature table");
 	crn::xml::Element root(doc.PushBackElement("orisig"));